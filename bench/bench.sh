@@ -3,6 +3,14 @@
 LUA=luajit
 BENCH_ARGS="$*"
 
+# synthetic corpus does not need any json file or external module
+if [ -z "$BENCH_ARGS" ]; then
+    echo "SYNTHETIC CORPUS"
+    echo "===================================================================="
+    $LUA ./bench_corpus.lua
+    exit
+fi
+
 echo "PREPROCESS"
 $LUA ./preprocess.lua $BENCH_ARGS
 echo "====================================================================\n"
@@ -0,0 +1,78 @@
+--
+-- usage: luajit ./bench_corpus.lua [seed] [workload ...]
+--
+-- runs every synthetic workload of corpus.lua through parcel.pack,
+-- parcel.stream.pack and parcel.unpack and reports the throughput.
+--
+local dir = ( _G.arg[0] or '' ):match('^(.*[/\\])') or './';
+package.path = dir .. '?.lua;' .. package.path;
+
+local corpus = require('corpus');
+local pack = require('parcel.pack').pack;
+local spack = require('parcel.stream.pack');
+local unpack = require('parcel.unpack').unpack;
+local clock = os.clock;
+local MB = 1024 * 1024;
+local SEED = tonumber( _G.arg[1] ) or corpus.DEFAULT_SEED;
+local NAMES = {};
+local FMT = '%-14s %-18s %8d %12d %10.4f %10.2f %12.1f';
+
+for i = 2, #_G.arg do
+    NAMES[#NAMES + 1] = _G.arg[i];
+end
+if #NAMES == 0 then
+    NAMES = corpus.names;
+end
+
+
+local function measure( cycle, fn, ... )
+    local sec;
+
+    collectgarbage('collect');
+    sec = clock();
+    for _ = 1, cycle do
+        fn( ... );
+    end
+
+    return clock() - sec;
+end
+
+
+local function report( name, op, cycle, bytes, sec )
+    print( FMT:format(
+        name, op, cycle, bytes, sec, bytes * cycle / MB / sec, cycle / sec
+    ));
+end
+
+
+local function run( name )
+    local data, cycle = assert( corpus.generate( name, SEED ) );
+    local bin = assert( pack( data ) );
+    local nbyte = 0;
+    local sp = spack.new(function( size )
+        nbyte = nbyte + size;
+    end);
+
+    report( name, 'parcel.pack', cycle, #bin, measure( cycle, pack, data ) );
+    report(
+        name, 'parcel.stream.pack', cycle, #bin,
+        measure( cycle, function()
+            nbyte = 0;
+            assert( sp( data ) );
+        end)
+    );
+    assert(
+        nbyte == #bin,
+        ('%s: stream packed %d bytes, expected %d'):format( name, nbyte, #bin )
+    );
+    report( name, 'parcel.unpack', cycle, #bin, measure( cycle, unpack, bin ) );
+end
+
+
+print( ('SEED: %d'):format( SEED ) );
+print( ('%-14s %-18s %8s %12s %10s %10s %12s'):format(
+    'WORKLOAD', 'OP', 'CYCLE', 'BYTES', 'SEC', 'MB/s', 'OPS/s'
+));
+for _, name in ipairs( NAMES ) do
+    run( name );
+end
@@ -0,0 +1,216 @@
+--
+-- synthetic corpus generator
+--
+-- every workload is built from a seeded Park-Miller PRNG so that the same
+-- seed yields the same tables on every machine and lua version.
+--
+local floor = math.floor;
+local concat = table.concat;
+local char = string.char;
+local DEFAULT_SEED = 20150115;
+
+local function newRandom( seed )
+    local state = floor( tonumber( seed ) or DEFAULT_SEED ) % 2147483647;
+
+    if state <= 0 then
+        state = state + 2147483646;
+    end
+
+    -- returns integer in range [lo, hi]
+    return function( lo, hi )
+        state = ( state * 16807 ) % 2147483647;
+        return lo + state % ( hi - lo + 1 );
+    end
+end
+
+
+local function genString( rand, len )
+    local buf = {};
+
+    for i = 1, len do
+        -- printable ascii
+        buf[i] = char( rand( 0x21, 0x7E ) );
+    end
+
+    return concat( buf );
+end
+
+
+local function genNumber( rand )
+    local kind = rand( 1, 8 );
+
+    -- 6 bit integer
+    if kind == 1 then
+        return rand( -63, 63 );
+    -- 8/16 bit integer
+    elseif kind == 2 then
+        return rand( -32768, 65535 );
+    -- 32 bit integer
+    elseif kind == 3 then
+        return rand( 0, 1 ) == 1 and rand( 0, 2147483647 ) or
+               -rand( 1, 2147483647 );
+    -- 64 bit integer
+    elseif kind == 4 then
+        return rand( 0, 2097151 ) * 4294967296 + rand( 0, 2147483647 );
+    -- float
+    elseif kind <= 6 then
+        return rand( -1000000, 1000000 ) / 1000 + 0.5;
+    end
+
+    return rand( 0, 255 );
+end
+
+
+local function genScalar( rand )
+    local kind = rand( 1, 4 );
+
+    if kind == 1 then
+        return genString( rand, rand( 1, 48 ) );
+    elseif kind == 2 then
+        return rand( 0, 1 ) == 1;
+    end
+
+    return genNumber( rand );
+end
+
+
+local function genRecord( rand, id )
+    local tags = {};
+
+    for i = 1, rand( 0, 6 ) do
+        tags[i] = genString( rand, rand( 3, 12 ) );
+    end
+
+    return {
+        id = id,
+        name = genString( rand, rand( 4, 24 ) ),
+        score = genNumber( rand ),
+        active = rand( 0, 1 ) == 1,
+        tags = tags,
+        meta = {
+            created = rand( 1420070400, 1735689600 ),
+            ratio = rand( 0, 10000 ) / 10000 + 0.25,
+            owner = genString( rand, 8 )
+        }
+    };
+end
+
+
+-- name = { description, default number of iterations, generator }
+local WORKLOADS = {
+    wide_map = {
+        'map with 4096 string keys of mixed scalar values', 200,
+        function( rand )
+            local tbl = {};
+
+            for i = 1, 4096 do
+                tbl['key_' .. i .. '_' .. genString( rand, rand( 1, 12 ) )] =
+                    genScalar( rand );
+            end
+
+            return tbl;
+        end
+    },
+    deep_nest = {
+        '128 levels of nested maps with a few fields on each level', 2000,
+        function( rand )
+            local root = {};
+            local tbl = root;
+
+            for i = 1, 128 do
+                tbl.level = i;
+                tbl.name = genString( rand, rand( 4, 16 ) );
+                tbl.value = genNumber( rand );
+                tbl.child = {};
+                tbl = tbl.child;
+            end
+
+            return root;
+        end
+    },
+    num_array = {
+        'array of 16384 integers and floats of every width', 200,
+        function( rand )
+            local arr = {};
+
+            for i = 1, 16384 do
+                arr[i] = genNumber( rand );
+            end
+
+            return arr;
+        end
+    },
+    long_str = {
+        'array of 16 strings of 64 KB each', 200,
+        function( rand )
+            local arr = {};
+
+            for i = 1, 16 do
+                arr[i] = genString( rand, 65536 );
+            end
+
+            return arr;
+        end
+    },
+    sparse_array = {
+        'array of 4096 values with gaps encoded with PAR_ISA_IDX', 200,
+        function( rand )
+            local arr = {};
+            local idx = 0;
+
+            for _ = 1, 4096 do
+                -- every third element jumps ahead
+                if rand( 1, 3 ) == 1 then
+                    idx = idx + rand( 2, 64 );
+                else
+                    idx = idx + 1;
+                end
+                arr[idx] = genScalar( rand );
+            end
+
+            return arr;
+        end
+    },
+    mixed_record = {
+        'array of 1024 records with nested maps and arrays', 100,
+        function( rand )
+            local arr = {};
+
+            for i = 1, 1024 do
+                arr[i] = genRecord( rand, i );
+            end
+
+            return arr;
+        end
+    },
+    small_record = {
+        'a single small record, the typical rpc message', 200000,
+        function( rand )
+            return genRecord( rand, 1 );
+        end
+    }
+};
+
+local NAMES = {};
+for name in pairs( WORKLOADS ) do
+    NAMES[#NAMES + 1] = name;
+end
+table.sort( NAMES );
+
+
+local function generate( name, seed )
+    local wl = WORKLOADS[name];
+
+    if not wl then
+        return nil, ('unknown workload: %q'):format( tostring( name ) );
+    end
+
+    return wl[3]( newRandom( seed ) ), wl[2], wl[1];
+end
+
+
+return {
+    DEFAULT_SEED = DEFAULT_SEED,
+    names = NAMES,
+    generate = generate
+};
@@ -0,0 +1,764 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  buffer.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#include "lparcel_pack.h"
+
+// size of the buffer on the stack to encode a new value
+#define SET_STACK_BUFSIZE   256
+
+
+// numeric value of integer and floating-point types
+static int ext2num( par_extract_t *ext, lua_Number *num )
+{
+    switch( ext->isa ){
+        case PAR_ISA_S6:
+        case PAR_ISA_S6N:
+        case PAR_ISA_S8:
+            *num = (lua_Number)ext->val.i8;
+            return 0;
+        case PAR_ISA_S16:
+            *num = (lua_Number)ext->val.i16;
+            return 0;
+        case PAR_ISA_S32:
+            *num = (lua_Number)ext->val.i32;
+            return 0;
+        case PAR_ISA_S64:
+            *num = (lua_Number)ext->val.i64;
+            return 0;
+        case PAR_ISA_U8:
+            *num = (lua_Number)ext->val.u8;
+            return 0;
+        case PAR_ISA_U16:
+            *num = (lua_Number)ext->val.u16;
+            return 0;
+        case PAR_ISA_U32:
+            *num = (lua_Number)ext->val.u32;
+            return 0;
+        case PAR_ISA_U64:
+            *num = (lua_Number)ext->val.u64;
+            return 0;
+        case PAR_ISA_F32:
+            *num = (lua_Number)ext->val.f32;
+            return 0;
+        case PAR_ISA_F64:
+            *num = (lua_Number)ext->val.f64;
+            return 0;
+    }
+
+    return -1;
+}
+
+
+// compare the key at idx with the extracted value
+static int key_eq( lua_State *L, int idx, par_extract_t *ext )
+{
+    const char *str = NULL;
+    size_t len = 0;
+    lua_Number num = 0;
+
+    switch( lua_type( L, idx ) )
+    {
+        case LUA_TSTRING:
+            switch( ext->isa ){
+                case PAR_ISA_STR5:
+                case PAR_ISA_STR8 ... PAR_ISA_STR64:
+                    str = lua_tolstring( L, idx, &len );
+                    return ext->size.len == len &&
+                           memcmp( ext->val.bytea, str, len ) == 0;
+            }
+            return 0;
+
+        case LUA_TNUMBER:
+            return ext2num( ext, &num ) == 0 && num == lua_tonumber( L, idx );
+
+        case LUA_TBOOLEAN:
+            return ext->isa == ( lua_toboolean( L, idx ) ? PAR_ISA_TRUE :
+                                                           PAR_ISA_FALSE );
+    }
+
+    return 0;
+}
+
+
+// find the key at idx by the offset table of the indexed array/map
+static int find_index( par_unpack_t *p, lua_State *L, int idx,
+                       par_extract_t *ext )
+{
+    par_key_t key = { PAR_KEY_NUM, NULL, 0, 0, 0, 0 };
+
+    switch( lua_type( L, idx ) ){
+        case LUA_TSTRING:
+            key.type = PAR_KEY_STR;
+            key.str = lua_tolstring( L, idx, &key.len );
+        break;
+
+        case LUA_TNUMBER:
+            lparcel_numkey( L, idx, &key );
+        break;
+
+        case LUA_TBOOLEAN:
+            key.type = PAR_KEY_BOOL;
+            key.num = lua_toboolean( L, idx );
+        break;
+
+        default:
+            return 1;
+    }
+
+    return par_unpack_index_find( p, ext, &key );
+}
+
+
+// move the cursor to the element of the container at the cursor position.
+// returns 1 if not found.
+static int find_elt( par_unpack_t *p, lua_State *L, int idx )
+{
+    par_extract_t ext;
+    lua_Number seq = 1;
+    size_t narr = 0;
+    size_t len = 0;
+    size_t cur = 0;
+    int stream = 0;
+    int rc = par_unpack( p, &ext );
+
+    if( rc != 0 ){
+        return -1;
+    }
+
+    switch( ext.isa )
+    {
+        case PAR_ISA_IARR:
+        case PAR_ISA_IMAP:
+            return find_index( p, L, idx, &ext );
+
+        // values of array section and then key/value pairs
+        case PAR_ISA_HYB:
+            narr = ext.size.len;
+            len = par_hyb_nmap( &ext );
+            for(; narr; narr-- )
+            {
+                if( lua_type( L, idx ) == LUA_TNUMBER &&
+                    seq++ == lua_tonumber( L, idx ) ){
+                    return 0;
+                }
+                else if( par_unpack_skip( p, &ext ) != 0 ){
+                    return -1;
+                }
+            }
+            goto FIND_KEY;
+
+        case PAR_ISA_SMAP:
+            stream = 1;
+            // fallthrough
+        case PAR_ISA_MAP4:
+        case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+            len = ext.size.len;
+FIND_KEY:
+            while( stream || len-- )
+            {
+                if( ( rc = par_unpack_key( p, &ext, stream ) ) != 0 ){
+                    return ( rc == PAR_ISA_EOS ) ? 1 : -1;
+                }
+                else if( key_eq( L, idx, &ext ) ){
+                    return 0;
+                }
+                else if( par_unpack_skip( p, &ext ) != 0 ){
+                    return -1;
+                }
+            }
+            return 1;
+
+        case PAR_ISA_SARR:
+            stream = 1;
+            // fallthrough
+        case PAR_ISA_ARR4:
+        case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+        case PAR_ISA_REC:
+            len = ext.size.len;
+            while( stream || len-- )
+            {
+                cur = p->cur;
+                switch( par_unpack_skip( p, &ext ) ){
+                    // consecutive value
+                    case 0:
+                        if( lua_type( L, idx ) == LUA_TNUMBER &&
+                            seq++ == lua_tonumber( L, idx ) ){
+                            p->cur = cur;
+                            return 0;
+                        }
+                    break;
+
+                    // non-consecutive index and value
+                    case PAR_ISA_IDX:
+                        if( par_unpack( p, &ext ) != 0 ){
+                            return -1;
+                        }
+                        else if( key_eq( L, idx, &ext ) ){
+                            return 0;
+                        }
+                        else if( par_unpack_skip( p, &ext ) != 0 ){
+                            return -1;
+                        }
+                    break;
+
+                    case PAR_ISA_EOS:
+                        return 1;
+
+                    default:
+                        return -1;
+                }
+            }
+            return 1;
+    }
+
+    // scalar value has no element
+    return 1;
+}
+
+
+// value of the column of the columnar array
+typedef struct {
+    par_column_t c;
+    // index of the value in the typed column. SIZE_MAX: the value is encoded
+    // at the cursor position
+    size_t i;
+} col_cell_t;
+
+
+// move the cursor to the value of the row at ridx and the column at kidx of
+// the columnar array at the cursor position. the value of the typed column is
+// not encoded, so it is set to cell. returns 1 if not found.
+static int find_col( par_unpack_t *p, lua_State *L, int ridx, int kidx,
+                     col_cell_t *cell )
+{
+    par_extract_t ext;
+    par_col_t col;
+    lua_Number num = lua_tonumber( L, ridx );
+    size_t row = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    if( par_unpack( p, &ext ) != 0 ){
+        return -1;
+    }
+    par_col_init( &col, &ext );
+    if( lua_type( L, ridx ) != LUA_TNUMBER || num < 1 ||
+        num > (lua_Number)col.nrow || num != (lua_Number)(size_t)num ){
+        return 1;
+    }
+    // row is not encoded as a value
+    else if( lua_isnil( L, kidx ) ){
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    row = (size_t)num - 1;
+    for(; i < col.ncol; i++ )
+    {
+        if( par_unpack_column( p, &col, &cell->c ) != 0 ){
+            return -1;
+        }
+        else if( key_eq( L, kidx, &cell->c.key ) ){
+            if( !par_column_has( &cell->c, row ) ){
+                return 1;
+            }
+            // index of the value is the number of the values of the rows
+            // before row
+            cell->i = 0;
+            for( j = 0; j < row; j++ ){
+                cell->i += par_column_has( &cell->c, j );
+            }
+            if( cell->c.kind != PAR_COL_ANY ){
+                return 0;
+            }
+            for(; cell->i; cell->i-- ){
+                if( par_unpack_skip( p, &ext ) != 0 ){
+                    return -1;
+                }
+            }
+            cell->i = SIZE_MAX;
+            return 0;
+        }
+        // skip the values of the column
+        else if( cell->c.kind == PAR_COL_ANY ){
+            for( j = 0; j < cell->c.len; j++ ){
+                if( par_unpack_skip( p, &ext ) != 0 ){
+                    return -1;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+// non-integral number
+#define isfloat( num ) \
+    ( isnan( num ) || isinf( num ) || LUANUM_ISDBL( num ) )
+
+// encode a number in the width of the integer or floating-point type
+static int pack_width( par_pack_t *p, lua_Number num, uint8_t isa )
+{
+    uint_fast8_t wclass = 0;
+
+    switch( isa )
+    {
+        case PAR_ISA_F32:
+            if( isfloat( num ) &&
+                ( isnan( num ) || (lua_Number)(float)num == num ) ){
+                return par_pack_float32( p, (float)num );
+            }
+            return 0;
+
+        case PAR_ISA_F64:
+            if( isfloat( num ) ){
+                return par_pack_float64( p, num );
+            }
+            return 0;
+
+        case PAR_ISA_U8 ... PAR_ISA_U64:
+            wclass = isa - PAR_ISA_U8;
+        break;
+
+        case PAR_ISA_S8 ... PAR_ISA_S64:
+            wclass = isa - PAR_ISA_S8;
+        break;
+
+        default:
+            return 0;
+    }
+
+    // integer
+    if( isfloat( num ) ){
+        return 0;
+    }
+    else if( !signbit( num ) )
+    {
+        if( par_uint_wclass( (uint_fast64_t)num ) <= wclass ){
+            switch( wclass ){
+                case 0:
+                    return par_pack_uint8( p, (uint_fast8_t)num );
+                case 1:
+                    return par_pack_uint16( p, (uint_fast16_t)num );
+                case 2:
+                    return par_pack_uint32( p, (uint_fast32_t)num );
+                default:
+                    return par_pack_uint64( p, (uint_fast64_t)num );
+            }
+        }
+    }
+    else if( par_int_wclass( (int_fast64_t)num ) <= wclass )
+    {
+        switch( wclass ){
+            case 0:
+                return par_pack_int8( p, (int_fast8_t)num );
+            case 1:
+                return par_pack_int16( p, (int_fast16_t)num );
+            case 2:
+                return par_pack_int32( p, (int_fast32_t)num );
+            default:
+                return par_pack_int64( p, (int_fast64_t)num );
+        }
+    }
+
+    return 0;
+}
+
+
+
+// overwrite the value of the typed column with the value at idx.
+// returns 1 if the value does not fit the column.
+static int overwrite_col( lua_State *L, int idx, col_cell_t *cell )
+{
+    par_column_t *c = &cell->c;
+    uint8_t *data = (uint8_t*)c->data;
+    size_t i = cell->i;
+    lua_Number num = 0;
+    uint64_t v = 0;
+    const char *str = NULL;
+    size_t len = 0;
+    size_t off = 0;
+
+    switch( c->kind )
+    {
+        case PAR_COL_BOOL:
+            if( lua_type( L, idx ) != LUA_TBOOLEAN ){
+                return 1;
+            }
+            else if( lua_toboolean( L, idx ) ){
+                data[i >> 3] |= (uint8_t)( 1 << ( i & 7 ) );
+            }
+            else {
+                data[i >> 3] &= (uint8_t)~( 1 << ( i & 7 ) );
+            }
+            return 0;
+
+        case PAR_COL_INT8 ... PAR_COL_INT64:
+            num = lua_tonumber( L, idx );
+            if( lua_type( L, idx ) != LUA_TNUMBER || isfloat( num ) ||
+                num < -9223372036854775808.0 ||
+                num >= 9223372036854775808.0 ||
+                par_int_wclass( (int_fast64_t)num ) >
+                c->kind - PAR_COL_INT8 ){
+                return 1;
+            }
+            par_store_bewidth( data + i * c->width,
+                               (uint64_t)(int64_t)num, c->width );
+            return 0;
+
+        case PAR_COL_F64:
+            num = lua_tonumber( L, idx );
+            if( lua_type( L, idx ) != LUA_TNUMBER || !isfloat( num ) ){
+                return 1;
+            }
+            memcpy( &v, &num, sizeof( v ) );
+            par_store_be64( data + i * 8, v );
+            return 0;
+
+        case PAR_COL_STR:
+            if( lua_type( L, idx ) != LUA_TSTRING ){
+                return 1;
+            }
+            str = lua_tolstring( L, idx, &len );
+            if( len != par_column_strlen( c, i ) ){
+                return 1;
+            }
+            // offset of the i-th string
+            while( i-- ){
+                off += par_column_strlen( c, i );
+            }
+            memcpy( (uint8_t*)c->bytes + off, str, len );
+            return 0;
+    }
+
+    return 1;
+}
+
+#undef isfloat
+
+
+// overwrite the value of span bytes at dst with the value at idx.
+// returns 1 if the encoded value does not fit the span.
+static int overwrite( lua_State *L, int idx, uint8_t *dst, size_t span )
+{
+    char buf[SET_STACK_BUFSIZE];
+    par_pack_t p;
+    int rc = 0;
+
+    par_pack_init_mem( &p, buf, sizeof( buf ), NULL );
+    if( ( rc = lparcel_pack_val( &p, L, idx ) ) == 0 && p.cur != span &&
+        lua_type( L, idx ) == LUA_TNUMBER ){
+        // try the width of the current value
+        p.cur = 0;
+        rc = pack_width( &p, lua_tonumber( L, idx ), PAR_ISA_DESC[*dst].isa );
+    }
+
+    if( rc == 0 )
+    {
+        if( p.cur == span ){
+            memcpy( dst, p.mem, span );
+        }
+        else {
+            rc = 1;
+        }
+    }
+    par_pack_dispose( &p );
+
+    return rc;
+}
+
+
+static int set_lua( lua_State *L )
+{
+    lparcel_buffer_t *b = luaL_checkudata( L, 1, LPARCEL_BUFFER_MT );
+    par_unpack_t p;
+    par_extract_t ext;
+    col_cell_t cell = { .i = SIZE_MAX };
+    size_t cur = 0;
+    int i = 1;
+    int rc = 0;
+
+    luaL_checktype( L, 2, LUA_TTABLE );
+    // only the scalar value can be overwritten in place
+    switch( lua_type( L, 3 ) ){
+        case LUA_TBOOLEAN:
+        case LUA_TNUMBER:
+        case LUA_TSTRING:
+        break;
+
+        default:
+            return luaL_argerror( L, 3,
+                                  "value must be boolean, number or string" );
+    }
+    lua_settop( L, 3 );
+    // shared block is immutable
+    if( lparcel_block_shared( b->blk ) ){
+        errno = EPERM;
+        goto FAILED;
+    }
+    // data has been verified by new()
+    par_unpack_init( &p, b->blk->mem, b->blk->len );
+    p.verified = 1;
+
+    // walk the path
+    for(;; i++ )
+    {
+        lua_rawgeti( L, 2, i );
+        if( lua_isnil( L, -1 ) ){
+            lua_pop( L, 1 );
+            break;
+        }
+        // row and column of the columnar array
+        else if( ((uint8_t*)b->blk->mem)[p.cur] == PAR_ISA_COL )
+        {
+            lua_rawgeti( L, 2, ++i );
+            rc = find_col( &p, L, -2, -1, &cell );
+            lua_pop( L, 1 );
+            // value of the typed column has no element
+            if( rc == 0 && cell.i != SIZE_MAX ){
+                lua_rawgeti( L, 2, i + 1 );
+                rc = !lua_isnil( L, -1 );
+                lua_pop( L, 1 );
+            }
+        }
+        else {
+            rc = find_elt( &p, L, -1 );
+        }
+        lua_pop( L, 1 );
+        if( rc == 1 ){
+            lua_pushnil( L );
+            lua_pushliteral( L, "not found" );
+            return 2;
+        }
+        else if( rc != 0 ){
+            goto FAILED;
+        }
+    }
+
+    // value of the typed column
+    if( cell.i != SIZE_MAX ){
+        lua_pushboolean( L, !overwrite_col( L, 3, &cell ) );
+        return 1;
+    }
+
+    // span of the value
+    cur = p.cur;
+    if( par_unpack_skip( &p, &ext ) == 0 &&
+        ( rc = overwrite( L, 3, (uint8_t*)b->blk->mem + cur, p.cur - cur ) ) >= 0 ){
+        // false if resize is needed
+        lua_pushboolean( L, !rc );
+        return 1;
+    }
+
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int bytes_lua( lua_State *L )
+{
+    lparcel_buffer_t *b = luaL_checkudata( L, 1, LPARCEL_BUFFER_MT );
+
+    lua_pushlstring( L, b->blk->mem, b->blk->len );
+
+    return 1;
+}
+
+
+static int len_lua( lua_State *L )
+{
+    lparcel_buffer_t *b = luaL_checkudata( L, 1, LPARCEL_BUFFER_MT );
+
+    lua_pushinteger( L, (lua_Integer)b->blk->len );
+
+    return 1;
+}
+
+
+// add a reference to the block, and return it as the light userdata that
+// can be passed to adopt() of the other lua state.
+static int share_lua( lua_State *L )
+{
+    lparcel_buffer_t *b = luaL_checkudata( L, 1, LPARCEL_BUFFER_MT );
+
+    lua_pushlightuserdata( L, (void*)lparcel_block_retain( b->blk ) );
+
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, LPARCEL_BUFFER_MT );
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    lparcel_buffer_t *b = lua_touserdata( L, 1 );
+
+    if( b->blk ){
+        lparcel_block_release( b->blk );
+    }
+
+    return 0;
+}
+
+
+static lparcel_buffer_t *new_buffer( lua_State *L )
+{
+    lparcel_buffer_t *b = lua_newuserdata( L, sizeof( lparcel_buffer_t ) );
+
+    b->blk = NULL;
+    luaL_getmetatable( L, LPARCEL_BUFFER_MT );
+    lua_setmetatable( L, -2 );
+
+    return b;
+}
+
+
+void lparcel_buffer_push( lua_State *L, lparcel_block_t *blk )
+{
+    new_buffer( L )->blk = blk;
+}
+
+
+// adopt( ptr )
+static int adopt_lua( lua_State *L )
+{
+    luaL_checktype( L, 1, LUA_TLIGHTUSERDATA );
+    lparcel_buffer_push( L, (lparcel_block_t*)lua_touserdata( L, 1 ) );
+
+    return 1;
+}
+
+
+// push the buffer of the copy of the serialized data. nothing is pushed on
+// failure.
+static int push_copy( lua_State *L, const void *mem, size_t len )
+{
+    size_t span = 0;
+    lparcel_buffer_t *b = NULL;
+
+    if( par_verify( (void*)mem, len, &span ) == 0 )
+    {
+        b = new_buffer( L );
+        if( ( b->blk = malloc( sizeof( lparcel_block_t ) + len ) ) ){
+            b->blk->refcnt = 1;
+            b->blk->len = len;
+            memcpy( b->blk->mem, mem, len );
+            return 0;
+        }
+        lua_pop( L, 1 );
+    }
+
+    return -1;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+
+    if( push_copy( L, mem, len ) == 0 ){
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+// MARK: extension type
+// the payload is the serialized data of the buffer. it is appended to the
+// packer without the intermediate string.
+static int pack_ext( lua_State *L, int idx, par_pack_t *p )
+{
+    lparcel_buffer_t *b = lua_touserdata( L, idx );
+
+    return par_pack_encoded( p, b->blk->mem, b->blk->len );
+}
+
+
+static int unpack_ext( lua_State *L, const void *mem, size_t len )
+{
+    return push_copy( L, mem, len );
+}
+
+
+// register( id )
+static int register_lua( lua_State *L )
+{
+    lua_Integer id = luaL_checkinteger( L, 1 );
+
+    luaL_argcheck( L, id >= 0 && id <= UINT8_MAX, 1, "id out of range" );
+    lparcel_ext_register( L, (uint8_t)id, LPARCEL_BUFFER_MT, pack_ext,
+                          unpack_ext );
+
+    return 0;
+}
+
+
+LUALIB_API int luaopen_parcel_buffer( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "new", new_lua },
+        { "adopt", adopt_lua },
+        { "set", set_lua },
+        { "register", register_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__len", len_lua },
+        { "__tostring", tostring_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "set", set_lua },
+        { "bytes", bytes_lua },
+        { "share", share_lua },
+        { NULL, NULL }
+    };
+
+    // create metatable
+    lparcel_define_mt( L, LPARCEL_BUFFER_MT, mmethod, method );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
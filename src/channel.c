@@ -0,0 +1,547 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  channel.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include "lparcel_channel.h"
+
+#define MODULE_MT   LPARCEL_CHANNEL_MT
+
+// default number of slots and bytes of a slot
+#define CHANNEL_NSLOT       1024
+#define CHANNEL_SLOTSIZE    2048
+
+
+#define chan_slot( c, pos ) \
+    ((lparcel_slot_t*)((c)->q->slots + ( (pos) & (c)->mask ) * (c)->stride))
+
+
+// reserve the slot to send. returns NULL if full.
+static lparcel_slot_t *chan_reserve_send( lparcel_channel_t *c, size_t *pos )
+{
+    lparcel_queue_t *q = c->q;
+    size_t cur = __atomic_load_n( &q->enq, __ATOMIC_RELAXED );
+
+    for(;;)
+    {
+        lparcel_slot_t *s = chan_slot( c, cur );
+        intptr_t dif = (intptr_t)__atomic_load_n( &s->seq, __ATOMIC_ACQUIRE ) -
+                       (intptr_t)cur;
+
+        if( dif == 0 ){
+            if( __atomic_compare_exchange_n( &q->enq, &cur, cur + 1, 1,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED ) ){
+                *pos = cur;
+                return s;
+            }
+        }
+        else if( dif < 0 ){
+            return NULL;
+        }
+        else {
+            cur = __atomic_load_n( &q->enq, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+
+// reserve the slot to recv. returns NULL if empty.
+static lparcel_slot_t *chan_reserve_recv( lparcel_channel_t *c, size_t *pos )
+{
+    lparcel_queue_t *q = c->q;
+    size_t cur = __atomic_load_n( &q->deq, __ATOMIC_RELAXED );
+
+    for(;;)
+    {
+        lparcel_slot_t *s = chan_slot( c, cur );
+        intptr_t dif = (intptr_t)__atomic_load_n( &s->seq, __ATOMIC_ACQUIRE ) -
+                       (intptr_t)( cur + 1 );
+
+        if( dif == 0 ){
+            if( __atomic_compare_exchange_n( &q->deq, &cur, cur + 1, 1,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED ) ){
+                *pos = cur;
+                return s;
+            }
+        }
+        else if( dif < 0 ){
+            return NULL;
+        }
+        else {
+            cur = __atomic_load_n( &q->deq, __ATOMIC_RELAXED );
+        }
+    }
+}
+
+
+// MARK: wait and wake
+
+// absolute deadline of timeout seconds. negative timeout never expires.
+static void chan_deadline( struct timespec *ts, lua_Number timeout )
+{
+    clock_gettime( CLOCK_MONOTONIC, ts );
+    if( timeout > 0 )
+    {
+        lua_Number sec = floor( timeout );
+
+        ts->tv_sec += (time_t)sec;
+        ts->tv_nsec += (long)( ( timeout - sec ) * 1000000000 );
+        if( ts->tv_nsec >= 1000000000 ){
+            ts->tv_sec++;
+            ts->tv_nsec -= 1000000000;
+        }
+    }
+}
+
+
+// wait until the counter is changed from val or the deadline is passed.
+// returns -1 if the deadline is passed. the futex of the queue in the shared
+// memory is shared by the processes.
+static int chan_wait( lparcel_channel_t *c, uint32_t *counter, uint32_t val,
+                      const struct timespec *deadline, int forever )
+{
+    struct timespec now, rel;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    if( !forever )
+    {
+        rel.tv_sec = deadline->tv_sec - now.tv_sec;
+        rel.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+        if( rel.tv_nsec < 0 ){
+            rel.tv_sec--;
+            rel.tv_nsec += 1000000000;
+        }
+        if( rel.tv_sec < 0 ){
+            return -1;
+        }
+    }
+
+#if defined(__linux__)
+    syscall( SYS_futex, counter, c->mapsize ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE,
+             val, forever ? NULL : &rel, NULL, 0 );
+#else
+    // poll the counter on the other platforms
+    (void)c;
+    (void)val;
+    sched_yield();
+#endif
+
+    return 0;
+}
+
+
+static void chan_wake( lparcel_channel_t *c, uint32_t *counter,
+                       uint32_t *nwaiter )
+{
+    __atomic_add_fetch( counter, 1, __ATOMIC_SEQ_CST );
+#if defined(__linux__)
+    if( __atomic_load_n( nwaiter, __ATOMIC_SEQ_CST ) ){
+        syscall( SYS_futex, counter,
+                 c->mapsize ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT32_MAX,
+                 NULL, NULL, 0 );
+    }
+#else
+    (void)c;
+    (void)nwaiter;
+#endif
+}
+
+
+// timeout argument at idx. nil: wait forever, 0: do not wait
+static lua_Number chan_checktimeout( lua_State *L, int idx )
+{
+    lua_Number timeout = luaL_optnumber( L, idx, -1 );
+
+    if( lua_isnoneornil( L, idx ) ){
+        return -1;
+    }
+    luaL_argcheck( L, timeout >= 0, idx, "timeout must not be negative" );
+
+    return timeout;
+}
+
+
+// pack the value at 2 into the packer of the light userdata at 1, and return
+// the errno. this is called in lua_pcall, so that the reserved slot is
+// published even if the lua error is raised.
+static int pack_slot_lua( lua_State *L )
+{
+    par_pack_t *p = lua_touserdata( L, 1 );
+
+    lua_pushinteger( L, lparcel_pack_val( p, L, 2 ) ? errno : 0 );
+    return 1;
+}
+
+
+// unpack the value from the unpacker of the light userdata at 1, and return
+// the value and the errno.
+static int unpack_slot_lua( lua_State *L )
+{
+    par_unpack_t *p = lua_touserdata( L, 1 );
+
+    if( lparcel_unpack_val( L, p ) != 0 ){
+        lua_pushnil( L );
+        lua_pushinteger( L, errno );
+    }
+    else {
+        lua_pushinteger( L, 0 );
+    }
+    return 2;
+}
+
+
+// MARK: methods
+
+static int send_lua( lua_State *L )
+{
+    lparcel_channel_t *c = luaL_checkudata( L, 1, MODULE_MT );
+    lparcel_queue_t *q = c->q;
+    lua_Number timeout = chan_checktimeout( L, 3 );
+    struct timespec deadline;
+    lparcel_slot_t *s = NULL;
+    size_t pos = 0;
+    par_pack_t p;
+    int rc = 0;
+    int err = 0;
+
+    // push the arguments of pack_slot_lua before reserving the slot
+    lua_settop( L, 2 );
+    luaL_checkstack( L, 3, NULL );
+    lua_pushcfunction( L, pack_slot_lua );
+    lua_pushlightuserdata( L, (void*)&p );
+    lua_pushvalue( L, 2 );
+    if( !( s = chan_reserve_send( c, &pos ) ) && timeout != 0 )
+    {
+        chan_deadline( &deadline, timeout );
+        __atomic_add_fetch( &q->wsend, 1, __ATOMIC_SEQ_CST );
+        for(;;)
+        {
+            uint32_t nrecv = __atomic_load_n( &q->nrecv, __ATOMIC_SEQ_CST );
+
+            if( ( s = chan_reserve_send( c, &pos ) ) ||
+                chan_wait( c, &q->nrecv, nrecv, &deadline, timeout < 0 ) ){
+                break;
+            }
+        }
+        __atomic_sub_fetch( &q->wsend, 1, __ATOMIC_SEQ_CST );
+    }
+    // full
+    if( !s ){
+        lua_pushboolean( L, 0 );
+        return 1;
+    }
+
+    // pack into the slot. the value larger than the slot is spilled to the
+    // heap memory
+    par_pack_init_mem( &p, s->mem, c->slotsize, NULL );
+    if( ( rc = lua_pcall( L, 2, 1, 0 ) ) == 0 &&
+        ( err = (int)lua_tointeger( L, -1 ) ) == 0 && p.mem != s->mem ){
+        err = EMSGSIZE;
+    }
+    par_pack_dispose( &p );
+    // slot of the failure is skipped by the receivers
+    s->len = ( rc == 0 && err == 0 ) ? p.cur : 0;
+    __atomic_store_n( &s->seq, pos + 1, __ATOMIC_RELEASE );
+    chan_wake( c, &q->nsend, &q->wrecv );
+
+    // rethrow the error after the slot is published
+    if( rc != 0 ){
+        return lua_error( L );
+    }
+    else if( err == 0 ){
+        lua_pushboolean( L, 1 );
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( err ) );
+
+    return 2;
+}
+
+
+static int recv_lua( lua_State *L )
+{
+    lparcel_channel_t *c = luaL_checkudata( L, 1, MODULE_MT );
+    lparcel_queue_t *q = c->q;
+    lua_Number timeout = chan_checktimeout( L, 2 );
+    struct timespec deadline;
+    lparcel_slot_t *s = NULL;
+    size_t pos = 0;
+    size_t len = 0;
+    par_unpack_t p;
+    int rc = 0;
+    int err = 0;
+
+    if( timeout > 0 ){
+        chan_deadline( &deadline, timeout );
+    }
+
+RETRY:
+    // push the arguments of unpack_slot_lua before reserving the slot
+    lua_settop( L, 1 );
+    luaL_checkstack( L, 2, NULL );
+    lua_pushcfunction( L, unpack_slot_lua );
+    lua_pushlightuserdata( L, (void*)&p );
+    if( !( s = chan_reserve_recv( c, &pos ) ) && timeout != 0 )
+    {
+        __atomic_add_fetch( &q->wrecv, 1, __ATOMIC_SEQ_CST );
+        for(;;)
+        {
+            uint32_t nsend = __atomic_load_n( &q->nsend, __ATOMIC_SEQ_CST );
+
+            if( ( s = chan_reserve_recv( c, &pos ) ) ||
+                chan_wait( c, &q->nsend, nsend, &deadline, timeout < 0 ) ){
+                break;
+            }
+        }
+        __atomic_sub_fetch( &q->wrecv, 1, __ATOMIC_SEQ_CST );
+    }
+    // empty
+    if( !s ){
+        return 0;
+    }
+
+    // unpack the value packed by send(). the value in the shared memory is
+    // checked because it can be written by the other process.
+    if( ( len = s->len ) )
+    {
+        if( len > c->slotsize ){
+            err = PARCEL_EILSEQ;
+        }
+        else {
+            par_unpack_init( &p, s->mem, len );
+            p.verified = !c->mapsize;
+            if( ( rc = lua_pcall( L, 1, 2, 0 ) ) == 0 ){
+                err = (int)lua_tointeger( L, -1 );
+            }
+        }
+    }
+    // the slot is released before the error is rethrown
+    __atomic_store_n( &s->seq, pos + c->mask + 1, __ATOMIC_RELEASE );
+    chan_wake( c, &q->nrecv, &q->wsend );
+    // skip the slot of the failure
+    if( !len ){
+        goto RETRY;
+    }
+    else if( rc != 0 ){
+        return lua_error( L );
+    }
+    else if( err == 0 ){
+        lua_pop( L, 1 );
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( err ) );
+
+    return 2;
+}
+
+
+// add a reference to the channel, and return it as the light userdata that
+// can be passed to adopt() of the other lua state.
+static int share_lua( lua_State *L )
+{
+    lparcel_channel_t *c = luaL_checkudata( L, 1, MODULE_MT );
+
+    // queue in the shared memory is opened by the path
+    if( c->mapsize ){
+        return luaL_error( L, "shared memory channel cannot be shared" );
+    }
+    __atomic_add_fetch( &c->q->refcnt, 1, __ATOMIC_RELAXED );
+    lua_pushlightuserdata( L, (void*)c->q );
+
+    return 1;
+}
+
+
+// path of the shared memory to be opened by the other process
+static int path_lua( lua_State *L )
+{
+    lparcel_channel_t *c = luaL_checkudata( L, 1, MODULE_MT );
+
+    if( c->fd == -1 ){
+        return 0;
+    }
+    lua_pushfstring( L, "/proc/%d/fd/%d", (int)getpid(), c->fd );
+
+    return 1;
+}
+
+
+static int fd_lua( lua_State *L )
+{
+    lparcel_channel_t *c = luaL_checkudata( L, 1, MODULE_MT );
+
+    if( c->fd == -1 ){
+        return 0;
+    }
+    lua_pushinteger( L, c->fd );
+
+    return 1;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, MODULE_MT );
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    lparcel_channel_t *c = lua_touserdata( L, 1 );
+
+    if( c->mapsize ){
+        munmap( (void*)c->q, c->mapsize );
+    }
+    else if( c->q &&
+             __atomic_sub_fetch( &c->q->refcnt, 1, __ATOMIC_ACQ_REL ) == 0 ){
+        free( (void*)c->q );
+    }
+    if( c->fd != -1 ){
+        close( c->fd );
+    }
+
+    return 0;
+}
+
+
+lparcel_channel_t *lparcel_channel_new( lua_State *L )
+{
+    lparcel_channel_t *c = lua_newuserdata( L, sizeof( lparcel_channel_t ) );
+
+    *c = (lparcel_channel_t){
+        .q = NULL,
+        .mask = 0,
+        .stride = 0,
+        .slotsize = 0,
+        .mapsize = 0,
+        .fd = -1
+    };
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return c;
+}
+
+
+// adopt( ptr )
+static int adopt_lua( lua_State *L )
+{
+    lparcel_queue_t *q = NULL;
+    lparcel_channel_t *c = NULL;
+
+    luaL_checktype( L, 1, LUA_TLIGHTUSERDATA );
+    q = (lparcel_queue_t*)lua_touserdata( L, 1 );
+    c = lparcel_channel_new( L );
+    c->q = q;
+    c->mask = q->nslot - 1;
+    c->stride = q->stride;
+    c->slotsize = q->slotsize;
+
+    return 1;
+}
+
+
+// new( [nslot [, slotsize]] )
+static int new_lua( lua_State *L )
+{
+    lua_Integer nslot = luaL_optinteger( L, 1, CHANNEL_NSLOT );
+    lua_Integer slotsize = luaL_optinteger( L, 2, CHANNEL_SLOTSIZE );
+    lparcel_channel_t *c = NULL;
+    size_t n = 0;
+    size_t stride = 0;
+    size_t size = 0;
+
+    luaL_argcheck( L, nslot > 0 && nslot <= INT32_MAX, 1,
+                   "nslot out of range" );
+    luaL_argcheck( L, slotsize > 0 && slotsize <= INT32_MAX, 2,
+                   "slotsize out of range" );
+    n = (size_t)nslot;
+    size = lparcel_queue_size( &n, (size_t)slotsize, &stride );
+
+    c = lparcel_channel_new( L );
+    if( !size ){
+        errno = PARCEL_ENOMEM;
+    }
+    else if( ( c->q = calloc( 1, size ) ) ){
+        lparcel_queue_init( c->q, n, (size_t)slotsize, stride );
+        c->mask = n - 1;
+        c->stride = stride;
+        c->slotsize = (size_t)slotsize;
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+LUALIB_API int luaopen_parcel_channel( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "new", new_lua },
+        { "adopt", adopt_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "send", send_lua },
+        { "recv", recv_lua },
+        { "share", share_lua },
+        { "path", path_lua },
+        { "fd", fd_lua },
+        { NULL, NULL }
+    };
+
+    // create metatable
+    lparcel_define_mt( L, MODULE_MT, mmethod, method );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
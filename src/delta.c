@@ -0,0 +1,698 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  delta.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+#include "lparcel.h"
+
+// size of the buffer on the stack for diff() and patch()
+#define DELTA_STACK_BUFSIZE 2048
+
+//
+// patch format
+//
+// a patch is a parcel value that consists of the following nodes;
+//
+//  KEEP: 0                     value is not changed (top-level only)
+//  DEL : 4                     remove the element
+//  SET : [1, val]              replace with val
+//  MAP : SARR 2 key node ... EOS
+//                              patch the elements of map by key
+//  ARR : SARR 3 idx node ... EOS
+//                              patch the elements of array by index
+//
+enum {
+    DELTA_KEEP = 0,
+    DELTA_SET,
+    DELTA_MAP,
+    DELTA_ARR,
+    DELTA_DEL
+};
+
+
+// element of array or map
+typedef struct {
+    // index of array
+    uint_fast64_t idx;
+    // encoded key of map
+    const uint8_t *key;
+    size_t klen;
+    // encoded index of the array section of hybrid array/map that is used
+    // as the key if key is NULL
+    uint8_t kbuf[9];
+    // encoded value, or node of patch
+    const uint8_t *val;
+    size_t vlen;
+    // 1: matched to the element of counterpart
+    int hit;
+} elt_t;
+
+typedef struct {
+    elt_t *elts;
+    size_t len;
+    size_t max;
+} elts_t;
+
+
+#define elts_dispose( e ) free( (e)->elts )
+
+#define elt_key( elt ) ( (elt)->key ? (elt)->key : (elt)->kbuf )
+
+
+static elt_t *elts_push( elts_t *e )
+{
+    if( e->len == e->max )
+    {
+        size_t max = ( e->max ) ? e->max * 2 : 16;
+        elt_t *elts = realloc( e->elts, sizeof( elt_t ) * max );
+
+        if( !elts ){
+            return NULL;
+        }
+        e->elts = elts;
+        e->max = max;
+    }
+
+    return memset( (void*)&e->elts[e->len++], 0, sizeof( elt_t ) );
+}
+
+
+static int elt_cmp( const void *a, const void *b )
+{
+    const elt_t *x = (const elt_t*)a;
+    const elt_t *y = (const elt_t*)b;
+    int rv = 0;
+
+    if( !x->klen ){
+        return ( x->idx > y->idx ) - ( x->idx < y->idx );
+    }
+
+    rv = memcmp( elt_key( x ), elt_key( y ),
+                 ( x->klen < y->klen ) ? x->klen : y->klen );
+    if( rv ){
+        return rv;
+    }
+
+    return ( x->klen > y->klen ) - ( x->klen < y->klen );
+}
+
+
+#define elts_sort( e ) do { \
+    if( (e)->len ){ \
+        qsort( (void*)(e)->elts, (e)->len, sizeof( elt_t ), elt_cmp ); \
+    } \
+}while(0)
+
+#define elts_find( e, elt ) \
+    ( (e)->len ? (elt_t*)bsearch( (const void*)(elt), (const void*)(e)->elts, \
+                                  (e)->len, sizeof( elt_t ), elt_cmp ) : NULL )
+
+
+// unsigned integer value of array index
+static int ext2idx( par_extract_t *ext, uint_fast64_t *idx )
+{
+    switch( ext->isa ){
+        case PAR_ISA_S6:
+            *idx = (uint_fast64_t)ext->val.i8;
+            return 0;
+        case PAR_ISA_U8:
+            *idx = ext->val.u8;
+            return 0;
+        case PAR_ISA_U16:
+            *idx = ext->val.u16;
+            return 0;
+        case PAR_ISA_U32:
+            *idx = ext->val.u32;
+            return 0;
+        case PAR_ISA_U64:
+            *idx = ext->val.u64;
+            return 0;
+    }
+
+    // illegal byte sequence
+    errno = PARCEL_EILSEQ;
+    return -1;
+}
+
+
+// encode the index of the array section as the key of map
+static int idx2key( elt_t *elt, uint_fast64_t idx )
+{
+    par_pack_t p;
+
+    par_pack_init_mem( &p, elt->kbuf, sizeof( elt->kbuf ), NULL );
+    if( par_pack_uint( &p, idx ) != 0 ){
+        return -1;
+    }
+    elt->klen = p.cur;
+
+    return 0;
+}
+
+
+// kind of container: DELTA_MAP, DELTA_ARR or DELTA_KEEP for other values.
+// the hybrid array/map is patched by key as the map.
+static int kindof( const uint8_t *val )
+{
+    switch( *val ){
+        case PAR_ISA_ARR4 ... PAR_ISA_ARR4_TAIL:
+        case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+        case PAR_ISA_SARR:
+        case PAR_ISA_IARR:
+            return DELTA_ARR;
+
+        case PAR_ISA_MAP4 ... PAR_ISA_MAP4_TAIL:
+        case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+        case PAR_ISA_SMAP:
+        case PAR_ISA_IMAP:
+        case PAR_ISA_HYB:
+            return DELTA_MAP;
+    }
+
+    return DELTA_KEEP;
+}
+
+
+// read the elements of container at the cursor position.
+// keys of map must be a scalar value, and values are skipped as a whole.
+static int read_elts( par_unpack_t *p, int kind, elts_t *e )
+{
+    par_extract_t ext;
+    uint_fast64_t seq = 1;
+    uint_fast64_t idx = 0;
+    size_t len = 0;
+    size_t narr = 0;
+    int stream = 0;
+    int rc = par_unpack( p, &ext );
+
+    if( rc != 0 ){
+        return rc;
+    }
+    stream = ( ext.isa == PAR_ISA_SARR || ext.isa == PAR_ISA_SMAP );
+    len = ext.size.len;
+    // key/value pairs follow the array section
+    if( ext.isa == PAR_ISA_HYB ){
+        narr = len;
+        len += par_hyb_nmap( &ext );
+    }
+
+    while( stream || len-- )
+    {
+        size_t cur = p->cur;
+        elt_t *elt = NULL;
+
+        // value of the array section is keyed by the consecutive index
+        if( narr ){
+            narr--;
+            if( !( elt = elts_push( e ) ) ||
+                par_unpack_skip( p, &ext ) != 0 ||
+                idx2key( elt, seq++ ) != 0 ){
+                return -1;
+            }
+            elt->val = (uint8_t*)p->mem + cur;
+            elt->vlen = p->cur - cur;
+            continue;
+        }
+        else if( kind == DELTA_MAP ){
+            rc = par_unpack_key( p, &ext, stream );
+        }
+        // non-consecutive index
+        else if( ( rc = par_unpack_skip( p, &ext ) ) == PAR_ISA_IDX )
+        {
+            if( ( rc = par_unpack( p, &ext ) ) != 0 ||
+                ( rc = ext2idx( &ext, &idx ) ) != 0 ){
+                return -1;
+            }
+            rc = PAR_ISA_IDX;
+        }
+
+        // end-of-stream
+        if( rc == PAR_ISA_EOS && stream ){
+            return 0;
+        }
+        else if( rc < 0 || rc == PAR_ISA_EOS ){
+            return -1;
+        }
+        else if( !( elt = elts_push( e ) ) ){
+            return -1;
+        }
+
+        // key and value
+        if( kind == DELTA_MAP || rc == PAR_ISA_IDX )
+        {
+            if( kind == DELTA_MAP ){
+                elt->key = (uint8_t*)p->mem + cur;
+                elt->klen = p->cur - cur;
+            }
+            else {
+                elt->idx = idx;
+            }
+            cur = p->cur;
+            if( ( rc = par_unpack_skip( p, &ext ) ) != 0 ){
+                return -1;
+            }
+        }
+        // consecutive value
+        else {
+            elt->idx = seq++;
+        }
+        elt->val = (uint8_t*)p->mem + cur;
+        elt->vlen = p->cur - cur;
+    }
+
+    return 0;
+}
+
+
+// MARK: diff
+
+static int diff_val( par_pack_t *p, const uint8_t *oval, size_t olen,
+                     const uint8_t *nval, size_t nlen );
+
+static int diff_elts( par_pack_t *p, int kind, elts_t *olds, elts_t *news )
+{
+    size_t i = 0;
+
+    elts_sort( olds );
+    for(; i < news->len; i++ )
+    {
+        elt_t *nelt = &news->elts[i];
+        elt_t *oelt = elts_find( olds, nelt );
+        size_t cur = p->cur;
+        int rc = 0;
+
+        // key
+        if( kind == DELTA_MAP ){
+            rc = par_pack_encoded( p, elt_key( nelt ), nelt->klen );
+        }
+        else {
+            rc = par_pack_uint( p, nelt->idx );
+        }
+        if( rc != 0 ){
+            return -1;
+        }
+
+        // added
+        if( !oelt ){
+            rc = diff_val( p, NULL, 0, nelt->val, nelt->vlen );
+        }
+        // unchanged or not
+        else {
+            oelt->hit = 1;
+            rc = diff_val( p, oelt->val, oelt->vlen, nelt->val, nelt->vlen );
+        }
+
+        if( rc == DELTA_KEEP ){
+            p->cur = cur;
+        }
+        else if( rc < 0 ){
+            return -1;
+        }
+    }
+
+    // removed
+    for( i = 0; i < olds->len; i++ )
+    {
+        elt_t *oelt = &olds->elts[i];
+
+        if( !oelt->hit )
+        {
+            int rc = ( kind == DELTA_MAP ) ?
+                     par_pack_encoded( p, elt_key( oelt ), oelt->klen ) :
+                     par_pack_uint( p, oelt->idx );
+
+            if( rc != 0 || par_pack_uint( p, DELTA_DEL ) != 0 ){
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+static int diff_set( par_pack_t *p, const uint8_t *nval, size_t nlen )
+{
+    if( par_pack_array( p, 2 ) == 0 &&
+        par_pack_uint( p, DELTA_SET ) == 0 &&
+        par_pack_encoded( p, nval, nlen ) == 0 ){
+        return DELTA_SET;
+    }
+
+    return -1;
+}
+
+
+// append the patch node of old value to new value.
+// returns DELTA_KEEP without appending if they are equal.
+static int diff_val( par_pack_t *p, const uint8_t *oval, size_t olen,
+                     const uint8_t *nval, size_t nlen )
+{
+    int kind = 0;
+
+    if( !oval ){
+        return diff_set( p, nval, nlen );
+    }
+    else if( olen == nlen && memcmp( oval, nval, nlen ) == 0 ){
+        return DELTA_KEEP;
+    }
+    // patch the elements of same kind of containers
+    else if( ( kind = kindof( oval ) ) != DELTA_KEEP && kind == kindof( nval ) )
+    {
+        size_t cur = p->cur;
+        elts_t olds = { NULL, 0, 0 };
+        elts_t news = { NULL, 0, 0 };
+        par_unpack_t o, n;
+        int rc = -1;
+
+        par_unpack_init( &o, (void*)oval, olen );
+        par_unpack_init( &n, (void*)nval, nlen );
+        o.verified = n.verified = 1;
+        if( read_elts( &o, kind, &olds ) == 0 &&
+            read_elts( &n, kind, &news ) == 0 &&
+            par_pack_sarray( p ) == 0 &&
+            par_pack_uint( p, (uint_fast64_t)kind ) == 0 &&
+            diff_elts( p, kind, &olds, &news ) == 0 &&
+            par_pack_eos( p ) == 0 ){
+            rc = kind;
+        }
+        elts_dispose( &olds );
+        elts_dispose( &news );
+
+        // use SET node if it is not larger
+        if( rc < 0 || p->cur - cur < nlen + 2 ){
+            return rc;
+        }
+        p->cur = cur;
+    }
+
+    return diff_set( p, nval, nlen );
+}
+
+
+static int diff_lua( lua_State *L )
+{
+    size_t olen = 0;
+    size_t nlen = 0;
+    const char *oval = lparcel_checkbin( L, 1, &olen );
+    const char *nval = lparcel_checkbin( L, 2, &nlen );
+    char buf[DELTA_STACK_BUFSIZE];
+    par_pack_t p;
+
+    par_pack_init_mem( &p, buf, sizeof( buf ), NULL );
+    if( par_verify( (void*)oval, olen, &olen ) == 0 &&
+        par_verify( (void*)nval, nlen, &nlen ) == 0 )
+    {
+        int rc = diff_val( &p, (const uint8_t*)oval, olen,
+                           (const uint8_t*)nval, nlen );
+
+        if( rc == DELTA_KEEP ){
+            rc = par_pack_uint( &p, DELTA_KEEP );
+        }
+        if( rc >= 0 ){
+            lua_pushlstring( L, p.mem, p.cur );
+            par_pack_dispose( &p );
+            return 1;
+        }
+    }
+    par_pack_dispose( &p );
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+// MARK: patch
+
+static int patch_val( par_pack_t *p, par_unpack_t *patch, const uint8_t *oval,
+                      size_t olen );
+
+// read the elements of the patch node, and sort them by key
+static int read_nodes( par_unpack_t *patch, int kind, elts_t *nodes )
+{
+    par_extract_t ext;
+
+    while( 1 )
+    {
+        size_t cur = patch->cur;
+        elt_t *elt = NULL;
+        int rc = ( kind == DELTA_MAP ) ? par_unpack_key( patch, &ext, 1 ) :
+                                         par_unpack( patch, &ext );
+
+        if( rc == PAR_ISA_EOS || ( rc == 0 && ext.isa == PAR_ISA_EOS ) ){
+            elts_sort( nodes );
+            return 0;
+        }
+        else if( rc != 0 || !( elt = elts_push( nodes ) ) ){
+            return -1;
+        }
+        else if( kind == DELTA_MAP ){
+            elt->key = (uint8_t*)patch->mem + cur;
+            elt->klen = patch->cur - cur;
+        }
+        else if( ext2idx( &ext, &elt->idx ) != 0 ){
+            return -1;
+        }
+
+        // node
+        cur = patch->cur;
+        if( par_unpack_skip( patch, &ext ) != 0 ){
+            errno = PARCEL_EILSEQ;
+            return -1;
+        }
+        elt->val = (uint8_t*)patch->mem + cur;
+        elt->vlen = patch->cur - cur;
+    }
+}
+
+
+static inline int is_del( elt_t *node )
+{
+    return node->vlen == 1 && *node->val == DELTA_DEL;
+}
+
+
+// append key and index of array
+static int patch_key( par_pack_t *p, int kind, elt_t *elt, uint_fast64_t *seq )
+{
+    if( kind == DELTA_MAP ){
+        return par_pack_encoded( p, elt_key( elt ), elt->klen );
+    }
+    else if( elt->idx == *seq ){
+        (*seq)++;
+        return 0;
+    }
+
+    return par_pack_idx( p, elt->idx );
+}
+
+
+static int patch_node( par_pack_t *p, elt_t *node, const uint8_t *oval,
+                       size_t olen )
+{
+    par_unpack_t patch;
+
+    par_unpack_init( &patch, (void*)node->val, node->vlen );
+    return patch_val( p, &patch, oval, olen );
+}
+
+
+static int patch_elts( par_pack_t *p, int kind, elts_t *olds, elts_t *nodes )
+{
+    uint_fast64_t seq = 1;
+    size_t len = olds->len;
+    size_t i = 0;
+
+    // count number of elements
+    for(; i < olds->len; i++ )
+    {
+        elt_t *node = elts_find( nodes, &olds->elts[i] );
+
+        if( node ){
+            node->hit = 1;
+            len -= is_del( node );
+        }
+    }
+    for( i = 0; i < nodes->len; i++ )
+    {
+        if( !nodes->elts[i].hit ){
+            // cannot remove the element that does not exist
+            if( is_del( &nodes->elts[i] ) ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+            len++;
+        }
+    }
+
+    if( ( ( kind == DELTA_MAP ) ? par_pack_map( p, len ) :
+                                  par_pack_array( p, len ) ) != 0 ){
+        return -1;
+    }
+
+    // patch or copy the elements
+    for( i = 0; i < olds->len; i++ )
+    {
+        elt_t *oelt = &olds->elts[i];
+        elt_t *node = elts_find( nodes, oelt );
+
+        if( node && is_del( node ) ){
+            continue;
+        }
+        else if( patch_key( p, kind, oelt, &seq ) != 0 ||
+                 ( node ? patch_node( p, node, oelt->val, oelt->vlen ) :
+                          par_pack_encoded( p, oelt->val, oelt->vlen ) ) != 0 ){
+            return -1;
+        }
+    }
+
+    // added elements
+    for( i = 0; i < nodes->len; i++ )
+    {
+        elt_t *node = &nodes->elts[i];
+
+        if( !node->hit && ( patch_key( p, kind, node, &seq ) != 0 ||
+                            patch_node( p, node, NULL, 0 ) != 0 ) ){
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+// append the value of old value patched by the node
+static int patch_val( par_pack_t *p, par_unpack_t *patch, const uint8_t *oval,
+                      size_t olen )
+{
+    par_extract_t ext;
+    uint_fast64_t op = 0;
+    size_t cur = 0;
+
+    if( par_unpack( patch, &ext ) != 0 ){
+        return -1;
+    }
+
+    switch( ext.isa )
+    {
+        // KEEP
+        case PAR_ISA_S6:
+            if( ext.val.i8 == DELTA_KEEP && oval ){
+                return par_pack_encoded( p, oval, olen );
+            }
+        break;
+
+        // SET
+        case PAR_ISA_ARR4:
+            if( ext.size.len == 2 && par_unpack( patch, &ext ) == 0 &&
+                ext2idx( &ext, &op ) == 0 && op == DELTA_SET )
+            {
+                cur = patch->cur;
+                if( par_unpack_skip( patch, &ext ) == 0 ){
+                    return par_pack_encoded( p, (uint8_t*)patch->mem + cur,
+                                             patch->cur - cur );
+                }
+            }
+        break;
+
+        // MAP or ARR
+        case PAR_ISA_SARR:
+            if( oval && par_unpack( patch, &ext ) == 0 &&
+                ext2idx( &ext, &op ) == 0 &&
+                ( op == DELTA_MAP || op == DELTA_ARR ) &&
+                kindof( oval ) == (int)op )
+            {
+                elts_t olds = { NULL, 0, 0 };
+                elts_t nodes = { NULL, 0, 0 };
+                par_unpack_t o;
+                int rc = -1;
+
+                par_unpack_init( &o, (void*)oval, olen );
+                o.verified = 1;
+                if( read_elts( &o, (int)op, &olds ) == 0 &&
+                    read_nodes( patch, (int)op, &nodes ) == 0 ){
+                    rc = patch_elts( p, (int)op, &olds, &nodes );
+                }
+                elts_dispose( &olds );
+                elts_dispose( &nodes );
+                return rc;
+            }
+        break;
+    }
+
+    // illegal patch node
+    errno = PARCEL_EILSEQ;
+    return -1;
+}
+
+
+static int patch_lua( lua_State *L )
+{
+    size_t olen = 0;
+    size_t plen = 0;
+    const char *oval = lparcel_checkbin( L, 1, &olen );
+    const char *patch = lparcel_checkbin( L, 2, &plen );
+    char buf[DELTA_STACK_BUFSIZE];
+    size_t span = 0;
+    par_pack_t p;
+    par_unpack_t u;
+
+    par_pack_init_mem( &p, buf, sizeof( buf ), NULL );
+    par_unpack_init( &u, (void*)patch, plen );
+    // references in the copied values must point into the result
+    if( par_verify( (void*)oval, olen, &olen ) == 0 &&
+        patch_val( &p, &u, (const uint8_t*)oval, olen ) == 0 &&
+        par_verify( p.mem, p.cur, &span ) == 0 ){
+        lua_pushlstring( L, p.mem, p.cur );
+        par_pack_dispose( &p );
+        return 1;
+    }
+    par_pack_dispose( &p );
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+LUALIB_API int luaopen_parcel_delta( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "diff", diff_lua },
+        { "patch", patch_lua },
+        { NULL, NULL }
+    };
+
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
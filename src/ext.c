@@ -0,0 +1,253 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  ext.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#include "lparcel.h"
+
+#define HANDLER_MT  "parcel.ext.handler"
+
+
+static int gc_lua( lua_State *L )
+{
+    lparcel_ext_t *e = lua_touserdata( L, 1 );
+
+    lstate_unref( L, e->ref_encode );
+    lstate_unref( L, e->ref_decode );
+
+    return 0;
+}
+
+
+// push the registry table of handlers
+static void push_registry( lua_State *L )
+{
+    lua_pushliteral( L, LPARCEL_EXT_REG );
+    lua_rawget( L, LUA_REGISTRYINDEX );
+    if( !lua_istable( L, -1 ) ){
+        lua_pop( L, 1 );
+        lua_newtable( L );
+        lua_pushliteral( L, LPARCEL_EXT_REG );
+        lua_pushvalue( L, -2 );
+        lua_rawset( L, LUA_REGISTRYINDEX );
+    }
+}
+
+
+// remove all entries of the handler at the top of stack from the registry
+// at idx, and pop the handler.
+static void remove_handler( lua_State *L, int idx )
+{
+    if( !lua_isnil( L, -1 ) )
+    {
+        lua_pushnil( L );
+        while( lua_next( L, idx ) ){
+            if( lua_rawequal( L, -1, -3 ) ){
+                lua_pushvalue( L, -2 );
+                lua_pushnil( L );
+                lua_rawset( L, idx );
+            }
+            lua_pop( L, 1 );
+        }
+    }
+    lua_pop( L, 1 );
+}
+
+
+// push a new handler of id
+static lparcel_ext_t *new_handler( lua_State *L, uint8_t id )
+{
+    lparcel_ext_t *e = lua_newuserdata( L, sizeof( lparcel_ext_t ) );
+
+    *e = (lparcel_ext_t){
+        .id = id,
+        .packf = NULL,
+        .unpackf = NULL,
+        .ref_encode = LUA_NOREF,
+        .ref_decode = LUA_NOREF
+    };
+    luaL_getmetatable( L, HANDLER_MT );
+    lua_setmetatable( L, -2 );
+
+    return e;
+}
+
+
+// register the handler at the top of stack by the metatable at idx and its
+// id, and pop the handler. the handlers of the same metatable or id are
+// replaced.
+static void set_handler( lua_State *L, int idx )
+{
+    lparcel_ext_t *e = lua_touserdata( L, -1 );
+    int reg = 0;
+
+    if( idx < 0 ){
+        idx = lua_gettop( L ) + idx + 1;
+    }
+    push_registry( L );
+    reg = lua_gettop( L );
+    lua_pushinteger( L, e->id );
+    lua_rawget( L, reg );
+    remove_handler( L, reg );
+    lua_pushvalue( L, idx );
+    lua_rawget( L, reg );
+    remove_handler( L, reg );
+
+    lua_pushvalue( L, idx );
+    lua_pushvalue( L, -3 );
+    lua_rawset( L, reg );
+    lua_pushvalue( L, -2 );
+    lua_rawseti( L, reg, e->id );
+    lua_pop( L, 2 );
+}
+
+
+int lparcel_ext_register( lua_State *L, uint8_t id, const char *tname,
+                          lparcel_ext_pack_t packf,
+                          lparcel_ext_unpack_t unpackf )
+{
+    lparcel_ext_t *e = NULL;
+
+    luaL_getmetatable( L, tname );
+    if( !lua_istable( L, -1 ) ){
+        lua_pop( L, 1 );
+        errno = EINVAL;
+        return -1;
+    }
+    e = new_handler( L, id );
+    e->packf = packf;
+    e->unpackf = unpackf;
+    set_handler( L, -2 );
+    lua_pop( L, 1 );
+
+    return 0;
+}
+
+
+// unpack the payload by the handler of the type id. the value is pushed on
+// success, and nothing is pushed on failure.
+int lparcel_unpack_ext( lua_State *L, par_extract_t *ext )
+{
+    lparcel_ext_t *e = NULL;
+
+    if( !lua_checkstack( L, 3 ) ){
+        errno = PARCEL_ENOMEM;
+        return -1;
+    }
+
+    lua_pushinteger( L, par_ext_id( ext ) );
+    if( !( e = lparcel_ext_find( L ) ) ){
+        lua_pop( L, 1 );
+        errno = PARCEL_ENOTSUP;
+        return -1;
+    }
+    // lua callback
+    else if( e->ref_decode != LUA_NOREF )
+    {
+        lstate_pushref( L, e->ref_decode );
+        lua_pushlstring( L, ext->val.bytea, ext->size.len );
+        if( lua_pcall( L, 1, 1, 0 ) != 0 ){
+            lua_pop( L, 2 );
+            errno = PARCEL_EILSEQ;
+            return -1;
+        }
+    }
+    else if( e->unpackf( L, ext->val.bytea, ext->size.len ) != 0 ){
+        lua_pop( L, 1 );
+        return -1;
+    }
+    lua_replace( L, -2 );
+
+    return 0;
+}
+
+
+// register( id, mt, encode, decode )
+static int register_lua( lua_State *L )
+{
+    lua_Integer id = luaL_checkinteger( L, 1 );
+    lparcel_ext_t *e = NULL;
+
+    luaL_argcheck( L, id >= 0 && id <= UINT8_MAX, 1, "id out of range" );
+    if( lua_type( L, 2 ) == LUA_TSTRING ){
+        luaL_getmetatable( L, lua_tostring( L, 2 ) );
+        luaL_argcheck( L, lua_istable( L, -1 ), 2, "metatable not found" );
+        lua_replace( L, 2 );
+    }
+    luaL_checktype( L, 2, LUA_TTABLE );
+    luaL_checktype( L, 3, LUA_TFUNCTION );
+    luaL_checktype( L, 4, LUA_TFUNCTION );
+    lua_settop( L, 4 );
+
+    e = new_handler( L, (uint8_t)id );
+    lua_pushvalue( L, 3 );
+    e->ref_encode = lstate_ref( L );
+    lua_pushvalue( L, 4 );
+    e->ref_decode = lstate_ref( L );
+    set_handler( L, 2 );
+
+    return 0;
+}
+
+
+// unregister( id )
+static int unregister_lua( lua_State *L )
+{
+    lua_Integer id = luaL_checkinteger( L, 1 );
+    int reg = 0;
+
+    luaL_argcheck( L, id >= 0 && id <= UINT8_MAX, 1, "id out of range" );
+    push_registry( L );
+    reg = lua_gettop( L );
+    lua_rawgeti( L, reg, (int)id );
+    lua_pushboolean( L, !lua_isnil( L, -1 ) );
+    lua_insert( L, -2 );
+    remove_handler( L, reg );
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_parcel_ext( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "register", register_lua },
+        { "unregister", unregister_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { NULL, NULL }
+    };
+
+    // create metatable
+    lparcel_define_mt( L, HANDLER_MT, mmethod, NULL );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
@@ -42,6 +42,39 @@ LUALIB_API int luaopen_parcel( lua_State *L )
     luaopen_parcel_unpack( L );
     lua_rawset( L, -3 );
 
+    lua_pushstring( L, "delta" );
+    luaopen_parcel_delta( L );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "buffer" );
+    luaopen_parcel_buffer( L );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "view" );
+    luaopen_parcel_view( L );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "record" );
+    luaopen_parcel_record( L );
+    // parcel.compile is parcel.record.compile
+    lua_pushstring( L, "compile" );
+    lua_pushstring( L, "compile" );
+    lua_rawget( L, -3 );
+    lua_rawset( L, -5 );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "ext" );
+    luaopen_parcel_ext( L );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "channel" );
+    luaopen_parcel_channel( L );
+    lua_rawset( L, -3 );
+
+    lua_pushstring( L, "shm" );
+    luaopen_parcel_shm( L );
+    lua_rawset( L, -3 );
+
     return 1;
 }
 
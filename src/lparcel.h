@@ -30,6 +30,7 @@
 #define ___LUA_PARCEL_H___
 
 #include "parcel.h"
+#include <time.h>
 #include <lua.h>
 #include <lauxlib.h>
 
@@ -56,9 +57,100 @@
 #define LUANUM_ISUINT(val)  (!signbit( val ) && !LUANUM_ISDBL( val ))
 
 
+// set the number at idx to the number key. the integer of lua 5.3 or later
+// is compared as the integer.
+static inline void lparcel_numkey( lua_State *L, int idx, par_key_t *key )
+{
+#if LUA_VERSION_NUM >= 503
+    if( lua_isinteger( L, idx ) ){
+        par_key_int( key, (int64_t)lua_tointeger( L, idx ) );
+        return;
+    }
+#endif
+    par_key_num( key, lua_tonumber( L, idx ) );
+}
+
+
+// push the number key
+static inline void lparcel_pushnumkey( lua_State *L, const par_key_t *key )
+{
+    if( key->isint ){
+        lua_pushinteger( L, (lua_Integer)key->i64 );
+    }
+    else if( LUANUM_ISDBL( key->num ) ){
+        lua_pushnumber( L, key->num );
+    }
+    else {
+        lua_pushinteger( L, (lua_Integer)key->num );
+    }
+}
+
+
 // prototypes
 LUALIB_API int luaopen_parcel_pack( lua_State *L );
 LUALIB_API int luaopen_parcel_unpack( lua_State *L );
+LUALIB_API int luaopen_parcel_delta( lua_State *L );
+LUALIB_API int luaopen_parcel_buffer( lua_State *L );
+LUALIB_API int luaopen_parcel_view( lua_State *L );
+LUALIB_API int luaopen_parcel_record( lua_State *L );
+LUALIB_API int luaopen_parcel_ext( lua_State *L );
+LUALIB_API int luaopen_parcel_channel( lua_State *L );
+LUALIB_API int luaopen_parcel_shm( lua_State *L );
+
+// unpack a value at the cursor position. see unpack.c
+int lparcel_unpack_val( lua_State *L, par_unpack_t *p );
+
+
+// MARK: extension types
+// handlers of the userdata of the metatable are registered to the table
+// LPARCEL_EXT_REG in the registry by the metatable and the type id.
+// see ext.c
+#define LPARCEL_EXT_REG     "parcel.ext"
+
+// append the payload of the userdata at idx to the packer
+typedef int (*lparcel_ext_pack_t)( lua_State *L, int idx, par_pack_t *p );
+// push the value of the payload
+typedef int (*lparcel_ext_unpack_t)( lua_State *L, const void *mem,
+                                     size_t len );
+
+typedef struct {
+    uint8_t id;
+    // C handlers
+    lparcel_ext_pack_t packf;
+    lparcel_ext_unpack_t unpackf;
+    // lua callbacks
+    int ref_encode;
+    int ref_decode;
+} lparcel_ext_t;
+
+// register the handlers of the userdata of the metatable tname.
+// returns -1 if the metatable is not found.
+int lparcel_ext_register( lua_State *L, uint8_t id, const char *tname,
+                          lparcel_ext_pack_t packf,
+                          lparcel_ext_unpack_t unpackf );
+
+// unpack the extension value extracted by ext
+int lparcel_unpack_ext( lua_State *L, par_extract_t *ext );
+
+
+// push the handler of key at the top of stack, and return it.
+// the key is replaced with the handler or nil.
+static inline lparcel_ext_t *lparcel_ext_find( lua_State *L )
+{
+    lua_pushliteral( L, LPARCEL_EXT_REG );
+    lua_rawget( L, LUA_REGISTRYINDEX );
+    if( lua_istable( L, -1 ) ){
+        lua_insert( L, -2 );
+        lua_rawget( L, -2 );
+        lua_remove( L, -2 );
+        return (lparcel_ext_t*)lua_touserdata( L, -1 );
+    }
+    lua_pop( L, 1 );
+    lua_pushnil( L );
+    lua_replace( L, -2 );
+
+    return NULL;
+}
 
 
 // common metamethods
@@ -68,6 +160,152 @@ LUALIB_API int luaopen_parcel_unpack( lua_State *L );
 })
 
 
+// mutable buffer of the serialized data
+#define LPARCEL_BUFFER_MT   "parcel.buffer"
+
+// memory block of the buffer. the block is shared by the buffers of the lua
+// states by the atomic reference count, and is immutable while shared.
+typedef struct {
+    size_t refcnt;
+    size_t len;
+    char mem[];
+} lparcel_block_t;
+
+typedef struct {
+    lparcel_block_t *blk;
+} lparcel_buffer_t;
+
+
+// add a reference to the block
+static inline lparcel_block_t *lparcel_block_retain( lparcel_block_t *blk )
+{
+    __atomic_add_fetch( &blk->refcnt, 1, __ATOMIC_RELAXED );
+    return blk;
+}
+
+
+// release a reference to the block, and free it by the last reference
+static inline void lparcel_block_release( lparcel_block_t *blk )
+{
+    if( __atomic_sub_fetch( &blk->refcnt, 1, __ATOMIC_ACQ_REL ) == 0 ){
+        free( (void*)blk );
+    }
+}
+
+
+// block is referenced by the other buffers
+static inline int lparcel_block_shared( lparcel_block_t *blk )
+{
+    return __atomic_load_n( &blk->refcnt, __ATOMIC_ACQUIRE ) > 1;
+}
+
+
+// push the buffer of the block. the reference to the block is moved to the
+// buffer. see buffer.c
+void lparcel_buffer_push( lua_State *L, lparcel_block_t *blk );
+
+
+// serialized data of string or parcel.buffer
+static inline const char *lparcel_checkbin( lua_State *L, int idx,
+                                            size_t *len )
+{
+    if( lua_type( L, idx ) == LUA_TUSERDATA ){
+        lparcel_buffer_t *b = luaL_checkudata( L, idx, LPARCEL_BUFFER_MT );
+
+        *len = b->blk->len;
+        return b->blk->mem;
+    }
+
+    return luaL_checklstring( L, idx, len );
+}
+
+
+// statistics
+static inline uint_fast64_t lparcel_nsec( void )
+{
+#if defined(PARCEL_NO_STATS)
+    return 0;
+#else
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint_fast64_t)ts.tv_sec * 1000000000 + (uint_fast64_t)ts.tv_nsec;
+#endif
+}
+
+
+// account a pack/unpack call
+static inline void lparcel_stats_update( par_stats_t *s, size_t bytes,
+                                         uint_fast64_t start )
+{
+#if !defined(PARCEL_NO_STATS)
+    s->ncall++;
+    s->bytes += bytes;
+    s->nsec += lparcel_nsec() - start;
+#endif
+}
+
+
+#define lstate_int2tbl(L,k,v) do{ \
+    lua_pushstring(L,k); \
+    lua_pushinteger(L,(lua_Integer)(v)); \
+    lua_rawset(L,-3); \
+}while(0)
+
+static inline void lparcel_pushstats( lua_State *L, par_stats_t *s )
+{
+    int i = 0;
+
+    lua_createtable( L, 0, 8 );
+    lstate_int2tbl( L, "bytes", s->bytes );
+    lstate_int2tbl( L, "peak", s->peak );
+    lstate_int2tbl( L, "realloc", s->nrealloc );
+    lstate_int2tbl( L, "reduce", s->nreduce );
+    lstate_int2tbl( L, "calls", s->ncall );
+    lstate_int2tbl( L, "maxdepth", s->maxdepth );
+    // cumulative time in seconds
+    lua_pushstring( L, "time" );
+    lua_pushnumber( L, (lua_Number)s->nsec / 1000000000 );
+    lua_rawset( L, -3 );
+
+    // number of values per type name
+    lua_pushstring( L, "isa" );
+    lua_newtable( L );
+    for(; i < 256; i++ )
+    {
+        if( s->isa[i] ){
+            const char *name = par_isa_name( (uint8_t)i );
+
+            lua_pushstring( L, name );
+            lua_rawget( L, -2 );
+            lua_pushstring( L, name );
+            lua_pushinteger( L, lua_tointeger( L, -2 ) +
+                                (lua_Integer)s->isa[i] );
+            lua_rawset( L, -4 );
+            lua_pop( L, 1 );
+        }
+    }
+    lua_rawset( L, -3 );
+}
+
+#undef lstate_int2tbl
+
+
+// stats( [reset] ) method of packer/unpacker objects
+static inline int lparcel_stats( lua_State *L, par_stats_t *s )
+{
+    int reset = lua_toboolean( L, 2 );
+
+    lparcel_pushstats( L, s );
+    // clear counters
+    if( reset ){
+        memset( (void*)s, 0, sizeof( par_stats_t ) );
+    }
+
+    return 1;
+}
+
+
 // metanames
 // module definition register
 static inline int lparcel_define_method( lua_State *L,
@@ -111,6 +349,8 @@ static inline int lparcel_define_mt( lua_State *L, const char *tname,
 
         return 1;
     }
+    // pop the existing metatable
+    lua_pop( L, 1 );
 
     return 0;
 }
@@ -0,0 +1,133 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  lparcel_channel.h
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+#ifndef ___LUA_PARCEL_CHANNEL_H___
+#define ___LUA_PARCEL_CHANNEL_H___
+
+#include "lparcel_pack.h"
+
+#define LPARCEL_CHANNEL_MT  "parcel.channel"
+
+// size of cache line
+#define LPARCEL_CHANNEL_CACHELINE   64
+
+// magic number of the queue in the shared memory
+#define LPARCEL_QUEUE_MAGIC 0x7061724bU
+
+// bounded queue of the packed values. each slot has the sequence number of
+// the position that can be used next, so that the senders and receivers of
+// the lua states of the different threads reserve the slots without locks.
+// see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+typedef struct {
+    size_t seq;
+    // number of packed bytes. 0: failed to pack
+    size_t len;
+    char mem[];
+} lparcel_slot_t;
+
+typedef struct {
+    size_t magic;
+    size_t refcnt;
+    size_t nslot;
+    size_t slotsize;
+    size_t stride;
+    char pad0[LPARCEL_CHANNEL_CACHELINE];
+    // position of the next send
+    size_t enq;
+    char pad1[LPARCEL_CHANNEL_CACHELINE];
+    // position of the next recv
+    size_t deq;
+    char pad2[LPARCEL_CHANNEL_CACHELINE];
+    // counters of send/recv to wait, and the number of waiters
+    uint32_t nsend;
+    uint32_t nrecv;
+    uint32_t wsend;
+    uint32_t wrecv;
+    char pad3[LPARCEL_CHANNEL_CACHELINE];
+    char slots[];
+} lparcel_queue_t;
+
+// the geometry of the queue is copied to the channel, so that the slots are
+// not moved out of the mapping by the other process.
+typedef struct {
+    lparcel_queue_t *q;
+    size_t mask;
+    size_t stride;
+    size_t slotsize;
+    // queue is mapped from fd. 0: queue on the heap
+    size_t mapsize;
+    int fd;
+} lparcel_channel_t;
+
+
+// round up nslot to the power of 2, and return the bytes of the queue.
+// returns 0 if too large.
+static inline size_t lparcel_queue_size( size_t *nslot, size_t slotsize,
+                                         size_t *stride )
+{
+    size_t n = 1;
+
+    while( n < *nslot ){
+        n <<= 1;
+    }
+    // slots are aligned to the cache line
+    *stride = sizeof( lparcel_slot_t ) + slotsize +
+              LPARCEL_CHANNEL_CACHELINE - 1;
+    *stride -= *stride % LPARCEL_CHANNEL_CACHELINE;
+    *nslot = n;
+    if( n > ( SIZE_MAX - sizeof( lparcel_queue_t ) ) / *stride ){
+        return 0;
+    }
+
+    return sizeof( lparcel_queue_t ) + n * *stride;
+}
+
+
+// initialize the zero-filled queue
+static inline void lparcel_queue_init( lparcel_queue_t *q, size_t nslot,
+                                       size_t slotsize, size_t stride )
+{
+    size_t i = 0;
+
+    q->magic = LPARCEL_QUEUE_MAGIC;
+    q->refcnt = 1;
+    q->nslot = nslot;
+    q->slotsize = slotsize;
+    q->stride = stride;
+    for(; i < nslot; i++ ){
+        ((lparcel_slot_t*)( q->slots + i * stride ))->seq = i;
+    }
+}
+
+
+// push the channel without the queue. the queue is released by the channel
+// after it is set. see channel.c
+lparcel_channel_t *lparcel_channel_new( lua_State *L );
+
+
+#endif
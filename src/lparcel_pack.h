@@ -40,13 +40,23 @@ enum {
     LP_TBL_NELTS_INVAL = -1,
     LP_TBL_NELTS_EMPTY = 0,
     LP_TBL_NELTS_ARRAY,
-    LP_TBL_NELTS_MAP
+    LP_TBL_NELTS_MAP,
+    // array of the consecutive indexes from 1
+    LP_TBL_NELTS_SEQ
 };
 
-static inline int lparcel_tblnelts( lua_State *L, size_t *len )
+// max is set to the largest index if the table is an array
+static inline int lparcel_tblnelts( lua_State *L, size_t *len, lua_Number *max )
 {
     size_t nelts = 0;
+    lua_Number num = 0;
+    int haszero = 0;
 
+    // the elements of the nested tables are pushed on the stack
+    if( !lua_checkstack( L, LUA_MINSTACK ) ){
+        errno = PARCEL_ENOMEM;
+        return LP_TBL_NELTS_INVAL;
+    }
     // push space
     lua_pushnil( L );
     // empty
@@ -55,6 +65,7 @@ static inline int lparcel_tblnelts( lua_State *L, size_t *len )
     }
 
     // count number of array index
+    *max = 0;
     do
     {
         // invalid array index value
@@ -62,11 +73,20 @@ static inline int lparcel_tblnelts( lua_State *L, size_t *len )
             !LUANUM_ISUINT( lua_tonumber( L, -2 ) ) ){
             goto CHECK_KEYTYPE;
         }
+        num = lua_tonumber( L, -2 );
+        if( num > *max ){
+            *max = num;
+        }
+        haszero |= !num;
         nelts++;
         lua_pop( L, 1 );
     } while( lua_next( L, -2 ) );
 
     *len = nelts;
+    // len distinct indexes from 1 to len
+    if( !haszero && *max == (lua_Number)nelts ){
+        return LP_TBL_NELTS_SEQ;
+    }
 
     return LP_TBL_NELTS_ARRAY;
 
@@ -82,6 +102,7 @@ CHECK_KEYTYPE:
                 if( LUANUM_ISDBL( lua_tonumber( L, -2 ) ) ){
                     goto INVALID_KEY;
                 }
+                // fallthrough
             case LUA_TSTRING:
                 lua_pop( L, 1 );
                 nelts++;
@@ -104,11 +125,535 @@ INVALID_KEY:
 
 static inline int lparcel_pack_val( par_pack_t *p, lua_State *L, int idx );
 
-static inline int lparcel_pack_map( par_pack_t *p, lua_State *L, size_t len )
+
+// MARK: indexed array/map
+
+// pack as the indexed container if the number of elements reaches index_min
+#define lparcel_indexable( p, len ) \
+    ( (p)->index_min && (len) >= (p)->index_min && !(p)->reducer )
+
+
+static inline par_index_ent_t *lparcel_index_ents( size_t len )
+{
+    par_index_ent_t *ents = NULL;
+
+    if( len > SIZE_MAX / sizeof( par_index_ent_t ) ||
+        !( ents = malloc( sizeof( par_index_ent_t ) * len ) ) ){
+        errno = PARCEL_ENOMEM;
+    }
+
+    return ents;
+}
+
+
+static inline int lparcel_pack_indexed_map( par_pack_t *p, lua_State *L,
+                                            size_t len )
+{
+    par_index_ent_t *ents = lparcel_index_ents( len );
+    size_t start = p->cur;
+    size_t i = 0;
+    par_key_t key;
+    int rc = 0;
+
+    if( !ents ){
+        return -1;
+    }
+
+    par_stats_enter( p->stats );
+    // push space
+    lua_pushnil( L );
+    while( lua_next( L, -2 ) )
+    {
+        key.str = NULL;
+        key.len = 0;
+        key.num = 0;
+        key.isint = 0;
+        // NOTE: do not convert the number key to string
+        if( lua_type( L, -2 ) == LUA_TSTRING ){
+            key.type = PAR_KEY_STR;
+            key.str = lua_tolstring( L, -2, &key.len );
+        }
+        else {
+            lparcel_numkey( L, -2, &key );
+        }
+        ents[i].hash = par_key_hash( &key );
+        ents[i].off = p->cur - start;
+        i++;
+        // append key and value
+        if( ( rc = lparcel_pack_val( p, L, -2 ) ) != 0 ||
+            ( rc = lparcel_pack_val( p, L, -1 ) ) != 0 ){
+            lua_pop( L, 2 );
+            break;
+        }
+        lua_pop( L, 1 );
+    }
+    par_stats_leave( p->stats );
+
+    if( rc == 0 ){
+        rc = par_pack_index( p, PAR_ISA_IMAP, start, ents, i );
+    }
+    free( (void*)ents );
+
+    return rc;
+}
+
+
+static inline int lparcel_pack_indexed_array( par_pack_t *p, lua_State *L,
+                                              size_t len )
+{
+    par_index_ent_t *ents = lparcel_index_ents( len );
+    size_t start = p->cur;
+    size_t i = 0;
+    int rc = 0;
+
+    if( !ents ){
+        return -1;
+    }
+
+    par_stats_enter( p->stats );
+    for(; i < len; i++ )
+    {
+        ents[i].hash = 0;
+        ents[i].off = p->cur - start;
+        // append value
+        lua_rawgeti( L, -1, (int)i + 1 );
+        rc = lparcel_pack_val( p, L, -1 );
+        lua_pop( L, 1 );
+        if( rc != 0 ){
+            break;
+        }
+    }
+    par_stats_leave( p->stats );
+
+    if( rc == 0 ){
+        rc = par_pack_index( p, PAR_ISA_IARR, start, ents, len );
+    }
+    free( (void*)ents );
+
+    return rc;
+}
+
+
+// MARK: columnar array
+
+// pack as the columnar array if the number of rows reaches col_min
+#define lparcel_columnar( p, len ) \
+    ( (p)->col_min && (len) >= (p)->col_min && !(p)->reducer )
+
+
+// push the value of the key at kidx in the row of the array at ridx
+static inline void lparcel_column_val( lua_State *L, int ridx, int kidx,
+                                       size_t row )
+{
+    lua_rawgeti( L, ridx, (int)row + 1 );
+    lua_pushvalue( L, kidx );
+    lua_rawget( L, -2 );
+    lua_remove( L, -2 );
+}
+
+
+// push the list of the keys of the rows of the array at the top of stack,
+// and return the number of keys in ncol. returns 1 if the rows are not the
+// maps of the same shape; more than half of the cells must have the value.
+static inline int lparcel_column_keys( lua_State *L, size_t nrow,
+                                       size_t *ncol )
+{
+    int ridx = lua_gettop( L );
+    size_t ncell = 0;
+    size_t n = 0;
+    size_t i = 1;
+
+    // list of keys and set of keys
+    lua_createtable( L, 0, 0 );
+    lua_createtable( L, 0, 0 );
+    for(; i <= nrow; i++ )
+    {
+        lua_rawgeti( L, ridx, (int)i );
+        if( lua_type( L, -1 ) != LUA_TTABLE ){
+            lua_settop( L, ridx );
+            return 1;
+        }
+        // push space
+        lua_pushnil( L );
+        while( lua_next( L, -2 ) )
+        {
+            lua_pop( L, 1 );
+            switch( lua_type( L, -1 ) ){
+                case LUA_TNUMBER:
+                    if( !LUANUM_ISDBL( lua_tonumber( L, -1 ) ) ){
+                        break;
+                    }
+                    // fallthrough
+                // unsupported key type
+                default:
+                    lua_settop( L, ridx );
+                    return 1;
+
+                case LUA_TSTRING:
+                break;
+            }
+            ncell++;
+            // new key
+            lua_pushvalue( L, -1 );
+            lua_rawget( L, ridx + 2 );
+            if( lua_isnil( L, -1 ) ){
+                lua_pushvalue( L, -2 );
+                lua_rawseti( L, ridx + 1, (int)++n );
+                lua_pushvalue( L, -2 );
+                lua_pushboolean( L, 1 );
+                lua_rawset( L, ridx + 2 );
+            }
+            lua_pop( L, 1 );
+        }
+        lua_pop( L, 1 );
+    }
+    lua_pop( L, 1 );
+
+    if( !n || n > ncell * 2 / nrow ){
+        lua_settop( L, ridx );
+        return 1;
+    }
+    *ncol = n;
+
+    return 0;
+}
+
+
+typedef struct {
+    uint8_t kind;
+    // number of values
+    size_t len;
+    // total length of strings
+    size_t size;
+    // width of integers or lengths of strings
+    size_t width;
+} lparcel_column_t;
+
+
+// presence bitmap and kind of the column of the key at kidx
+static inline void lparcel_column_scan( lua_State *L, int ridx, int kidx,
+                                        size_t nrow, uint8_t *bitmap,
+                                        lparcel_column_t *c )
+{
+    size_t nbool = 0;
+    size_t nint = 0;
+    size_t nflt = 0;
+    size_t nstr = 0;
+    size_t maxlen = 0;
+    int64_t imin = 0;
+    int64_t imax = 0;
+    size_t row = 0;
+    size_t len = 0;
+    double num = 0;
+
+    memset( bitmap, 0, ( nrow + 7 ) / 8 );
+    c->len = 0;
+    c->size = 0;
+    for(; row < nrow; row++ )
+    {
+        lparcel_column_val( L, ridx, kidx, row );
+        switch( lua_type( L, -1 ) ){
+            case LUA_TNIL:
+                lua_pop( L, 1 );
+                continue;
+
+            case LUA_TBOOLEAN:
+                nbool++;
+            break;
+
+            case LUA_TNUMBER:
+                num = lua_tonumber( L, -1 );
+                // integer that fits in int64
+                if( num >= -9223372036854775808.0 &&
+                    num < 9223372036854775808.0 && !LUANUM_ISDBL( num ) )
+                {
+                    int64_t v = (int64_t)num;
+
+                    if( !nint++ ){
+                        imin = imax = v;
+                    }
+                    else if( v < imin ){
+                        imin = v;
+                    }
+                    else if( v > imax ){
+                        imax = v;
+                    }
+                }
+                else {
+                    nflt++;
+                }
+            break;
+
+            case LUA_TSTRING:
+                lua_tolstring( L, -1, &len );
+                nstr++;
+                c->size += len;
+                if( len > maxlen ){
+                    maxlen = len;
+                }
+            break;
+        }
+        lua_pop( L, 1 );
+        bitmap[row >> 3] |= (uint8_t)( 1 << ( row & 7 ) );
+        c->len++;
+    }
+
+    c->width = 0;
+    if( c->len == nbool ){
+        c->kind = PAR_COL_BOOL;
+    }
+    else if( c->len == nint )
+    {
+        uint_fast8_t wmin = par_int_wclass( imin );
+        uint_fast8_t wmax = par_int_wclass( imax );
+
+        c->kind = PAR_COL_INT8 + ( ( wmin > wmax ) ? wmin : wmax );
+        c->width = (size_t)1 << ( c->kind - PAR_COL_INT8 );
+    }
+    else if( c->len == nint + nflt ){
+        c->kind = PAR_COL_F64;
+        c->width = 8;
+    }
+    else if( c->len == nstr ){
+        c->kind = PAR_COL_STR;
+        c->width = (size_t)1 << par_uint_wclass( maxlen );
+    }
+    else {
+        c->kind = PAR_COL_ANY;
+    }
+}
+
+
+// pack the values of the column of the key at kidx
+static inline int lparcel_column_data( par_pack_t *p, lua_State *L, int ridx,
+                                       int kidx, size_t nrow,
+                                       const uint8_t *bitmap,
+                                       const lparcel_column_t *c )
+{
+    uint8_t *mem = NULL;
+    uint8_t *bytes = NULL;
+    size_t row = 0;
+    size_t i = 0;
+    size_t len = 0;
+    const char *str = NULL;
+    double num = 0;
+    uint64_t v = 0;
+    int rc = 0;
+
+    switch( c->kind ){
+        case PAR_COL_ANY:
+        break;
+
+        case PAR_COL_BOOL:
+            if( !( mem = par_pack_reserve( p, ( c->len + 7 ) / 8 ) ) ){
+                return -1;
+            }
+            memset( mem, 0, ( c->len + 7 ) / 8 );
+        break;
+
+        case PAR_COL_STR:
+            if( c->len > ( SIZE_MAX - 1 - c->size ) / c->width ){
+                errno = PARCEL_ENOMEM;
+                return -1;
+            }
+            else if( !( mem = par_pack_reserve( p, 1 + c->len * c->width +
+                                                   c->size ) ) ){
+                return -1;
+            }
+            *mem++ = (uint8_t)c->width;
+            bytes = mem + c->len * c->width;
+        break;
+
+        default:
+            if( !( mem = par_pack_reserve( p, c->len * c->width ) ) ){
+                return -1;
+            }
+    }
+
+    for(; row < nrow && rc == 0; row++ )
+    {
+        if( !( ( bitmap[row >> 3] >> ( row & 7 ) ) & 1 ) ){
+            continue;
+        }
+        lparcel_column_val( L, ridx, kidx, row );
+        switch( c->kind ){
+            case PAR_COL_ANY:
+                rc = lparcel_pack_val( p, L, -1 );
+            break;
+
+            case PAR_COL_BOOL:
+                if( lua_toboolean( L, -1 ) ){
+                    mem[i >> 3] |= (uint8_t)( 1 << ( i & 7 ) );
+                }
+            break;
+
+            case PAR_COL_F64:
+                num = lua_tonumber( L, -1 );
+                memcpy( &v, &num, sizeof( v ) );
+                par_store_be64( mem + i * 8, v );
+            break;
+
+            case PAR_COL_STR:
+                str = lua_tolstring( L, -1, &len );
+                par_store_bewidth( mem + i * c->width, len, c->width );
+                memcpy( bytes, str, len );
+                bytes += len;
+            break;
+
+            // integer
+            default:
+                v = (uint64_t)(int64_t)lua_tonumber( L, -1 );
+                par_store_bewidth( mem + i * c->width, v, c->width );
+        }
+        lua_pop( L, 1 );
+        i++;
+    }
+
+    return rc;
+}
+
+
+// pack the array of the maps of the same shape at the top of stack as the
+// columnar array. returns 1 if the rows are not packed as the columnar
+// array.
+static inline int lparcel_pack_columnar( par_pack_t *p, lua_State *L,
+                                         size_t nrow )
+{
+    int ridx = lua_gettop( L );
+    size_t start = p->cur;
+    size_t ncol = 0;
+    uint8_t *bitmap = NULL;
+    lparcel_column_t c;
+    size_t i = 1;
+    int rc = 0;
+
+    if( !lua_checkstack( L, 8 ) ){
+        errno = PARCEL_ENOMEM;
+        return -1;
+    }
+    else if( lparcel_column_keys( L, nrow, &ncol ) != 0 ){
+        return 1;
+    }
+    else if( !( bitmap = malloc( ( nrow + 7 ) / 8 ) ) ){
+        lua_settop( L, ridx );
+        errno = PARCEL_ENOMEM;
+        return -1;
+    }
+
+    par_stats_enter( p->stats );
+    for(; i <= ncol && rc == 0; i++ )
+    {
+        // key
+        lua_rawgeti( L, ridx + 1, (int)i );
+        lparcel_column_scan( L, ridx, ridx + 2, nrow, bitmap, &c );
+        if( ( rc = lparcel_pack_val( p, L, ridx + 2 ) ) == 0 &&
+            ( rc = par_pack_column( p, c.kind,
+                                    ( c.len == nrow ) ? NULL : bitmap,
+                                    nrow ) ) == 0 ){
+            rc = lparcel_column_data( p, L, ridx, ridx + 2, nrow, bitmap, &c );
+        }
+        lua_pop( L, 1 );
+    }
+    par_stats_leave( p->stats );
+    lua_settop( L, ridx );
+    free( (void*)bitmap );
+
+    if( rc == 0 ){
+        return par_pack_col( p, start, nrow, ncol );
+    }
+
+    return -1;
+}
+
+
+// MARK: hybrid array/map
+
+// pack the map as the hybrid array/map if it has the consecutive indexes from
+// 1 at least this number
+#define LPARCEL_HYB_MIN 4
+
+// number of the consecutive indexes from 1 of the table at the top of stack
+static inline size_t lparcel_seqlen( lua_State *L, size_t len )
+{
+    size_t n = 0;
+
+    for(; n < len; n++ )
+    {
+        lua_rawgeti( L, -1, (int)n + 1 );
+        if( lua_isnil( L, -1 ) ){
+            lua_pop( L, 1 );
+            break;
+        }
+        lua_pop( L, 1 );
+    }
+
+    return n;
+}
+
+
+// key at idx is the index of the array section
+static inline int lparcel_isarridx( lua_State *L, int idx, size_t narr )
+{
+    lua_Integer key = 0;
+
+    if( lua_type( L, idx ) != LUA_TNUMBER ){
+        return 0;
+    }
+    key = lua_tointeger( L, idx );
+
+    return key >= 1 && (size_t)key <= narr;
+}
+
+
+static inline int lparcel_pack_hyb( par_pack_t *p, lua_State *L, size_t narr,
+                                    size_t nmap )
+{
+    size_t i = 1;
+
+    if( par_pack_hyb( p, narr, nmap ) != 0 ){
+        return -1;
+    }
+
+    par_stats_enter( p->stats );
+    // append values of array section
+    for(; i <= narr; i++ )
+    {
+        lua_rawgeti( L, -1, (int)i );
+        if( lparcel_pack_val( p, L, -1 ) != 0 ){
+            lua_pop( L, 1 );
+            par_stats_leave( p->stats );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+
+    // append other key/value pairs
+    // push space
+    lua_pushnil( L );
+    while( lua_next( L, -2 ) )
+    {
+        if( !lparcel_isarridx( L, -2, narr ) &&
+            ( lparcel_pack_val( p, L, -2 ) != 0 ||
+              lparcel_pack_val( p, L, -1 ) != 0 ) ){
+            lua_pop( L, 2 );
+            par_stats_leave( p->stats );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+    par_stats_leave( p->stats );
+
+    return 0;
+}
+
+
+// pack all key/value pairs as the map
+static inline int lparcel_pack_pairs( par_pack_t *p, lua_State *L, size_t len )
 {
     // append map
     if( par_pack_map( p, len ) == 0 )
     {
+        par_stats_enter( p->stats );
         // push space
         lua_pushnil( L );
         while( lua_next( L, -2 ) )
@@ -117,10 +662,12 @@ static inline int lparcel_pack_map( par_pack_t *p, lua_State *L, size_t len )
             if( lparcel_pack_val( p, L, -2 ) != 0 ||
                 lparcel_pack_val( p, L, -1 ) != 0 ){
                 lua_pop( L, 2 );
+                par_stats_leave( p->stats );
                 return -1;
             }
             lua_pop( L, 1 );
         }
+        par_stats_leave( p->stats );
         return 0;
     }
 
@@ -128,14 +675,89 @@ static inline int lparcel_pack_map( par_pack_t *p, lua_State *L, size_t len )
 }
 
 
-static inline int lparcel_pack_array( par_pack_t *p, lua_State *L, size_t len )
+static inline int lparcel_pack_map( par_pack_t *p, lua_State *L, size_t len )
+{
+    size_t narr = 0;
+
+    if( lparcel_indexable( p, len ) ){
+        return lparcel_pack_indexed_map( p, L, len );
+    }
+    else if( ( narr = lparcel_seqlen( L, len ) ) >= LPARCEL_HYB_MIN ){
+        return lparcel_pack_hyb( p, L, narr, len - narr );
+    }
+
+    return lparcel_pack_pairs( p, L, len );
+}
+
+
+// MARK: array
+
+// pack the array of the consecutive indexes from 1 without lua_next and the
+// check of the index
+static inline int lparcel_pack_seq( par_pack_t *p, lua_State *L, size_t len )
+{
+    size_t i = 1;
+    int rc = 0;
+
+    if( lparcel_columnar( p, len ) &&
+        ( rc = lparcel_pack_columnar( p, L, len ) ) <= 0 ){
+        return rc;
+    }
+    else if( lparcel_indexable( p, len ) ){
+        return lparcel_pack_indexed_array( p, L, len );
+    }
+    else if( par_pack_array( p, len ) != 0 ){
+        return -1;
+    }
+
+    par_stats_enter( p->stats );
+    for(; i <= len; i++ )
+    {
+        lua_rawgeti( L, -1, (int)i );
+        if( lparcel_pack_val( p, L, -1 ) != 0 ){
+            lua_pop( L, 1 );
+            par_stats_leave( p->stats );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+    par_stats_leave( p->stats );
+
+    return 0;
+}
+
+
+// the array that less than half of the indexes up to max have the value is
+// decoded into the hash part. it is packed as the hybrid array/map or the map
+// of the index keys instead of the array with the index markers, that is
+// decoded into the array part of len elements and then rehashed.
+#define lparcel_sparse( p, len, max ) \
+    ( (max) > (lua_Number)(len) * 2 && !lparcel_indexable( p, len ) )
+
+static inline int lparcel_pack_array( par_pack_t *p, lua_State *L, size_t len,
+                                      lua_Number max )
 {
+    size_t narr = 0;
+
+    if( lparcel_sparse( p, len, max ) )
+    {
+        narr = lparcel_seqlen( L, len );
+        if( narr >= LPARCEL_HYB_MIN ){
+            return lparcel_pack_hyb( p, L, narr, len - narr );
+        }
+        // keys of the short sequence are not larger than the index markers
+        else if( narr <= len - narr ){
+            return lparcel_pack_pairs( p, L, len );
+        }
+    }
+
     // append array
     if( par_pack_array( p, len ) == 0 )
     {
         lua_Integer seq = 1;
         lua_Integer idx = 0;
 
+        par_stats_enter( p->stats );
         // push space
         lua_pushnil( L );
         while( lua_next( L, -2 ) )
@@ -147,16 +769,19 @@ static inline int lparcel_pack_array( par_pack_t *p, lua_State *L, size_t len )
             // append index
             else if( par_pack_idx( p, (uint_fast64_t)lua_tointeger( L, -2 ) ) != 0 ){
                 lua_pop( L, 2 );
+                par_stats_leave( p->stats );
                 return -1;
             }
 
             // append value
             if( lparcel_pack_val( p, L, -1 ) != 0 ){
                 lua_pop( L, 2 );
+                par_stats_leave( p->stats );
                 return -1;
             }
             lua_pop( L, 1 );
         }
+        par_stats_leave( p->stats );
         return 0;
     }
 
@@ -164,6 +789,79 @@ static inline int lparcel_pack_array( par_pack_t *p, lua_State *L, size_t len )
 }
 
 
+// MARK: extension types
+
+// size of the buffer on the stack for the payload of extension
+#define LPARCEL_EXT_BUFSIZE 256
+
+// pack the userdata at idx by the registered handler. the userdata of the
+// unregistered metatable is packed as nil.
+static inline int lparcel_pack_ext( par_pack_t *p, lua_State *L, int idx )
+{
+    int top = lua_gettop( L );
+    lparcel_ext_t *e = NULL;
+    size_t start = 0;
+    int rc = -1;
+
+    if( idx < 0 ){
+        idx = top + idx + 1;
+    }
+    if( !lua_checkstack( L, 4 ) ){
+        errno = PARCEL_ENOMEM;
+        return -1;
+    }
+    else if( !lua_getmetatable( L, idx ) ){
+        return par_pack_nil( p );
+    }
+    else if( !( e = lparcel_ext_find( L ) ) ){
+        lua_settop( L, top );
+        return par_pack_nil( p );
+    }
+    // lua callback returns the payload
+    else if( e->ref_encode != LUA_NOREF )
+    {
+        lstate_pushref( L, e->ref_encode );
+        lua_pushvalue( L, idx );
+        if( lua_pcall( L, 1, 1, 0 ) != 0 ||
+            lua_type( L, -1 ) != LUA_TSTRING ){
+            errno = EINVAL;
+        }
+        else {
+            size_t len = 0;
+            const char *str = lua_tolstring( L, -1, &len );
+
+            rc = par_pack_ext( p, e->id, str, len );
+        }
+    }
+    // the payload is packed to the temporary packer, and then passed to the
+    // reducer
+    else if( p->reducer )
+    {
+        char buf[LPARCEL_EXT_BUFSIZE];
+        par_pack_t tmp;
+
+        par_pack_init_mem( &tmp, buf, sizeof( buf ), NULL );
+        if( e->packf( L, idx, &tmp ) == 0 ){
+            rc = par_pack_ext( p, e->id, tmp.mem, tmp.cur );
+        }
+        par_pack_dispose( &tmp );
+    }
+    // write the payload directly
+    else if( par_pack_ext_open( p, e->id, &start ) == 0 )
+    {
+        if( e->packf( L, idx, p ) == 0 ){
+            rc = par_pack_ext_close( p, start );
+        }
+        else {
+            par_pack_ext_cancel( p, start );
+        }
+    }
+    lua_settop( L, top );
+
+    return rc;
+}
+
+
 static inline int lparcel_pack_number( par_pack_t *p, lua_State *L, int idx )
 {
     double num = lua_tonumber( L, idx );
@@ -198,6 +896,7 @@ static inline int lparcel_pack_val( par_pack_t *p, lua_State *L, int idx )
 {
     const char *str = NULL;
     size_t len = 0;
+    lua_Number max = 0;
 
     switch( lua_type( L, idx ) )
     {
@@ -208,16 +907,22 @@ static inline int lparcel_pack_val( par_pack_t *p, lua_State *L, int idx )
         case LUA_TBOOLEAN:
             return par_pack_bool( p, (uint8_t)lua_toboolean( L, idx ) );
 
+        case LUA_TUSERDATA:
+            return lparcel_pack_ext( p, L, idx );
+
         case LUA_TNUMBER:
             return lparcel_pack_number( p, L, idx );
 
         case LUA_TTABLE:
-            switch( lparcel_tblnelts( L, &len ) ){
+            switch( lparcel_tblnelts( L, &len, &max ) ){
                 case LP_TBL_NELTS_EMPTY:
                     return par_pack_map( p, 0 );
 
+                case LP_TBL_NELTS_SEQ:
+                    return lparcel_pack_seq( p, L, len );
+
                 case LP_TBL_NELTS_ARRAY:
-                    return lparcel_pack_array( p, L, len );
+                    return lparcel_pack_array( p, L, len, max );
 
                 case LP_TBL_NELTS_MAP:
                     return lparcel_pack_map( p, L, len );
@@ -230,7 +935,6 @@ static inline int lparcel_pack_val( par_pack_t *p, lua_State *L, int idx )
 
         //case LUA_TLIGHTUSERDATA:
         //case LUA_TFUNCTION:
-        //case LUA_TUSERDATA:
         //case LUA_TTHREAD:
         //case LUA_TNONE:
         //case LUA_TNIL:
@@ -240,4 +944,371 @@ static inline int lparcel_pack_val( par_pack_t *p, lua_State *L, int idx )
 }
 
 
+
+// MARK: canonical encoding
+// map keys and array indexes are packed in ascending order; numbers first and
+// then strings in byte order. equal tables are packed into equal bytes.
+
+typedef struct {
+    lua_Integer num;
+    const char *str;
+    size_t len;
+    // position in the key/value list
+    int pos;
+} lparcel_key_t;
+
+
+static inline int lparcel_cmpkey( const void *a, const void *b )
+{
+    const lparcel_key_t *x = (const lparcel_key_t*)a;
+    const lparcel_key_t *y = (const lparcel_key_t*)b;
+    int rv = 0;
+
+    // numbers are less than strings
+    if( !x->str || !y->str ){
+        if( x->str || y->str ){
+            return ( x->str ) ? 1 : -1;
+        }
+        return ( x->num > y->num ) - ( x->num < y->num );
+    }
+
+    rv = memcmp( x->str, y->str, ( x->len < y->len ) ? x->len : y->len );
+    if( rv ){
+        return rv;
+    }
+
+    return ( x->len > y->len ) - ( x->len < y->len );
+}
+
+
+// push the sorted keys and the key/value list of the table at the top of
+// stack. the key of keys[i] is at list[pos * 2 - 1] and the value is at
+// list[pos * 2].
+static inline lparcel_key_t *lparcel_sortkeys( lua_State *L, size_t len )
+{
+    lparcel_key_t *keys = NULL;
+    size_t i = 0;
+
+    if( !lua_checkstack( L, 4 ) ){
+        errno = PARCEL_ENOMEM;
+        return NULL;
+    }
+    keys = lua_newuserdata( L, sizeof( lparcel_key_t ) * len );
+    lua_createtable( L, (int)len * 2, 0 );
+    // push space
+    // NOTE: len is the number of keys that counted by lparcel_tblnelts
+    lua_pushnil( L );
+    while( lua_next( L, -4 ) )
+    {
+        lparcel_key_t *k = &keys[i++];
+
+        k->pos = (int)i;
+        lua_rawseti( L, -3, k->pos * 2 );
+        // NOTE: do not convert the number key to string
+        if( lua_type( L, -1 ) == LUA_TSTRING ){
+            k->str = lua_tolstring( L, -1, &k->len );
+            k->num = 0;
+        }
+        else {
+            k->str = NULL;
+            k->num = lua_tointeger( L, -1 );
+        }
+        lua_pushvalue( L, -1 );
+        lua_rawseti( L, -3, k->pos * 2 - 1 );
+    }
+    qsort( (void*)keys, i, sizeof( lparcel_key_t ), lparcel_cmpkey );
+
+    return keys;
+}
+
+
+static inline int lparcel_pack_canonical_val( par_pack_t *p, lua_State *L,
+                                              int idx );
+
+static inline int lparcel_pack_sorted_map( par_pack_t *p, lua_State *L,
+                                           size_t len )
+{
+    lparcel_key_t *keys = NULL;
+
+    if( par_pack_map( p, len ) == 0 &&
+        ( keys = lparcel_sortkeys( L, len ) ) )
+    {
+        size_t i = 0;
+
+        par_stats_enter( p->stats );
+        for(; i < len; i++ )
+        {
+            lua_rawgeti( L, -1, keys[i].pos * 2 - 1 );
+            lua_rawgeti( L, -2, keys[i].pos * 2 );
+            // append key and value
+            if( lparcel_pack_val( p, L, -2 ) != 0 ||
+                lparcel_pack_canonical_val( p, L, -1 ) != 0 ){
+                lua_pop( L, 4 );
+                par_stats_leave( p->stats );
+                return -1;
+            }
+            lua_pop( L, 2 );
+        }
+        lua_pop( L, 2 );
+        par_stats_leave( p->stats );
+        return 0;
+    }
+
+    return -1;
+}
+
+
+static inline int lparcel_pack_sorted_array( par_pack_t *p, lua_State *L,
+                                             size_t len )
+{
+    lparcel_key_t *keys = NULL;
+
+    if( par_pack_array( p, len ) == 0 &&
+        ( keys = lparcel_sortkeys( L, len ) ) )
+    {
+        lua_Integer seq = 1;
+        size_t i = 0;
+
+        par_stats_enter( p->stats );
+        for(; i < len; i++ )
+        {
+            // append index
+            if( keys[i].num == seq ){
+                seq++;
+            }
+            else if( par_pack_idx( p, (uint_fast64_t)keys[i].num ) != 0 ){
+                lua_pop( L, 2 );
+                par_stats_leave( p->stats );
+                return -1;
+            }
+
+            // append value
+            lua_rawgeti( L, -1, keys[i].pos * 2 );
+            if( lparcel_pack_canonical_val( p, L, -1 ) != 0 ){
+                lua_pop( L, 3 );
+                par_stats_leave( p->stats );
+                return -1;
+            }
+            lua_pop( L, 1 );
+        }
+        lua_pop( L, 2 );
+        par_stats_leave( p->stats );
+        return 0;
+    }
+
+    return -1;
+}
+
+
+static inline int lparcel_pack_canonical_val( par_pack_t *p, lua_State *L,
+                                              int idx )
+{
+    size_t len = 0;
+    lua_Number max = 0;
+
+    if( lua_type( L, idx ) == LUA_TTABLE )
+    {
+        switch( lparcel_tblnelts( L, &len, &max ) ){
+            case LP_TBL_NELTS_EMPTY:
+                return par_pack_map( p, 0 );
+
+            case LP_TBL_NELTS_SEQ:
+            case LP_TBL_NELTS_ARRAY:
+                return lparcel_pack_sorted_array( p, L, len );
+
+            case LP_TBL_NELTS_MAP:
+                return lparcel_pack_sorted_map( p, L, len );
+
+            // unsupported key type
+            default:
+                return -1;
+        }
+    }
+
+    return lparcel_pack_val( p, L, idx );
+}
+
+
+
+// MARK: encoded size
+// compute the exact size of the value that is encoded by lparcel_pack_val.
+
+static inline int lparcel_sizeof_val( lua_State *L, int idx, size_t *size );
+
+// narr is the number of the consecutive indexes from 1
+static inline int lparcel_sizeof_map( lua_State *L, size_t len, size_t narr,
+                                      size_t *size )
+{
+    // values of array section are counted with the other values
+    if( narr >= LPARCEL_HYB_MIN ){
+        *size += par_sizeof_hyb( narr, len - narr );
+    }
+    else {
+        *size += par_sizeof_map( len );
+        narr = 0;
+    }
+    // push space
+    lua_pushnil( L );
+    while( lua_next( L, -2 ) )
+    {
+        if( ( !lparcel_isarridx( L, -2, narr ) &&
+              lparcel_sizeof_val( L, -2, size ) != 0 ) ||
+            lparcel_sizeof_val( L, -1, size ) != 0 ){
+            lua_pop( L, 2 );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+
+    return 0;
+}
+
+
+static inline int lparcel_sizeof_seq( lua_State *L, size_t len, size_t *size )
+{
+    size_t i = 1;
+
+    *size += par_sizeof_array( len );
+    for(; i <= len; i++ )
+    {
+        lua_rawgeti( L, -1, (int)i );
+        if( lparcel_sizeof_val( L, -1, size ) != 0 ){
+            lua_pop( L, 1 );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+
+    return 0;
+}
+
+
+static inline int lparcel_sizeof_array( lua_State *L, size_t len,
+                                        lua_Number max, size_t *size )
+{
+    lua_Integer seq = 1;
+    lua_Integer idx = 0;
+    size_t narr = 0;
+
+    // packed as the hybrid array/map or the map. see lparcel_pack_array
+    if( max > (lua_Number)len * 2 )
+    {
+        narr = lparcel_seqlen( L, len );
+        if( narr >= LPARCEL_HYB_MIN || narr <= len - narr ){
+            return lparcel_sizeof_map( L, len, narr, size );
+        }
+    }
+
+    *size += par_sizeof_array( len );
+    // push space
+    lua_pushnil( L );
+    while( lua_next( L, -2 ) )
+    {
+        idx = lua_tointeger( L, -2 );
+        if( idx == seq ){
+            seq++;
+        }
+        // index
+        else {
+            *size += par_sizeof_idx( (uint_fast64_t)idx );
+        }
+
+        if( lparcel_sizeof_val( L, -1, size ) != 0 ){
+            lua_pop( L, 2 );
+            return -1;
+        }
+        lua_pop( L, 1 );
+    }
+
+    return 0;
+}
+
+
+static inline size_t lparcel_sizeof_number( lua_State *L, int idx )
+{
+    double num = lua_tonumber( L, idx );
+
+    // nan, inf and zero
+    if( isnan( num ) || isinf( num ) || !num ){
+        return par_sizeof_type();
+    }
+    // float
+    else if( LUANUM_ISDBL( num ) ){
+        return par_sizeof_float64();
+    }
+    // signed integer
+    else if( signbit( num ) ){
+        return par_sizeof_int( (int_fast64_t)num );
+    }
+
+    // unsigned integer
+    return par_sizeof_uint( (uint_fast64_t)num );
+}
+
+
+// the extension is packed to compute the size of payload
+static inline int lparcel_sizeof_ext( lua_State *L, int idx, size_t *size )
+{
+    char buf[LPARCEL_EXT_BUFSIZE];
+    par_pack_t tmp;
+    int rc = 0;
+
+    par_pack_init_mem( &tmp, buf, sizeof( buf ), NULL );
+    if( ( rc = lparcel_pack_ext( &tmp, L, idx ) ) == 0 ){
+        *size += tmp.cur;
+    }
+    par_pack_dispose( &tmp );
+
+    return rc;
+}
+
+
+static inline int lparcel_sizeof_val( lua_State *L, int idx, size_t *size )
+{
+    size_t len = 0;
+    lua_Number max = 0;
+
+    switch( lua_type( L, idx ) )
+    {
+        case LUA_TSTRING:
+            lua_tolstring( L, idx, &len );
+            *size += par_sizeof_str( len );
+            return 0;
+
+        case LUA_TNUMBER:
+            *size += lparcel_sizeof_number( L, idx );
+            return 0;
+
+        case LUA_TUSERDATA:
+            return lparcel_sizeof_ext( L, idx, size );
+
+        case LUA_TTABLE:
+            switch( lparcel_tblnelts( L, &len, &max ) ){
+                case LP_TBL_NELTS_EMPTY:
+                    *size += par_sizeof_map( 0 );
+                    return 0;
+
+                case LP_TBL_NELTS_SEQ:
+                    return lparcel_sizeof_seq( L, len, size );
+
+                case LP_TBL_NELTS_ARRAY:
+                    return lparcel_sizeof_array( L, len, max, size );
+
+                case LP_TBL_NELTS_MAP:
+                    return lparcel_sizeof_map( L, len, lparcel_seqlen( L, len ),
+                                               size );
+
+                // unsupported key type
+                default:
+                    return -1;
+            }
+
+        // boolean and nil
+        default:
+            *size += par_sizeof_type();
+            return 0;
+    }
+}
+
+
 #endif
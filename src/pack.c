@@ -26,27 +26,179 @@
  *
  */
 
+#include <inttypes.h>
 #include "lparcel_pack.h"
 
 #define MODULE_MT   "parcel.pack"
+#define POOL_MT     "parcel.pack.pool"
 
+// size of the buffer on the stack for pack()
+#define PACK_STACK_BUFSIZE  2048
+
+// default minimum number of elements of the indexed array/map
+#define PACK_INDEX_MIN      64
+
+// default minimum number of rows of the columnar array
+#define PACK_COL_MIN        16
+
+typedef struct {
+    par_pack_t p;
+    par_stats_t stats;
+} lpack_t;
+
+
+static int size_lua( lua_State *L )
+{
+    size_t size = 0;
+
+    lua_settop( L, 1 );
+    if( lparcel_sizeof_val( L, 1, &size ) == 0 ){
+        lua_pushinteger( L, (lua_Integer)size );
+        return 1;
+    }
+
+    // got error
+    lua_settop( L, 0 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+#if LUA_VERSION_NUM >= 505
+static void *free_bin( void *ud, void *ptr, size_t osize, size_t nsize )
+{
+    (void)ud;
+    (void)osize;
+    (void)nsize;
+    free( ptr );
+    return NULL;
+}
+#endif
+
+
+// push the packed bytes as a string
+static void pushbin( lua_State *L, par_pack_t *p )
+{
+#if LUA_VERSION_NUM >= 505
+    // hand over the memory block to lua without copying
+    char *mem = par_pack_detach( p );
+
+    if( mem ){
+        lua_pushexternalstring( L, mem, p->cur, free_bin, NULL );
+        return;
+    }
+#endif
+    lua_pushlstring( L, p->mem, p->cur );
+}
 
 
 static int pack_lua( lua_State *L )
 {
+    par_pool_t *pool = lua_touserdata( L, lua_upvalueindex( 1 ) );
+    // encoded size that computed by size()
+    lua_Integer size = luaL_optinteger( L, 2, 0 );
+    // small messages are packed on the stack
+    char buf[PACK_STACK_BUFSIZE];
     par_pack_t p;
 
-    if( par_pack_init( &p, 0, NULL, NULL ) == 0 )
-    {
-        lua_settop( L, 1 );
-        if( lparcel_pack_val( &p, L, 1 ) == 0 ){
-            lua_settop( L, 0 );
-            lua_pushlstring( L, p.mem, p.cur );
-            par_pack_dispose( &p );
-            return 1;
-        }
+    lua_settop( L, 1 );
+    par_pack_init_mem( &p, buf, sizeof( buf ), pool );
+    // allocate the memory block of the encoded size at once
+    if( ( size <= 0 || p.allocf( &p, (size_t)size + PAR_PACK_TAILROOM ) ) &&
+        lparcel_pack_val( &p, L, 1 ) == 0 ){
+        lua_settop( L, 0 );
+        pushbin( L, &p );
+        par_pack_dispose( &p );
+        return 1;
+    }
+    par_pack_dispose( &p );
+
+    // got error
+    lua_settop( L, 0 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int indexed_lua( lua_State *L )
+{
+    par_pool_t *pool = lua_touserdata( L, lua_upvalueindex( 1 ) );
+    lua_Integer nmin = luaL_optinteger( L, 2, PACK_INDEX_MIN );
+    char buf[PACK_STACK_BUFSIZE];
+    par_pack_t p;
+
+    lua_settop( L, 1 );
+    par_pack_init_mem( &p, buf, sizeof( buf ), pool );
+    p.index_min = ( nmin > 0 ) ? (size_t)nmin : 1;
+    if( lparcel_pack_val( &p, L, 1 ) == 0 ){
+        lua_settop( L, 0 );
+        pushbin( L, &p );
         par_pack_dispose( &p );
+        return 1;
     }
+    par_pack_dispose( &p );
+
+    // got error
+    lua_settop( L, 0 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int columnar_lua( lua_State *L )
+{
+    par_pool_t *pool = lua_touserdata( L, lua_upvalueindex( 1 ) );
+    lua_Integer nmin = luaL_optinteger( L, 2, PACK_COL_MIN );
+    char buf[PACK_STACK_BUFSIZE];
+    par_pack_t p;
+
+    lua_settop( L, 1 );
+    par_pack_init_mem( &p, buf, sizeof( buf ), pool );
+    p.col_min = ( nmin > 0 ) ? (size_t)nmin : 1;
+    if( lparcel_pack_val( &p, L, 1 ) == 0 ){
+        lua_settop( L, 0 );
+        pushbin( L, &p );
+        par_pack_dispose( &p );
+        return 1;
+    }
+    par_pack_dispose( &p );
+
+    // got error
+    lua_settop( L, 0 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int canonical_lua( lua_State *L )
+{
+    par_pool_t *pool = lua_touserdata( L, lua_upvalueindex( 1 ) );
+    char buf[PACK_STACK_BUFSIZE];
+    par_pack_hash_t h;
+
+    lua_settop( L, 1 );
+    par_pack_init_mem( &h.p, buf, sizeof( buf ), pool );
+    par_pack_hash_init( &h, 0 );
+    if( lparcel_pack_canonical_val( &h.p, L, 1 ) == 0 ){
+        char hex[17];
+
+        snprintf( hex, sizeof( hex ), "%016" PRIx64,
+                  par_pack_hash_final( &h ) );
+        lua_settop( L, 0 );
+        pushbin( L, &h.p );
+        lua_pushstring( L, hex );
+        par_pack_dispose( &h.p );
+        return 2;
+    }
+    par_pack_dispose( &h.p );
 
     // got error
     lua_settop( L, 0 );
@@ -59,22 +211,28 @@ static int pack_lua( lua_State *L )
 
 static int call_lua( lua_State *L )
 {
-    par_pack_t *p = luaL_checkudata( L, 1, MODULE_MT );
-    // pack value
-    int rc = 0;
+    lpack_t *lp = luaL_checkudata( L, 1, MODULE_MT );
+    uint_fast64_t start = lparcel_nsec();
 
     lua_settop( L, 2 );
-    if( ( rc = lparcel_pack_val( p, L, 2 ) ) )
+    // pack value
+    if( lparcel_pack_val( &lp->p, L, 2 ) == 0 )
     {
         lua_settop( L, 0 );
-        lua_pushlstring( L, p->mem, p->cur );
+        lua_pushlstring( L, lp->p.mem, lp->p.cur );
+        lparcel_stats_update( &lp->stats, lp->p.cur, start );
         // reset pack
-        if( par_pack_reset( p ) == 0 ){
+        if( par_pack_reset( &lp->p ) == 0 ){
             return 1;
         }
     }
+    // discard partially packed data
+    else {
+        par_pack_reset( &lp->p );
+    }
 
     // got error
+    lua_settop( L, 0 );
     lua_pushnil( L );
     lua_pushstring( L, strerror( errno ) );
 
@@ -82,6 +240,18 @@ static int call_lua( lua_State *L )
 }
 
 
+static int stats_lua( lua_State *L )
+{
+    lpack_t *lp = luaL_checkudata( L, 1, MODULE_MT );
+
+    lparcel_stats( L, &lp->stats );
+    // peak size starts from the current memory block
+    par_pack_stats( &lp->p, &lp->stats );
+
+    return 1;
+}
+
+
 static int tostring_lua( lua_State *L )
 {
     return lparcel_tostring( L, MODULE_MT );
@@ -90,9 +260,17 @@ static int tostring_lua( lua_State *L )
 
 static int gc_lua( lua_State *L )
 {
-    par_pack_t *p = lua_touserdata( L, 1 );
+    lpack_t *lp = lua_touserdata( L, 1 );
+
+    par_pack_dispose( &lp->p );
 
-    par_pack_dispose( p );
+    return 0;
+}
+
+
+static int pool_gc_lua( lua_State *L )
+{
+    par_pool_dispose( lua_touserdata( L, 1 ) );
 
     return 0;
 }
@@ -102,7 +280,7 @@ static int alloc_lua( lua_State *L )
 {
     // memory block size
     lua_Integer blksize = luaL_optinteger( L, 1, 0 );
-    par_pack_t *p = lua_newuserdata( L, sizeof( par_pack_t ) );
+    lpack_t *lp = lua_newuserdata( L, sizeof( lpack_t ) );
 
     // check blksize
     if( blksize < 0 ){
@@ -110,7 +288,9 @@ static int alloc_lua( lua_State *L )
     }
 
     // alloc
-    if( par_pack_init( p, (size_t)blksize, NULL, NULL ) == 0 ){
+    if( par_pack_init( &lp->p, (size_t)blksize, NULL, NULL ) == 0 ){
+        memset( (void*)&lp->stats, 0, sizeof( par_stats_t ) );
+        par_pack_stats( &lp->p, &lp->stats );
         // retain references
         luaL_getmetatable( L, MODULE_MT );
         lua_setmetatable( L, -2 );
@@ -129,7 +309,7 @@ LUALIB_API int luaopen_parcel_pack( lua_State *L )
 {
     struct luaL_Reg funcs[] = {
         { "new", alloc_lua },
-        { "pack", pack_lua },
+        { "size", size_lua },
         { NULL, NULL }
     };
     // oo interface
@@ -139,12 +319,47 @@ LUALIB_API int luaopen_parcel_pack( lua_State *L )
         { "__call", call_lua },
         { NULL, NULL }
     };
+    struct luaL_Reg method[] = {
+        { "stats", stats_lua },
+        { NULL, NULL }
+    };
+
+    struct luaL_Reg pool_mmethod[] = {
+        { "__gc", pool_gc_lua },
+        { NULL, NULL }
+    };
+    par_pool_t *pool = NULL;
 
     // create metatable
-    lparcel_define_mt( L, MODULE_MT, mmethod, NULL );
+    lparcel_define_mt( L, MODULE_MT, mmethod, method );
+    lparcel_define_mt( L, POOL_MT, pool_mmethod, NULL );
     // create module table
     lparcel_define_method( L, funcs );
 
+    // pack(), canonical(), indexed() and columnar() draw memory blocks from
+    // the pool of this lua state
+    pool = lua_newuserdata( L, sizeof( par_pool_t ) );
+    par_pool_init( pool );
+    luaL_getmetatable( L, POOL_MT );
+    lua_setmetatable( L, -2 );
+    lua_pushstring( L, "pack" );
+    lua_pushvalue( L, -2 );
+    lua_pushcclosure( L, pack_lua, 1 );
+    lua_rawset( L, -4 );
+    lua_pushstring( L, "canonical" );
+    lua_pushvalue( L, -2 );
+    lua_pushcclosure( L, canonical_lua, 1 );
+    lua_rawset( L, -4 );
+    lua_pushstring( L, "indexed" );
+    lua_pushvalue( L, -2 );
+    lua_pushcclosure( L, indexed_lua, 1 );
+    lua_rawset( L, -4 );
+    lua_pushstring( L, "columnar" );
+    lua_pushvalue( L, -2 );
+    lua_pushcclosure( L, columnar_lua, 1 );
+    lua_rawset( L, -4 );
+    lua_pop( L, 1 );
+
     return 1;
 }
 
@@ -352,19 +352,134 @@ enum {
     PAR_ISA_SSET,   // stream set
 
     //
-    // UNUSED: 0xAE-BF
+    // -----------------------+-----+
+    // type                   | hex
+    // -----------------------+-----+
+    // PAR_ISA_IARR 1010 1110 | 0xAE
+    // -----------------------+-----+
+    // PAR_ISA_IMAP 1010 1111 | 0xAF
+    // -----------------------+-----+
+    // indexed array/map that carries the offset table of the elements.
+    //
+    // 0      1          2
+    // -------+----------+--------+---------+----------------+-------------
+    // type(1)| width(1) | len(W) | size(W) | table(len * E) | elements...
+    // -------+----------+--------+---------+----------------+-------------
+    // W: width of len, size and offset; 1, 2, 4 or 8 byte
+    // len: number of elements
+    // size: number of bytes of elements
+    //
+    // table entry(E) of array: offset of the element
+    // ------------+
+    // offset(W)   |
+    // ------------+
+    //
+    // table entry(E) of map: hash of the key and offset of the key
+    // ---------+-----------+
+    // hash(4)  | offset(W) |
+    // ---------+-----------+
+    // NOTE: the entries are sorted by hash and offset. see par_key_hash().
+    //
+    // the offsets are the number of bytes from the head of elements.
+    // the elements are the same as array/map, but the array index(IDX) is
+    // not allowed in the indexed array.
+    //
+    PAR_ISA_IARR,   // indexed array
+    PAR_ISA_IMAP,   // indexed map
+
+    //
+    // -----------------------+-----+
+    // type                   | hex
+    // -----------------------+-----+
+    // PAR_ISA_REC  1011 0000 | 0xB0
+    // -----------------------+-----+
+    // record of the fields that are packed in the order of the schema.
+    // the keys are not packed, and the schema is identified by its hash.
+    //
+    // 0      1           2
+    // -------+-----------+-----------+----------------+-----
+    // type(1)| nfield(1) | schema(4) | serialized val | ...
+    // -------+-----------+-----------+----------------+-----
+    //
+    PAR_ISA_REC,    // record
+
+    //
+    // -----------------------+-----+
+    // type                   | hex
+    // -----------------------+-----+
+    // PAR_ISA_COL  1011 0001 | 0xB1
+    // -----------------------+-----+
+    // columnar array of maps. the maps are transposed into one column per
+    // key.
+    //
+    // 0      1          2         2+W       2+W*2     2+W*3
+    // -------+----------+---------+---------+---------+-----------
+    // type(1)| width(1) | nrow(W) | ncol(W) | size(W) | column ...
+    // -------+----------+---------+---------+---------+-----------
+    // width: 1, 2, 4 or 8
+    // size: number of bytes of columns
+    //
+    // column
+    // -------+---------+-------------------+------
+    // key    | kind(1) | presence bitmap   | data
+    // -------+---------+-------------------+------
+    // key: serialized key of map
+    // kind: PAR_COL_*. the presence bitmap is omitted if PAR_COL_DENSE is
+    //       set, that is, all rows have the value.
+    // presence bitmap: (nrow + 7) / 8 bytes. the bit (row & 7) of the byte
+    //                  (row >> 3) is set if the row has the value.
+    //
+    // data of the n values of the present rows
+    // PAR_COL_ANY   : n serialized values
+    // PAR_COL_BOOL  : bitmap of n values
+    // PAR_COL_INT*  : n big-endian signed integers of 1, 2, 4 or 8 bytes
+    // PAR_COL_F64   : n big-endian float64
+    // PAR_COL_STR   : width(1) | n big-endian lengths(width) | bytes ...
+    //
+    PAR_ISA_COL,    // columnar array
+
+    //
+    // -----------------------+-----+
+    // type                   | hex
+    // -----------------------+-----+
+    // PAR_ISA_EXT  1011 0010 | 0xB2
+    // -----------------------+-----+
+    // extension type of the application. the payload is encoded and decoded
+    // by the handler of the type id.
+    //
+    // 0      1          2        2+W     3+W
+    // -------+----------+--------+-------+-------------
+    // type(1)| width(1) | len(W) | id(1) | payload(len)
+    // -------+----------+--------+-------+-------------
+    // width: 1, 2, 4 or 8
+    //
+    PAR_ISA_EXT,    // extension
+
+    //
+    // -----------------------+-----+
+    // type                   | hex
+    // -----------------------+-----+
+    // PAR_ISA_HYB  1011 0011 | 0xB3
+    // -----------------------+-----+
+    // hybrid array/map. the values of the consecutive indexes from 1 are
+    // packed without the index, and then the other key/value pairs follow.
+    //
+    // 0      1          2         2+W       2+W*2
+    // -------+----------+---------+---------+----------------+---------------
+    // type(1)| width(1) | narr(W) | nmap(W) | narr values... | nmap pairs...
+    // -------+----------+---------+---------+----------------+---------------
+    // width: 1, 2, 4 or 8
+    //
+    PAR_ISA_HYB,    // hybrid array/map
+
+    //
+    // UNUSED: 0xB4-BF
     // ----------------------+
     // type
     // ----------------------+
-    // ............ 1010 1110
-    // ----------------------+
-    // ............ 1010 1111
-    // ----------------------+
-    // ............ 1011 0000
+    // ............ 1011 0100
     // ----------------------+
-    // ............ 1011 0001
-    // ----------------------+
-    // ............ 1011 0010
+    // ............ 1011 0101
     // ----------------------+
     //
 
@@ -419,6 +534,206 @@ typedef union {
 #define PAR_TYPE64_SIZE 9
 
 
+// MARK: type name
+
+static inline const char *par_isa_name( uint8_t isa )
+{
+    switch( isa ){
+        case PAR_ISA_S6 ... PAR_ISA_S6_TAIL:
+            return "S6";
+        case PAR_ISA_S6N ... PAR_ISA_S6N_TAIL:
+            return "S6N";
+        case PAR_ISA_U8:
+            return "U8";
+        case PAR_ISA_U16:
+            return "U16";
+        case PAR_ISA_U32:
+            return "U32";
+        case PAR_ISA_U64:
+            return "U64";
+        case PAR_ISA_S8:
+            return "S8";
+        case PAR_ISA_S16:
+            return "S16";
+        case PAR_ISA_S32:
+            return "S32";
+        case PAR_ISA_S64:
+            return "S64";
+        case PAR_ISA_RAW8:
+            return "RAW8";
+        case PAR_ISA_RAW16:
+            return "RAW16";
+        case PAR_ISA_RAW32:
+            return "RAW32";
+        case PAR_ISA_RAW64:
+            return "RAW64";
+        case PAR_ISA_STR8:
+            return "STR8";
+        case PAR_ISA_STR16:
+            return "STR16";
+        case PAR_ISA_STR32:
+            return "STR32";
+        case PAR_ISA_STR64:
+            return "STR64";
+        case PAR_ISA_REF8:
+            return "REF8";
+        case PAR_ISA_REF16:
+            return "REF16";
+        case PAR_ISA_REF32:
+            return "REF32";
+        case PAR_ISA_REF64:
+            return "REF64";
+        case PAR_ISA_ARR8:
+            return "ARR8";
+        case PAR_ISA_ARR16:
+            return "ARR16";
+        case PAR_ISA_ARR32:
+            return "ARR32";
+        case PAR_ISA_ARR64:
+            return "ARR64";
+        case PAR_ISA_MAP8:
+            return "MAP8";
+        case PAR_ISA_MAP16:
+            return "MAP16";
+        case PAR_ISA_MAP32:
+            return "MAP32";
+        case PAR_ISA_MAP64:
+            return "MAP64";
+        case PAR_ISA_SET8:
+            return "SET8";
+        case PAR_ISA_SET16:
+            return "SET16";
+        case PAR_ISA_SET32:
+            return "SET32";
+        case PAR_ISA_SET64:
+            return "SET64";
+        case PAR_ISA_NAN:
+            return "NAN";
+        case PAR_ISA_F16:
+            return "F16";
+        case PAR_ISA_F32:
+            return "F32";
+        case PAR_ISA_F64:
+            return "F64";
+        case PAR_ISA_NINF:
+            return "NINF";
+        case PAR_ISA_PINF:
+            return "PINF";
+        case PAR_ISA_TRUE:
+            return "TRUE";
+        case PAR_ISA_FALSE:
+            return "FALSE";
+        case PAR_ISA_NIL:
+            return "NIL";
+        case PAR_ISA_IDX:
+            return "IDX";
+        case PAR_ISA_EOS:
+            return "EOS";
+        case PAR_ISA_SARR:
+            return "SARR";
+        case PAR_ISA_SMAP:
+            return "SMAP";
+        case PAR_ISA_SSET:
+            return "SSET";
+        case PAR_ISA_IARR:
+            return "IARR";
+        case PAR_ISA_IMAP:
+            return "IMAP";
+        case PAR_ISA_REC:
+            return "REC";
+        case PAR_ISA_COL:
+            return "COL";
+        case PAR_ISA_EXT:
+            return "EXT";
+        case PAR_ISA_HYB:
+            return "HYB";
+        case PAR_ISA_STR5 ... PAR_ISA_STR5_TAIL:
+            return "STR5";
+        case PAR_ISA_ARR4 ... PAR_ISA_ARR4_TAIL:
+            return "ARR4";
+        case PAR_ISA_MAP4 ... PAR_ISA_MAP4_TAIL:
+            return "MAP4";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+
+// MARK: statistics
+//
+// packer and unpacker update the statistics only if a par_stats_t has
+// been attached with par_pack_stats()/par_unpack_stats(), so that the
+// cost is a single pointer check per value.
+// define PARCEL_NO_STATS to compile the collection out.
+//
+typedef struct {
+    // number of bytes handed to the caller or reducer (pack), or consumed
+    // (unpack)
+    uint_fast64_t bytes;
+    // peak size of memory block
+    uint_fast64_t peak;
+    // number of memory block reallocations
+    uint_fast64_t nrealloc;
+    // number of reducer calls
+    uint_fast64_t nreduce;
+    // number of pack/unpack calls
+    uint_fast64_t ncall;
+    // nesting depth of containers
+    uint_fast64_t depth;
+    uint_fast64_t maxdepth;
+    // cumulative time in nanoseconds
+    uint_fast64_t nsec;
+    // number of values per type byte
+    uint_fast64_t isa[256];
+} par_stats_t;
+
+
+#if defined(PARCEL_NO_STATS)
+
+#define _PAR_STATS_ADD( s, field, n )
+#define _PAR_STATS_PEAK( s, size )
+#define _PAR_STATS_ISA( s, type )
+
+#else
+
+#define _PAR_STATS_ADD( s, field, n ) do { \
+    if( s ){ \
+        (s)->field += (n); \
+    } \
+}while(0)
+
+#define _PAR_STATS_PEAK( s, size ) do { \
+    if( (s) && (s)->peak < (size) ){ \
+        (s)->peak = (size); \
+    } \
+}while(0)
+
+#define _PAR_STATS_ISA( s, type ) do { \
+    if( s ){ \
+        (s)->isa[(uint8_t)(type)]++; \
+    } \
+}while(0)
+
+#endif
+
+
+static inline void par_stats_enter( par_stats_t *s )
+{
+    _PAR_STATS_ADD( s, depth, 1 );
+#if !defined(PARCEL_NO_STATS)
+    if( s && s->depth > s->maxdepth ){
+        s->maxdepth = s->depth;
+    }
+#endif
+}
+
+
+static inline void par_stats_leave( par_stats_t *s )
+{
+    _PAR_STATS_ADD( s, depth, -1 );
+}
+
+
 // MARK: endianness
 
 // 1: little-endian, 0: big-endian
@@ -429,6 +744,151 @@ static inline uint8_t par_get_endian( void )
 }
 
 
+// host byte order at compile time
+// PAR_HOST_ENDIAN: 1 little-endian, 0 big-endian, -1 unknown
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    #define PAR_HOST_ENDIAN 1
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    #define PAR_HOST_ENDIAN 0
+#else
+    #define PAR_HOST_ENDIAN -1
+#endif
+
+
+// byte swap
+#if defined(__GNUC__)
+    #define par_bswap16( v )    __builtin_bswap16( v )
+    #define par_bswap32( v )    __builtin_bswap32( v )
+    #define par_bswap64( v )    __builtin_bswap64( v )
+#else
+    #define par_bswap16( v )    ({ uint16_t _v = (v); _PAR_BSWAP16( _v ); _v; })
+    #define par_bswap32( v )    ({ uint32_t _v = (v); _PAR_BSWAP32( _v ); _v; })
+    #define par_bswap64( v )    ({ uint64_t _v = (v); _PAR_BSWAP64( _v ); _v; })
+#endif
+
+
+// load exact width big-endian values from unaligned memory
+#if PAR_HOST_ENDIAN == 1
+    #define _PAR_LOAD_BE( bit, ptr ) ({ \
+        uint##bit##_t _v; \
+        memcpy( &_v, (ptr), sizeof( _v ) ); \
+        par_bswap##bit( _v ); \
+    })
+#elif PAR_HOST_ENDIAN == 0
+    #define _PAR_LOAD_BE( bit, ptr ) ({ \
+        uint##bit##_t _v; \
+        memcpy( &_v, (ptr), sizeof( _v ) ); \
+        _v; \
+    })
+#else
+    #define _PAR_LOAD_BE( bit, ptr ) ({ \
+        const uint8_t *_b = (const uint8_t*)(ptr); \
+        uint##bit##_t _v = 0; \
+        size_t _i = 0; \
+        for(; _i < sizeof( _v ); _i++ ){ \
+            _v = (uint##bit##_t)( _v << 8 ) | _b[_i]; \
+        } \
+        _v; \
+    })
+#endif
+
+static inline uint8_t par_load_be8( const void *ptr )
+{
+    return *(const uint8_t*)ptr;
+}
+
+static inline uint16_t par_load_be16( const void *ptr )
+{
+    return _PAR_LOAD_BE( 16, ptr );
+}
+
+static inline uint32_t par_load_be32( const void *ptr )
+{
+    return _PAR_LOAD_BE( 32, ptr );
+}
+
+static inline uint64_t par_load_be64( const void *ptr )
+{
+    return _PAR_LOAD_BE( 64, ptr );
+}
+
+#undef _PAR_LOAD_BE
+
+
+// store exact width big-endian values to unaligned memory
+#if PAR_HOST_ENDIAN == 1
+    #define _PAR_STORE_BE( bit, ptr, v ) do { \
+        uint##bit##_t _v = par_bswap##bit( (uint##bit##_t)(v) ); \
+        memcpy( (ptr), &_v, sizeof( _v ) ); \
+    }while(0)
+#elif PAR_HOST_ENDIAN == 0
+    #define _PAR_STORE_BE( bit, ptr, v ) do { \
+        uint##bit##_t _v = (uint##bit##_t)(v); \
+        memcpy( (ptr), &_v, sizeof( _v ) ); \
+    }while(0)
+#else
+    #define _PAR_STORE_BE( bit, ptr, v ) do { \
+        uint8_t *_b = (uint8_t*)(ptr); \
+        uint##bit##_t _v = (uint##bit##_t)(v); \
+        size_t _i = sizeof( _v ); \
+        while( _i-- ){ \
+            _b[_i] = (uint8_t)_v; \
+            _v = _v >> 8; \
+        } \
+    }while(0)
+#endif
+
+static inline void par_store_be16( void *ptr, uint16_t v )
+{
+    _PAR_STORE_BE( 16, ptr, v );
+}
+
+static inline void par_store_be32( void *ptr, uint32_t v )
+{
+    _PAR_STORE_BE( 32, ptr, v );
+}
+
+static inline void par_store_be64( void *ptr, uint64_t v )
+{
+    _PAR_STORE_BE( 64, ptr, v );
+}
+
+#undef _PAR_STORE_BE
+
+
+// load and store the big-endian value of 1, 2, 4 or 8 byte width
+static inline uint64_t par_load_bewidth( const void *ptr, size_t width )
+{
+    switch( width ){
+        case 1:
+            return par_load_be8( ptr );
+        case 2:
+            return par_load_be16( ptr );
+        case 4:
+            return par_load_be32( ptr );
+        default:
+            return par_load_be64( ptr );
+    }
+}
+
+static inline void par_store_bewidth( void *ptr, uint64_t v, size_t width )
+{
+    switch( width ){
+        case 1:
+            *(uint8_t*)ptr = (uint8_t)v;
+        break;
+        case 2:
+            par_store_be16( ptr, (uint16_t)v );
+        break;
+        case 4:
+            par_store_be32( ptr, (uint32_t)v );
+        break;
+        default:
+            par_store_be64( ptr, v );
+    }
+}
+
+
 // MARK: memory block size
 
 #define PAR_DEFAULT_BLKSIZE     1024
@@ -450,6 +910,232 @@ static inline size_t _par_align_blksize( size_t blksize )
 #undef PAR_BLKSIZE_ALIGNMENT
 
 
+// MARK: buffer pool
+//
+// free lists of memory blocks per size class for short-lived packers.
+// the size of class N is 2^(PAR_POOL_MINSHIFT + N) bytes.
+// NOTE: a pool is not thread safe, use one pool per lua state or thread.
+//
+#define PAR_POOL_MINSHIFT   12
+#define PAR_POOL_NCLASS     8
+#define PAR_POOL_NSLOT      4
+
+typedef struct {
+    void *mem;
+    size_t bytes;
+} par_pool_blk_t;
+
+typedef struct {
+    size_t nfree[PAR_POOL_NCLASS];
+    par_pool_blk_t free[PAR_POOL_NCLASS][PAR_POOL_NSLOT];
+} par_pool_t;
+
+
+static inline void par_pool_init( par_pool_t *pool )
+{
+    memset( (void*)pool, 0, sizeof( par_pool_t ) );
+}
+
+
+static inline void par_pool_dispose( par_pool_t *pool )
+{
+    size_t c = 0;
+
+    for(; c < PAR_POOL_NCLASS; c++ ){
+        while( pool->nfree[c] ){
+            free( pool->free[c][--pool->nfree[c]].mem );
+        }
+    }
+}
+
+
+// get a memory block of *bytes or more, and set its size to *bytes
+static inline void *par_pool_get( par_pool_t *pool, size_t *bytes )
+{
+    size_t c = 0;
+
+    while( c < PAR_POOL_NCLASS &&
+           ( (size_t)1 << ( PAR_POOL_MINSHIFT + c ) ) < *bytes ){
+        c++;
+    }
+
+    // too large
+    if( c == PAR_POOL_NCLASS ){
+        return malloc( *bytes );
+    }
+    else if( pool->nfree[c] ){
+        par_pool_blk_t *blk = &pool->free[c][--pool->nfree[c]];
+
+        *bytes = blk->bytes;
+        return blk->mem;
+    }
+
+    *bytes = (size_t)1 << ( PAR_POOL_MINSHIFT + c );
+    return malloc( *bytes );
+}
+
+
+// put back a memory block to the class of its size, or free it
+static inline void par_pool_put( par_pool_t *pool, void *mem, size_t bytes )
+{
+    size_t c = PAR_POOL_NCLASS;
+
+    while( c-- ){
+        if( bytes >= ( (size_t)1 << ( PAR_POOL_MINSHIFT + c ) ) )
+        {
+            if( bytes < ( (size_t)1 << ( PAR_POOL_MINSHIFT + c + 1 ) ) &&
+                pool->nfree[c] < PAR_POOL_NSLOT ){
+                par_pool_blk_t *blk = &pool->free[c][pool->nfree[c]++];
+
+                blk->mem = mem;
+                blk->bytes = bytes;
+                return;
+            }
+            break;
+        }
+    }
+
+    free( mem );
+}
+
+#undef PAR_POOL_MINSHIFT
+#undef PAR_POOL_NSLOT
+
+
+// MARK: content hash
+//
+// XXH64 that consumes the input in 32 byte stripes. the stripes are fed
+// incrementally and the rest of the input is fed at once by the final.
+//
+#define PAR_XXH_PRIME1  0x9E3779B185EBCA87ULL
+#define PAR_XXH_PRIME2  0xC2B2AE3D27D4EB4FULL
+#define PAR_XXH_PRIME3  0x165667B19E3779F9ULL
+#define PAR_XXH_PRIME4  0x85EBCA77C2B2AE63ULL
+#define PAR_XXH_PRIME5  0x27D4EB2F165667C5ULL
+
+#define _PAR_XXH_ROTL( v, n )  (((v) << (n)) | ((v) >> (64 - (n))))
+
+#define _PAR_XXH_LOAD64( ptr )  par_bswap64( par_load_be64( ptr ) )
+#define _PAR_XXH_LOAD32( ptr )  par_bswap32( par_load_be32( ptr ) )
+
+typedef struct {
+    uint64_t seed;
+    uint64_t v[4];
+} par_xxh64_t;
+
+
+static inline void par_xxh64_init( par_xxh64_t *h, uint64_t seed )
+{
+    h->seed = seed;
+    h->v[0] = seed + PAR_XXH_PRIME1 + PAR_XXH_PRIME2;
+    h->v[1] = seed + PAR_XXH_PRIME2;
+    h->v[2] = seed;
+    h->v[3] = seed - PAR_XXH_PRIME1;
+}
+
+
+static inline uint64_t _par_xxh64_round( uint64_t acc, uint64_t lane )
+{
+    acc += lane * PAR_XXH_PRIME2;
+    acc = _PAR_XXH_ROTL( acc, 31 );
+    return acc * PAR_XXH_PRIME1;
+}
+
+
+static inline uint64_t _par_xxh64_merge( uint64_t h64, uint64_t v )
+{
+    h64 ^= _par_xxh64_round( 0, v );
+    return h64 * PAR_XXH_PRIME1 + PAR_XXH_PRIME4;
+}
+
+
+// feed the whole stripes of mem, and returns the number of consumed bytes
+static inline size_t par_xxh64_stripes( par_xxh64_t *h, const void *mem,
+                                        size_t len )
+{
+    const uint8_t *ptr = (const uint8_t*)mem;
+    const uint8_t *tail = ptr + ( len & ~(size_t)31 );
+
+    for(; ptr < tail; ptr += 32 ){
+        h->v[0] = _par_xxh64_round( h->v[0], _PAR_XXH_LOAD64( ptr ) );
+        h->v[1] = _par_xxh64_round( h->v[1], _PAR_XXH_LOAD64( ptr + 8 ) );
+        h->v[2] = _par_xxh64_round( h->v[2], _PAR_XXH_LOAD64( ptr + 16 ) );
+        h->v[3] = _par_xxh64_round( h->v[3], _PAR_XXH_LOAD64( ptr + 24 ) );
+    }
+
+    return len & ~(size_t)31;
+}
+
+
+// digest the total bytes of input, mem is the rest of input that is less
+// than 32 bytes.
+static inline uint64_t par_xxh64_final( par_xxh64_t *h, const void *mem,
+                                        size_t len, uint64_t total )
+{
+    const uint8_t *ptr = (const uint8_t*)mem;
+    uint64_t h64 = 0;
+
+    if( total >= 32 ){
+        h64 = _PAR_XXH_ROTL( h->v[0], 1 ) + _PAR_XXH_ROTL( h->v[1], 7 ) +
+              _PAR_XXH_ROTL( h->v[2], 12 ) + _PAR_XXH_ROTL( h->v[3], 18 );
+        h64 = _par_xxh64_merge( h64, h->v[0] );
+        h64 = _par_xxh64_merge( h64, h->v[1] );
+        h64 = _par_xxh64_merge( h64, h->v[2] );
+        h64 = _par_xxh64_merge( h64, h->v[3] );
+    }
+    else {
+        h64 = h->seed + PAR_XXH_PRIME5;
+    }
+    h64 += total;
+
+    for(; len >= 8; ptr += 8, len -= 8 ){
+        h64 ^= _par_xxh64_round( 0, _PAR_XXH_LOAD64( ptr ) );
+        h64 = _PAR_XXH_ROTL( h64, 27 ) * PAR_XXH_PRIME1 + PAR_XXH_PRIME4;
+    }
+    if( len >= 4 ){
+        h64 ^= (uint64_t)_PAR_XXH_LOAD32( ptr ) * PAR_XXH_PRIME1;
+        h64 = _PAR_XXH_ROTL( h64, 23 ) * PAR_XXH_PRIME2 + PAR_XXH_PRIME3;
+        ptr += 4;
+        len -= 4;
+    }
+    for(; len; ptr++, len-- ){
+        h64 ^= (uint64_t)*ptr * PAR_XXH_PRIME5;
+        h64 = _PAR_XXH_ROTL( h64, 11 ) * PAR_XXH_PRIME1;
+    }
+
+    // avalanche
+    h64 ^= h64 >> 33;
+    h64 *= PAR_XXH_PRIME2;
+    h64 ^= h64 >> 29;
+    h64 *= PAR_XXH_PRIME3;
+    h64 ^= h64 >> 32;
+
+    return h64;
+}
+
+#undef PAR_XXH_PRIME1
+#undef PAR_XXH_PRIME2
+#undef PAR_XXH_PRIME3
+#undef PAR_XXH_PRIME4
+#undef PAR_XXH_PRIME5
+#undef _PAR_XXH_ROTL
+#undef _PAR_XXH_LOAD64
+#undef _PAR_XXH_LOAD32
+
+
+// XXH64 of the whole memory
+static inline uint64_t par_xxh64( const void *mem, size_t len, uint64_t seed )
+{
+    par_xxh64_t h;
+    size_t n = 0;
+
+    par_xxh64_init( &h, seed );
+    n = par_xxh64_stripes( &h, mem, len );
+
+    return par_xxh64_final( &h, (const char*)mem + n, len - n, len );
+}
+
+
 // MARK: data structures and management API
 
 // for stream
@@ -461,6 +1147,8 @@ typedef struct _par_pack_t {
     // stream
     par_reduce_t reducer;
     void *udata;
+    // statistics
+    par_stats_t *stats;
     uint8_t endian;
     size_t cur;
     size_t blksize;
@@ -468,9 +1156,30 @@ typedef struct _par_pack_t {
     size_t nblk;
     size_t bytes;
     void *mem;
+    // memory block pool
+    par_pool_t *pool;
+    // external memory that is not owned by packer
+    void *extmem;
+    size_t extbytes;
+    // minimum number of elements of the indexed array/map. 0: disabled
+    size_t index_min;
+    // minimum number of rows of the columnar array. 0: disabled
+    size_t col_min;
+    // head of the bytes that can be moved, e.g. the payload packed after
+    // par_pack_ext_open(). SIZE_MAX: none
+    size_t held;
 } par_pack_t;
 
 
+static inline int _par_pack_call_reducer( par_pack_t *p, void *mem,
+                                          size_t bytes )
+{
+    _PAR_STATS_ADD( p->stats, nreduce, 1 );
+    _PAR_STATS_ADD( p->stats, bytes, bytes );
+    return p->reducer( mem, bytes, p->udata );
+}
+
+
 static inline void *_par_pack_increase( par_pack_t *p, size_t bytes )
 {
     size_t remain = p->bytes - p->cur;
@@ -486,7 +1195,7 @@ static inline void *_par_pack_increase( par_pack_t *p, size_t bytes )
         {
             void *mem = NULL;
 
-            bytes = p->blksize * ( p->nblk + nblk );
+            bytes = p->bytes + p->blksize * nblk;
             // failed to allocate memory block
             if( !( mem = realloc( p->mem, bytes ) ) ){
                 return NULL;
@@ -495,6 +1204,8 @@ static inline void *_par_pack_increase( par_pack_t *p, size_t bytes )
             p->mem = mem;
             p->nblk += nblk;
             p->bytes = bytes;
+            _PAR_STATS_ADD( p->stats, nrealloc, 1 );
+            _PAR_STATS_PEAK( p->stats, bytes );
         }
         else {
             errno = PARCEL_ENOMEM;
@@ -513,7 +1224,7 @@ static inline void *_par_pack_reduce( par_pack_t *p, size_t bytes )
     if( remain < bytes )
     {
         // failed to reduce memory
-        if( p->reducer( p->mem, p->cur, p->udata ) != 0 ){
+        if( _par_pack_call_reducer( p, p->mem, p->cur ) != 0 ){
             return NULL;
         }
         // rewind cursor
@@ -538,6 +1249,13 @@ static inline int par_pack_init( par_pack_t *p, size_t blksize,
         p->bytes = blksize;
         p->reducer = reducer;
         p->udata = udata;
+        p->stats = NULL;
+        p->pool = NULL;
+        p->extmem = NULL;
+        p->extbytes = 0;
+        p->index_min = 0;
+        p->col_min = 0;
+        p->held = SIZE_MAX;
         // set allocator
         p->allocf = ( reducer ) ? _par_pack_reduce: _par_pack_increase;
         return PARCEL_OK;
@@ -547,21 +1265,37 @@ static inline int par_pack_init( par_pack_t *p, size_t blksize,
 }
 
 
-#define par_pack_dispose( p ) do { \
-    if( (p)->mem ){ \
-        free( (p)->mem ); \
-        (p)->mem = NULL; \
-    } \
-}while(0)
-
+// space for the fixed width store of the last value
+#define PAR_PACK_TAILROOM   9
 
-static inline int par_pack_reset( par_pack_t *p )
+// init with the memory block of bytes that computed by par_sizeof_*.
+// the memory block is allocated at once.
+static inline int par_pack_init_size( par_pack_t *p, size_t bytes )
 {
-    par_pack_dispose( p );
-    if( ( p->mem = malloc( p->blksize ) ) ){
+    size_t blksize = _par_align_blksize( bytes );
+
+    bytes += PAR_PACK_TAILROOM;
+    if( bytes < blksize ){
+        bytes = blksize;
+    }
+    if( ( p->mem = malloc( bytes ) ) )
+    {
+        p->endian = par_get_endian();
         p->cur = 0;
+        p->blksize = blksize;
+        p->nblkmax = SIZE_MAX / blksize;
         p->nblk = 1;
-        p->bytes = p->blksize;
+        p->bytes = bytes;
+        p->reducer = NULL;
+        p->udata = NULL;
+        p->stats = NULL;
+        p->pool = NULL;
+        p->extmem = NULL;
+        p->extbytes = 0;
+        p->index_min = 0;
+        p->col_min = 0;
+        p->held = SIZE_MAX;
+        p->allocf = _par_pack_increase;
         return PARCEL_OK;
     }
 
@@ -569,33 +1303,236 @@ static inline int par_pack_reset( par_pack_t *p )
 }
 
 
-static inline int par_pack_merge( par_pack_t *pdest, par_pack_t *psrc )
+// move the packed bytes from the external memory to the memory block of the
+// pool, and switch to the _par_pack_increase allocator.
+static inline void *_par_pack_spill( par_pack_t *p, size_t bytes )
 {
-    void *mem = _par_pack_increase( pdest, psrc->cur );
+    if( ( p->bytes - p->cur ) < bytes )
+    {
+        size_t size = p->cur + bytes;
+        void *mem = NULL;
 
-    if( mem ){
-        memcpy( pdest->mem + pdest->cur, psrc->mem, psrc->cur );
-        pdest->cur += psrc->cur;
-        return PARCEL_OK;
+        // at least double the size
+        if( size < p->bytes * 2 ){
+            size = p->bytes * 2;
+        }
+        mem = ( p->pool ) ? par_pool_get( p->pool, &size ) : malloc( size );
+        // failed to allocate memory block
+        if( !mem ){
+            return NULL;
+        }
+        memcpy( mem, p->mem, p->cur );
+        // update
+        p->mem = mem;
+        p->bytes = size;
+        p->nblk = size / p->blksize + 1;
+        p->allocf = _par_pack_increase;
+        _PAR_STATS_ADD( p->stats, nrealloc, 1 );
+        _PAR_STATS_PEAK( p->stats, size );
     }
 
-    return -1;
+    return p->mem;
 }
 
 
-// allocate sizeof(t) and extra bytes
-#define _PAR_PACK_SLICE( p, l ) ({ \
-    void *_mem = (p)->allocf( p, l ); \
-    if( !_mem ){ \
-        return -1; \
-    } \
-    _mem = (p)->mem + (p)->cur; \
-    (p)->cur += l; \
-    _mem; \
-})
+// init with the external memory, e.g. the buffer on the stack.
+// the packer draws the memory block from the pool when the packed bytes
+// exceed the external memory. pool can be NULL.
+static inline void par_pack_init_mem( par_pack_t *p, void *mem, size_t bytes,
+                                      par_pool_t *pool )
+{
+    p->endian = par_get_endian();
+    p->cur = 0;
+    p->blksize = _par_align_blksize( 0 );
+    p->nblkmax = SIZE_MAX / p->blksize;
+    p->nblk = 1;
+    p->bytes = bytes;
+    p->mem = mem;
+    p->reducer = NULL;
+    p->udata = NULL;
+    p->stats = NULL;
+    p->pool = pool;
+    p->extmem = mem;
+    p->extbytes = bytes;
+    p->index_min = 0;
+    p->col_min = 0;
+    p->held = SIZE_MAX;
+    p->allocf = _par_pack_spill;
+}
 
 
-static inline int _par_pack_type_set( par_type_t *pval, uint8_t type,
+// release the memory block to the pool or the system.
+// the external memory is not released.
+#define par_pack_dispose( p ) do { \
+    if( (p)->mem && (p)->mem != (p)->extmem ){ \
+        if( (p)->pool ){ \
+            par_pool_put( (p)->pool, (p)->mem, (p)->bytes ); \
+        } \
+        else { \
+            free( (p)->mem ); \
+        } \
+    } \
+    (p)->mem = NULL; \
+}while(0)
+
+
+// detach the memory block of the packed bytes from the packer.
+// the bytes are terminated by '\0' and the block must be released by free().
+// returns NULL if the bytes are in the external memory or failed to allocate
+// the space of the terminator.
+static inline void *par_pack_detach( par_pack_t *p )
+{
+    void *mem = p->mem;
+
+    if( mem == p->extmem || !p->allocf( p, 1 ) ){
+        return NULL;
+    }
+    // allocf may move the memory block
+    mem = p->mem;
+    ((char*)mem)[p->cur] = 0;
+    p->mem = NULL;
+
+    return mem;
+}
+
+
+static inline int par_pack_reset( par_pack_t *p )
+{
+    par_pack_dispose( p );
+    p->held = SIZE_MAX;
+    // rewind to the external memory
+    if( p->extmem ){
+        p->mem = p->extmem;
+        p->cur = 0;
+        p->nblk = 1;
+        p->bytes = p->extbytes;
+        p->allocf = _par_pack_spill;
+        return PARCEL_OK;
+    }
+    else if( ( p->mem = malloc( p->blksize ) ) ){
+        p->cur = 0;
+        p->nblk = 1;
+        p->bytes = p->blksize;
+        return PARCEL_OK;
+    }
+
+    return -1;
+}
+
+
+// attach statistics
+static inline void par_pack_stats( par_pack_t *p, par_stats_t *stats )
+{
+    p->stats = stats;
+    _PAR_STATS_PEAK( stats, p->bytes );
+}
+
+
+// pass the packed bytes to the reducer and rewind the cursor
+static inline int par_pack_flush( par_pack_t *p )
+{
+    if( _par_pack_call_reducer( p, p->mem, p->cur ) == 0 ){
+        p->cur = 0;
+        return PARCEL_OK;
+    }
+
+    return -1;
+}
+
+
+static inline int par_pack_merge( par_pack_t *pdest, par_pack_t *psrc )
+{
+    void *mem = ( pdest->allocf == _par_pack_spill ) ?
+                _par_pack_spill( pdest, psrc->cur ) :
+                _par_pack_increase( pdest, psrc->cur );
+
+    if( mem ){
+        memcpy( pdest->mem + pdest->cur, psrc->mem, psrc->cur );
+        pdest->cur += psrc->cur;
+        return PARCEL_OK;
+    }
+
+    return -1;
+}
+
+
+// MARK: hashing packer
+//
+// the allocator of the packer is wrapped to feed the packed bytes to XXH64
+// before every append, while they are still in the cache.
+//
+typedef struct {
+    // must be the first member
+    par_pack_t p;
+    // allocator of the packer
+    void *(*allocf)( par_pack_t *p, size_t bytes );
+    par_xxh64_t xxh;
+    // number of hashed bytes
+    size_t hashed;
+} par_pack_hash_t;
+
+
+// number of bytes that can be hashed. the bytes that can be moved are hashed
+// after they are settled.
+#define _par_pack_hashable( p ) \
+    ( (p)->cur < (p)->held ? (p)->cur : (p)->held )
+
+static inline void *_par_pack_hash( par_pack_t *p, size_t bytes )
+{
+    par_pack_hash_t *h = (par_pack_hash_t*)p;
+    void *mem = NULL;
+
+    h->hashed += par_xxh64_stripes( &h->xxh, (char*)p->mem + h->hashed,
+                                    _par_pack_hashable( p ) - h->hashed );
+    mem = h->allocf( p, bytes );
+    // allocator has been switched, e.g. _par_pack_spill
+    if( p->allocf != _par_pack_hash ){
+        h->allocf = p->allocf;
+        p->allocf = _par_pack_hash;
+    }
+
+    return mem;
+}
+
+
+// start hashing of the initialized packer.
+// NOTE: the packer with reducer is not supported.
+static inline void par_pack_hash_init( par_pack_hash_t *h, uint64_t seed )
+{
+    h->allocf = h->p.allocf;
+    h->p.allocf = _par_pack_hash;
+    par_xxh64_init( &h->xxh, seed );
+    h->hashed = 0;
+}
+
+
+// digest the packed bytes, and restore the allocator
+static inline uint64_t par_pack_hash_final( par_pack_hash_t *h )
+{
+    par_pack_t *p = &h->p;
+
+    h->hashed += par_xxh64_stripes( &h->xxh, (char*)p->mem + h->hashed,
+                                    p->cur - h->hashed );
+    p->allocf = h->allocf;
+
+    return par_xxh64_final( &h->xxh, (char*)p->mem + h->hashed,
+                            p->cur - h->hashed, p->cur );
+}
+
+
+// allocate sizeof(t) and extra bytes
+#define _PAR_PACK_SLICE( p, l ) ({ \
+    void *_mem = (p)->allocf( p, l ); \
+    if( !_mem ){ \
+        return -1; \
+    } \
+    _mem = (p)->mem + (p)->cur; \
+    (p)->cur += l; \
+    _mem; \
+})
+
+
+static inline int _par_pack_type_set( par_type_t *pval, uint8_t type,
                                       uint8_t attr, uint8_t domain )
 {
     if( attr & ~domain ){
@@ -610,6 +1547,7 @@ static inline int _par_pack_type_set( par_type_t *pval, uint8_t type,
 #define _PAR_PACK_TYPE_EX( p, type, ex, ptr ) do { \
     par_type_t *_pval = _PAR_PACK_SLICE( p, PAR_TYPE_SIZE + (ex) ); \
     _pval->isa = (type); \
+    _PAR_STATS_ISA( (p)->stats, _pval->isa ); \
     *(ptr) = (void*)(_pval + PAR_TYPE_SIZE); \
 }while(0)
 
@@ -686,88 +1624,143 @@ static inline int par_pack_inf( par_pack_t *p, double num )
 
 
 // MARK: integeral number
-#define _PAR_PACK_NBIT_VAL_EX( p, ptr, type, bit, v, ex ) do { \
-    par_type_t *_pval = _PAR_PACK_SLICE(p, PAR_TYPE##bit##_SIZE+(ex)); \
-    void *_val = (void*)(_pval+PAR_TYPE_SIZE); \
-    _pval->isa = type##bit; \
-    memcpy( _val, (void*)&(v), bit >> 3 ); \
-    if( (p)->endian ){ \
-        _PAR_BSWAP##bit( *((uint_fast##bit##_t*)_val) ); \
+
+// count leading zeros of non-zero value
+#if defined(__GNUC__)
+    #define par_clz64( v )  __builtin_clzll( (unsigned long long)(v) )
+#else
+static inline int par_clz64( uint64_t v )
+{
+    int n = 0;
+
+    while( !( v & 0x8000000000000000ULL ) ){
+        v <<= 1;
+        n++;
+    }
+
+    return n;
+}
+#endif
+
+
+// width class of the payload
+// 0: 8 bit, 1: 16 bit, 2: 32 bit, 3: 64 bit
+#define _PAR_WCLASS( nbyte ) \
+    ( ( (nbyte) > 0 ) + ( (nbyte) > 1 ) + ( (nbyte) > 3 ) )
+
+// width class of unsigned integer
+static inline uint_fast8_t par_uint_wclass( uint_fast64_t v )
+{
+    // number of significant bytes - 1
+    return _PAR_WCLASS( ( 63 - par_clz64( v | 1 ) ) >> 3 );
+}
+
+// width class of signed integer
+static inline uint_fast8_t par_int_wclass( int_fast64_t v )
+{
+    // significant bits of absolute value and sign bit
+    uint64_t m = (uint64_t)( v ^ ( v >> 63 ) );
+    return _PAR_WCLASS( ( 64 - par_clz64( m | 1 ) ) >> 3 );
+}
+
+#undef _PAR_WCLASS
+
+
+// write the type byte and the payload of width class.
+// the payload is always written by a fixed 64 bit store of the value shifted
+// to the most significant bytes, so that there is no branch for the width and
+// dst must have PAR_TYPE64_SIZE bytes space. the bytes after the payload are
+// overwritten by the next value.
+static inline void par_store_type_nbit( void *dst, uint8_t isa, uint64_t v,
+                                        uint_fast8_t wclass )
+{
+    *(uint8_t*)dst = isa;
+    par_store_be64( (uint8_t*)dst + PAR_TYPE_SIZE,
+                    v << ( 64 - ( 8 << wclass ) ) );
+}
+
+
+// reserve PAR_TYPE64_SIZE + ex bytes, and append type and payload.
+// *ptr points to the ex bytes space, the caller must advance the cursor after
+// writing it.
+#define _PAR_PACK_NBIT_VAL_EX( p, ptr, isa, wclass, v, ex ) do { \
+    uint_fast8_t _isa = (isa); \
+    uint_fast8_t _wclass = (wclass); \
+    if( !(p)->allocf( p, PAR_TYPE64_SIZE + (ex) ) ){ \
+        return -1; \
     } \
-    *(ptr) = (void*)( _pval + PAR_TYPE##bit##_SIZE ); \
+    par_store_type_nbit( (p)->mem + (p)->cur, _isa, (uint64_t)(v), _wclass ); \
+    _PAR_STATS_ISA( (p)->stats, _isa ); \
+    (p)->cur += PAR_TYPE_SIZE + ( 1 << _wclass ); \
+    *(ptr) = (void*)( (p)->mem + (p)->cur ); \
 }while(0)
 
-#define _PAR_PACK_NBIT_VAL( p, type, bit, v ) do { \
+#define _PAR_PACK_NBIT_VAL( p, isa, wclass, v ) do { \
     void *_unused = NULL; \
-    _PAR_PACK_NBIT_VAL_EX( p, &_unused, type, bit, v, 0 ); \
+    _PAR_PACK_NBIT_VAL_EX( p, &_unused, isa, wclass, v, 0 ); \
 }while(0)
 
 
 // MARK: float32
 static inline int par_pack_float32( par_pack_t *p, float num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_F, 32, num );
+    uint32_t v = 0;
+
+    memcpy( &v, &num, sizeof( v ) );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_F32, 2, v );
     return PARCEL_OK;
 }
 
 // MARK: float64
 static inline int par_pack_float64( par_pack_t *p, double num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_F, 64, num );
+    uint64_t v = 0;
+
+    memcpy( &v, &num, sizeof( v ) );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_F64, 3, v );
     return PARCEL_OK;
 }
 
 // MARK: uint8
 static inline int par_pack_uint8( par_pack_t *p, uint_fast8_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 8, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U8, 0, num );
     return PARCEL_OK;
 }
 
 // MARK: uint16
 static inline int par_pack_uint16( par_pack_t *p, uint_fast16_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 16, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U16, 1, num );
     return PARCEL_OK;
 }
 
 // MARK: uint32
 static inline int par_pack_uint32( par_pack_t *p, uint_fast32_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 32, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U32, 2, num );
     return PARCEL_OK;
 }
 
 // MARK: uint64
 static inline int par_pack_uint64( par_pack_t *p, uint_fast64_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 64, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_U64, 3, num );
     return PARCEL_OK;
 }
 
 
 // MARK: unsigned integer
-#define _PAR_PACK_UINT( p, num ) do { \
-    if( (num) <= PAR_INT6_MAX ){ \
-        _PAR_PACK_TYPE( p, (uint_fast8_t)num ); \
-    } \
-    else if( (num) <= UINT8_MAX ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 8, num ); \
-    } \
-    else if( (num) <= UINT16_MAX ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 16, num ); \
-    } \
-    else if( (num) <= UINT32_MAX ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 32, num ); \
-    } \
-    else { \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_U, 64, num ); \
-    } \
-}while(0)
-
 static inline int par_pack_uint( par_pack_t *p, uint_fast64_t num )
 {
-    _PAR_PACK_UINT( p, num );
+    if( num <= PAR_INT6_MAX ){
+        _PAR_PACK_TYPE( p, (uint_fast8_t)num );
+    }
+    else {
+        uint_fast8_t wclass = par_uint_wclass( num );
+        _PAR_PACK_NBIT_VAL( p, PAR_ISA_U8 + wclass, wclass, num );
+    }
+
     return PARCEL_OK;
 }
 
@@ -778,85 +1771,53 @@ static inline int par_pack_idx( par_pack_t *p, uint_fast64_t idx )
     return par_pack_uint( p, idx );
 }
 
-// MARK: undef _PAR_PACK_UINT
-#undef _PAR_PACK_UINT
-
 
 // MARK: int8
 static inline int par_pack_int8( par_pack_t *p, int_fast8_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 8, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S8, 0, num );
     return PARCEL_OK;
 }
 
 // MARK: int16
 static inline int par_pack_int16( par_pack_t *p, int_fast16_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 16, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S16, 1, num );
     return PARCEL_OK;
 }
 
 // MARK: int32
 static inline int par_pack_int32( par_pack_t *p, int_fast32_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 32, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S32, 2, num );
     return PARCEL_OK;
 }
 
 // MARK: int64
 static inline int par_pack_int64( par_pack_t *p, int_fast64_t num )
 {
-    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 64, num );
+    _PAR_PACK_NBIT_VAL( p, PAR_ISA_S64, 3, num );
     return PARCEL_OK;
 }
 
 
 // MARK: signed integer
-#define _PAR_PACK_INT( p, num ) do { \
-    if( (num) > 0 ){ \
-        if( (num) > INT32_MAX ){ \
-            _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 64, num ); \
-        } \
-        else if( (num) > INT16_MAX ){ \
-            _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 32, num ); \
-        } \
-        else if( (num) > INT8_MAX ){ \
-            _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 16, num ); \
-        } \
-        else if( (num) > PAR_INT6_MAX ){ \
-            _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 8, num ); \
-        } \
-        else { \
-            _PAR_PACK_TYPE( p, (uint_fast8_t)num ); \
-        } \
-    } \
-    else if( (num) < INT32_MIN ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 64, num ); \
-    } \
-    else if( (num) < INT16_MIN ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 32, num ); \
-    } \
-    else if( (num) < INT8_MIN ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 16, num ); \
-    } \
-    else if( (num) < PAR_INT6_MIN ){ \
-        _PAR_PACK_NBIT_VAL( p, PAR_ISA_S, 8, num ); \
-    } \
-    else { \
-        _PAR_PACK_TYPE( p, (uint_fast8_t)(-num|PAR_ISA_S6N) ); \
-    } \
-}while(0)
-
-
 static inline int par_pack_int( par_pack_t *p, int_fast64_t num )
 {
-    _PAR_PACK_INT( p, num );
+    // PAR_INT6_MIN - PAR_INT6_MAX
+    if( (uint_fast64_t)num + PAR_INT6_MAX <= PAR_INT6_MAX * 2 ){
+        _PAR_PACK_TYPE( p, ( num < 0 ) ? (uint_fast8_t)-num|PAR_ISA_S6N :
+                                         (uint_fast8_t)num );
+    }
+    else {
+        uint_fast8_t wclass = par_int_wclass( num );
+        _PAR_PACK_NBIT_VAL( p, PAR_ISA_S8 + wclass, wclass, num );
+    }
+
     return PARCEL_OK;
 }
 
 
-// MARK: undef _PAR_PACK_INT
-#undef _PAR_PACK_INT
 // MARK: undef _PAR_PACK_NBIT_VAL
 #undef _PAR_PACK_NBIT_VAL
 
@@ -865,22 +1826,8 @@ static inline int par_pack_int( par_pack_t *p, int_fast64_t num )
 // MARK: packing type with length value
 
 #define _PAR_PACK_TYPE_WITH_LEN_EX( p, ptr, type, len, ex ) do { \
-    /* 64bit */ \
-    if( len & 0xFFFFFFFF00000000 ){ \
-        _PAR_PACK_NBIT_VAL_EX( p, ptr, type, 64, len, ex ); \
-    } \
-    /* 32bit */ \
-    else if( len & 0xFFFF0000 ){ \
-        _PAR_PACK_NBIT_VAL_EX( p, ptr, type, 32, len, ex ); \
-    } \
-    /* 16bit */ \
-    else if( len & 0xFF00 ){ \
-        _PAR_PACK_NBIT_VAL_EX( p, ptr, type, 16, len, ex ); \
-    } \
-    /* 8bit */ \
-    else { \
-        _PAR_PACK_NBIT_VAL_EX( p, ptr, type, 8, len, ex ); \
-    } \
+    uint_fast8_t _lwclass = par_uint_wclass( len ); \
+    _PAR_PACK_NBIT_VAL_EX( p, ptr, type##8 + _lwclass, _lwclass, len, ex ); \
 }while(0)
 
 
@@ -921,22 +1868,234 @@ static inline int par_pack_map( par_pack_t *p, size_t len )
 #undef _PAR_PACK_ARRAY
 
 
-// MARK: reference
-static inline int par_pack_ref( par_pack_t *p, size_t idx )
+// MARK: hybrid array/map
+static inline int par_pack_hyb( par_pack_t *p, size_t narr, size_t nmap )
+{
+    size_t width = (size_t)1 << par_uint_wclass( ( narr > nmap ) ? narr : nmap );
+    uint8_t *mem = NULL;
+
+    _PAR_PACK_TYPE_EX( p, PAR_ISA_HYB, 1 + width * 2, &mem );
+    mem[0] = (uint8_t)width;
+    par_store_bewidth( mem + 1, narr, width );
+    par_store_bewidth( mem + 1 + width, nmap, width );
+
+    return PARCEL_OK;
+}
+
+
+// MARK: indexed array/map
+//
+// the elements are packed first, and then the header and the offset table
+// are inserted in front of the elements by par_pack_index().
+//
+typedef struct {
+    // hash of the key. see par_key_hash()
+    uint32_t hash;
+    // offset of the element of array or the key of map
+    size_t off;
+} par_index_ent_t;
+
+
+static inline int _par_index_ent_cmp( const void *a, const void *b )
+{
+    const par_index_ent_t *x = (const par_index_ent_t*)a;
+    const par_index_ent_t *y = (const par_index_ent_t*)b;
+
+    if( x->hash != y->hash ){
+        return ( x->hash > y->hash ) - ( x->hash < y->hash );
+    }
+
+    return ( x->off > y->off ) - ( x->off < y->off );
+}
+
+
+// insert the header and the offset table of the len elements that packed
+// from start. type must be PAR_ISA_IARR or PAR_ISA_IMAP, and the entries of
+// map are sorted in place.
+// NOTE: the packer with reducer is not supported.
+static inline int par_pack_index( par_pack_t *p, uint8_t type, size_t start,
+                                  par_index_ent_t *ents, size_t len )
 {
-    if( idx < p->cur )
+    size_t size = p->cur - start;
+    size_t width = (size_t)1 << par_uint_wclass( ( len > size ) ? len : size );
+    size_t esize = width + ( ( type == PAR_ISA_IMAP ) ? 4 : 0 );
+    size_t hsize = PAR_TYPE_SIZE + 1 + width * 2;
+    uint8_t *mem = NULL;
+    size_t i = 0;
+
+    if( p->reducer ){
+        errno = PARCEL_ENOTSUP;
+        return -1;
+    }
+    else if( len > ( SIZE_MAX - hsize ) / esize ){
+        errno = PARCEL_ENOMEM;
+        return -1;
+    }
+    hsize += len * esize;
+    // allocf may move the memory block
+    if( !p->allocf( p, hsize ) ){
+        return -1;
+    }
+
+    mem = (uint8_t*)p->mem + start;
+    memmove( mem + hsize, mem, size );
+    *mem++ = type;
+    *mem++ = (uint8_t)width;
+    par_store_bewidth( mem, len, width );
+    mem += width;
+    par_store_bewidth( mem, size, width );
+    mem += width;
+    if( type == PAR_ISA_IMAP ){
+        qsort( (void*)ents, len, sizeof( par_index_ent_t ), _par_index_ent_cmp );
+    }
+    for(; i < len; i++ )
     {
-        par_type_t *pval = (par_type_t*)( p->mem + idx );
-
-        // verify type
-        switch( pval->isa ){
-            case PAR_ISA_REF8 ... PAR_ISA_MAP64:
-            case PAR_ISA_SARR:
-            case PAR_ISA_SMAP:
-            case PAR_ISA_ARR4 ... PAR_ISA_MAP4_TAIL:
-                _PAR_PACK_TYPE_WITH_LEN( p, PAR_ISA_REF, idx );
-                return PARCEL_OK;
+        if( type == PAR_ISA_IMAP ){
+            par_store_be32( mem, ents[i].hash );
+            mem += 4;
         }
+        par_store_bewidth( mem, ents[i].off, width );
+        mem += width;
+    }
+    p->cur += hsize;
+    _PAR_STATS_ISA( p->stats, type );
+
+    return PARCEL_OK;
+}
+
+
+// MARK: record
+// the nfield values must be packed after the header.
+static inline int par_pack_record( par_pack_t *p, uint8_t nfield,
+                                   uint32_t schema )
+{
+    uint8_t *mem = NULL;
+
+    _PAR_PACK_TYPE_EX( p, PAR_ISA_REC, 5, &mem );
+    mem[0] = nfield;
+    par_store_be32( mem + 1, schema );
+
+    return PARCEL_OK;
+}
+
+
+// MARK: columnar array
+//
+// the columns are packed first, and then the header is inserted in front of
+// the columns by par_pack_col(). each column is packed as the key, the
+// header that appended by par_pack_column() and the data.
+//
+enum {
+    PAR_COL_ANY = 0,
+    PAR_COL_BOOL,
+    PAR_COL_INT8,
+    PAR_COL_INT16,
+    PAR_COL_INT32,
+    PAR_COL_INT64,
+    PAR_COL_F64,
+    PAR_COL_STR
+};
+
+// all rows have the value
+#define PAR_COL_DENSE   0x80
+
+
+// reserve bytes at the cursor position and return the head of them.
+// NOTE: the packer with reducer is not supported.
+static inline uint8_t *par_pack_reserve( par_pack_t *p, size_t bytes )
+{
+    uint8_t *mem = NULL;
+
+    if( p->allocf( p, bytes ) ){
+        mem = (uint8_t*)p->mem + p->cur;
+        p->cur += bytes;
+    }
+
+    return mem;
+}
+
+
+// append the kind and the presence bitmap of nrow rows after the key of
+// column. bitmap is NULL if all rows have the value.
+static inline int par_pack_column( par_pack_t *p, uint8_t kind,
+                                   const uint8_t *bitmap, size_t nrow )
+{
+    size_t nbyte = ( bitmap ) ? ( nrow + 7 ) / 8 : 0;
+    uint8_t *mem = par_pack_reserve( p, 1 + nbyte );
+
+    if( !mem ){
+        return -1;
+    }
+    else if( bitmap ){
+        *mem = kind;
+        memcpy( mem + 1, bitmap, nbyte );
+    }
+    else {
+        *mem = kind | PAR_COL_DENSE;
+    }
+
+    return PARCEL_OK;
+}
+
+
+// insert the header of ncol columns of nrow rows that packed from start.
+// NOTE: the packer with reducer is not supported.
+static inline int par_pack_col( par_pack_t *p, size_t start, size_t nrow,
+                                size_t ncol )
+{
+    size_t size = p->cur - start;
+    size_t max = ( nrow > ncol ) ? nrow : ncol;
+    size_t width = (size_t)1 << par_uint_wclass( ( max > size ) ? max : size );
+    size_t hsize = PAR_TYPE_SIZE + 1 + width * 3;
+    uint8_t *mem = NULL;
+
+    if( p->reducer ){
+        errno = PARCEL_ENOTSUP;
+        return -1;
+    }
+    // allocf may move the memory block
+    else if( !p->allocf( p, hsize ) ){
+        return -1;
+    }
+
+    mem = (uint8_t*)p->mem + start;
+    memmove( mem + hsize, mem, size );
+    *mem++ = PAR_ISA_COL;
+    *mem++ = (uint8_t)width;
+    par_store_bewidth( mem, nrow, width );
+    par_store_bewidth( mem + width, ncol, width );
+    par_store_bewidth( mem + width * 2, size, width );
+    p->cur += hsize;
+    _PAR_STATS_ISA( p->stats, PAR_ISA_COL );
+
+    return PARCEL_OK;
+}
+
+
+// MARK: reference
+// the type of value that can be referenced by REF
+static inline int par_isref_target( uint8_t isa )
+{
+    switch( isa ){
+        case PAR_ISA_REF8 ... PAR_ISA_MAP64:
+        case PAR_ISA_SARR:
+        case PAR_ISA_SMAP:
+        case PAR_ISA_IARR:
+        case PAR_ISA_IMAP:
+        case PAR_ISA_ARR4 ... PAR_ISA_MAP4_TAIL:
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static inline int par_pack_ref( par_pack_t *p, size_t idx )
+{
+    // verify type
+    if( idx < p->cur && par_isref_target( ((uint8_t*)p->mem)[idx] ) ){
+        _PAR_PACK_TYPE_WITH_LEN( p, PAR_ISA_REF, idx );
+        return PARCEL_OK;
     }
 
     // illegal byte sequence
@@ -953,6 +2112,7 @@ static inline int par_pack_ref( par_pack_t *p, size_t idx )
     _PAR_PACK_TYPE_WITH_LEN_EX( p, &_dest, type, len, len ); \
     /* copy val */ \
     memcpy( _dest, val, len ); \
+    (p)->cur += len; \
 }while(0)
 
 
@@ -973,7 +2133,7 @@ COPY2BLOCK: \
             val += _remain; \
         } \
         /* reduce memory */ \
-        if( (p)->reducer( (p)->mem, (p)->cur, (p)->udata ) == 0 ) \
+        if( _par_pack_call_reducer( p, (p)->mem, (p)->cur ) == 0 ) \
         { \
             /* rewind cursor */ \
             (p)->cur = 0; \
@@ -983,7 +2143,7 @@ COPY2BLOCK: \
                 goto COPY2BLOCK; \
             } \
             /* reduce all */ \
-            else if( (p)->reducer( val, len, (p)->udata ) != 0 ){ \
+            else if( _par_pack_call_reducer( p, val, len ) != 0 ){ \
                 return -1; \
             } \
         } \
@@ -1037,37 +2197,303 @@ static inline int par_pack_str( par_pack_t *p, void *val, size_t len )
 }
 
 
-// MARK: undef _PAR_SPACK_BYTEA
-#undef _PAR_SPACK_BYTEA
-// MARK: undef _PAR_PACK_BYTEA
-#undef _PAR_PACK_BYTEA
-// MARK: undef _PAR_PACK_TYPE_WITH_LEN
-#undef _PAR_PACK_TYPE_WITH_LEN
-// MARK: undef _PAR_PACK_TYPE_WITH_LEN_EX
-#undef _PAR_PACK_TYPE_WITH_LEN_EX
-// MARK: undef _PAR_PACK_SLICE
-#undef _PAR_PACK_SLICE
-// MARK: undef _PAR_PACK_TYPE
-#undef _PAR_PACK_TYPE
-// MARK: undef _PAR_PACK_TYPE_EX
-#undef _PAR_PACK_TYPE_EX
+// MARK: extension
+// header size of the payload that packed after par_pack_ext_open()
+#define _PAR_EXT_OPEN_SIZE  ( PAR_TYPE_SIZE + 1 + 8 + 1 )
+
+static inline int par_pack_ext( par_pack_t *p, uint8_t id, const void *val,
+                                size_t len )
+{
+    size_t width = (size_t)1 << par_uint_wclass( len );
+    char *ptr = (char*)val;
+    uint8_t *mem = NULL;
+
+    if( p->reducer ){
+        _PAR_PACK_TYPE_EX( p, PAR_ISA_EXT, 2 + width, &mem );
+    }
+    else {
+        _PAR_PACK_TYPE_EX( p, PAR_ISA_EXT, 2 + width + len, &mem );
+    }
+    mem[0] = (uint8_t)width;
+    par_store_bewidth( mem + 1, len, width );
+    mem[1 + width] = id;
+
+    if( p->reducer ){
+        _PAR_SPACK_BYTEA( p, ptr, len );
+    }
+    else {
+        memcpy( mem + 2 + width, ptr, len );
+    }
+
+    return PARCEL_OK;
+}
+
+
+// append the header of the payload that packed after this function, and
+// set the head of the header to start. the header and the payload are held
+// until par_pack_ext_close() because they are moved.
+// NOTE: the packer with reducer is not supported.
+static inline int par_pack_ext_open( par_pack_t *p, uint8_t id, size_t *start )
+{
+    uint8_t *mem = NULL;
+
+    if( p->reducer ){
+        errno = PARCEL_ENOTSUP;
+        return -1;
+    }
+    *start = p->cur;
+    if( p->held == SIZE_MAX ){
+        p->held = *start;
+    }
+    _PAR_PACK_TYPE_EX( p, PAR_ISA_EXT, _PAR_EXT_OPEN_SIZE - PAR_TYPE_SIZE,
+                       &mem );
+    mem[0] = 8;
+    mem[9] = id;
+
+    return PARCEL_OK;
+}
+
+
+// discard the header and the payload appended after par_pack_ext_open()
+static inline void par_pack_ext_cancel( par_pack_t *p, size_t start )
+{
+    p->cur = start;
+    if( p->held == start ){
+        p->held = SIZE_MAX;
+    }
+}
+
+
+// complete the header with the length of the payload, and move the payload
+// to the narrowest header.
+static inline int par_pack_ext_close( par_pack_t *p, size_t start )
+{
+    uint8_t *mem = (uint8_t*)p->mem + start;
+    size_t len = p->cur - start - _PAR_EXT_OPEN_SIZE;
+    size_t width = (size_t)1 << par_uint_wclass( len );
+    uint8_t id = mem[_PAR_EXT_OPEN_SIZE - 1];
+
+    if( width < 8 ){
+        memmove( mem + _PAR_EXT_OPEN_SIZE - 8 + width,
+                 mem + _PAR_EXT_OPEN_SIZE, len );
+        p->cur -= 8 - width;
+    }
+    mem[1] = (uint8_t)width;
+    par_store_bewidth( mem + 2, len, width );
+    mem[2 + width] = id;
+    // the outermost value is settled
+    if( p->held == start ){
+        p->held = SIZE_MAX;
+    }
+
+    return PARCEL_OK;
+}
+
+#undef _PAR_EXT_OPEN_SIZE
+
+
+// MARK: encoded values
+// append the bytes of encoded values as they are.
+// NOTE: the packer with reducer is not supported.
+static inline int par_pack_encoded( par_pack_t *p, const void *val,
+                                    size_t len )
+{
+    if( !p->allocf( p, len ) ){
+        return -1;
+    }
+    memcpy( p->mem + p->cur, val, len );
+    p->cur += len;
+
+    return PARCEL_OK;
+}
+
+
+// MARK: encoded size
+//
+// par_sizeof_* returns the exact number of bytes of the value that is encoded
+// by the corresponding par_pack_* function.
+// the size of array, map and set is the size of its header.
+//
+
+// type with width class payload
+#define _PAR_SIZEOF_NBIT( wclass )  ( PAR_TYPE_SIZE + ( 1 << (wclass) ) )
+
+// nil, boolean, zero, NaN, infinity, stream containers and eos
+static inline size_t par_sizeof_type( void )
+{
+    return PAR_TYPE_SIZE;
+}
+
+static inline size_t par_sizeof_float32( void )
+{
+    return PAR_TYPE32_SIZE;
+}
+
+static inline size_t par_sizeof_float64( void )
+{
+    return PAR_TYPE64_SIZE;
+}
+
+static inline size_t par_sizeof_uint( uint_fast64_t num )
+{
+    if( num <= PAR_INT6_MAX ){
+        return PAR_TYPE_SIZE;
+    }
+
+    return _PAR_SIZEOF_NBIT( par_uint_wclass( num ) );
+}
+
+static inline size_t par_sizeof_int( int_fast64_t num )
+{
+    // PAR_INT6_MIN - PAR_INT6_MAX
+    if( (uint_fast64_t)num + PAR_INT6_MAX <= PAR_INT6_MAX * 2 ){
+        return PAR_TYPE_SIZE;
+    }
+
+    return _PAR_SIZEOF_NBIT( par_int_wclass( num ) );
+}
+
+static inline size_t par_sizeof_idx( uint_fast64_t idx )
+{
+    return PAR_TYPE_SIZE + par_sizeof_uint( idx );
+}
+
+static inline size_t par_sizeof_ref( size_t idx )
+{
+    return _PAR_SIZEOF_NBIT( par_uint_wclass( idx ) );
+}
+
+static inline size_t par_sizeof_array( size_t len )
+{
+    if( len <= 0xF ){
+        return PAR_TYPE_SIZE;
+    }
+
+    return _PAR_SIZEOF_NBIT( par_uint_wclass( len ) );
+}
+
+static inline size_t par_sizeof_map( size_t len )
+{
+    return par_sizeof_array( len );
+}
+
+static inline size_t par_sizeof_hyb( size_t narr, size_t nmap )
+{
+    size_t width = (size_t)1 << par_uint_wclass( ( narr > nmap ) ? narr : nmap );
+
+    return PAR_TYPE_SIZE + 1 + width * 2;
+}
+
+static inline size_t par_sizeof_raw( size_t len )
+{
+    return _PAR_SIZEOF_NBIT( par_uint_wclass( len ) ) + len;
+}
+
+static inline size_t par_sizeof_str( size_t len )
+{
+    // 5 bit length string
+    if( len <= 0x1F ){
+        return PAR_TYPE_SIZE + len;
+    }
+
+    return par_sizeof_raw( len );
+}
+
+#undef _PAR_SIZEOF_NBIT
+
+
+// MARK: undef _PAR_SPACK_BYTEA
+#undef _PAR_SPACK_BYTEA
+// MARK: undef _PAR_PACK_BYTEA
+#undef _PAR_PACK_BYTEA
+// MARK: undef _PAR_PACK_TYPE_WITH_LEN
+#undef _PAR_PACK_TYPE_WITH_LEN
+// MARK: undef _PAR_PACK_TYPE_WITH_LEN_EX
+#undef _PAR_PACK_TYPE_WITH_LEN_EX
+// MARK: undef _PAR_PACK_NBIT_VAL_EX
+#undef _PAR_PACK_NBIT_VAL_EX
+// MARK: undef _PAR_PACK_SLICE
+#undef _PAR_PACK_SLICE
+// MARK: undef _PAR_PACK_TYPE
+#undef _PAR_PACK_TYPE
+// MARK: undef _PAR_PACK_TYPE_EX
+#undef _PAR_PACK_TYPE_EX
 
 
 
 // MARK: unpacking
+// progress of the verification of the value that straddles the end of the
+// memory block. the verification is resumed from the containers that have
+// been walked when the following bytes of the value are appended.
+#ifndef PAR_VERIFY_NFRAME
+#define PAR_VERIFY_NFRAME   32
+#endif
+
+typedef struct {
+    // offset of the container
+    size_t off;
+    // offset of the next element, the number of elements and references
+    // that have been verified before it
+    size_t cur;
+    size_t nelt;
+    size_t nref;
+} par_verify_frame_t;
+
+typedef struct {
+    // bytes of the memory block required to continue the verification
+    size_t need;
+    // frames of the nested containers
+    size_t nframe;
+    par_verify_frame_t frame[PAR_VERIFY_NFRAME];
+} par_verify_t;
+
+
+static inline void par_verify_init( par_verify_t *v )
+{
+    v->need = 0;
+    v->nframe = 0;
+}
+
+
 // bin data
 typedef struct {
     uint_fast8_t endian;
     size_t cur;
     size_t blksize;
     void *mem;
+    // statistics
+    par_stats_t *stats;
+    // 1: data has been verified, values are extracted without space check
+    uint_fast8_t verified;
+    // user data of the caller
+    void *udata;
+    // depth of the nested containers that being unpacked by the caller
+    size_t depth;
+    // verification: bitmap of the offsets of the values that can be
+    // referenced, and the number of references
+    uint8_t *refmap;
+    size_t nref;
+    // bytes of the memory block required by the value that is not enough
+    // space. it is set with PARCEL_ENOBLKS or PARCEL_ENODATA, and may be
+    // less than the bytes of the whole value.
+    size_t need;
+    // progress of the verification to be resumed
+    par_verify_t *progress;
 } par_unpack_t;
 
 
+// not enough block space. need is set to the bytes of the memory block
+// required by the value.
+#define _PAR_ENOBLKS( p, req ) do { \
+    (p)->need = (p)->cur + (req); \
+    errno = PARCEL_ENOBLKS; \
+}while(0)
+
 // check available block space
-#define _PAR_CHECK_BLKSPC( blksize, cur, req ) do { \
-    if( (cur) >= (blksize) || ( (blksize) - (cur) ) < (req) ){ \
-        errno = PARCEL_ENOBLKS; \
+#define _PAR_CHECK_BLKSPC( p, req ) do { \
+    if( (p)->cur >= (p)->blksize || \
+        ( (p)->blksize - (p)->cur ) < (size_t)(req) ){ \
+        _PAR_ENOBLKS( p, req ); \
         return -1; \
     } \
 }while(0)
@@ -1101,242 +2527,822 @@ static inline void par_unpack_init( par_unpack_t *p, void *mem, size_t blksize )
     p->cur = 0;
     p->mem = mem;
     p->blksize = blksize;
+    p->stats = NULL;
+    p->verified = 0;
+    p->udata = NULL;
+    p->depth = 0;
+    p->refmap = NULL;
+    p->nref = 0;
+    p->need = 0;
+    p->progress = NULL;
 }
 
 
-#define _PAR_UNPACK_NBIT_FLT( p, type, ext, bit ) do { \
-    _PAR_CHECK_BLKSPC( (p)->blksize, (p)->cur, PAR_TYPE##bit##_SIZE ); \
-    (ext)->val.f##bit = *(par_float##bit##_t*)( (type) + PAR_TYPE_SIZE ); \
-    (p)->cur += PAR_TYPE##bit##_SIZE; \
-    if( (p)->endian ){ \
-        _PAR_BSWAP##bit( (ext)->val.u##bit ); \
-    } \
-}while(0)
-
+// attach statistics
+static inline void par_unpack_stats( par_unpack_t *p, par_stats_t *stats )
+{
+    p->stats = stats;
+}
 
-#define _PAR_UNPACK_NBIT_INT( p, type, ext, bit ) do { \
-    _PAR_CHECK_BLKSPC( (p)->blksize, (p)->cur, PAR_TYPE##bit##_SIZE ); \
-    (ext)->val.u##bit = *(uint_fast##bit##_t*)( (type) + PAR_TYPE_SIZE ); \
-    (p)->cur += PAR_TYPE##bit##_SIZE; \
-    if( (bit) > 8 && (p)->endian ){ \
-        _PAR_BSWAP##bit( (ext)->val.u##bit ); \
-    } \
-    (ext)->size.len = (ext)->val.u##bit; \
-}while(0)
 
+// MARK: map key
+//
+// a key of map or an index of array that can be compared and hashed without
+// the encoding. integers are compared as int64_t, and the integer and the
+// float are compared by their values, so the same number in the different
+// width is the same key.
+//
+enum {
+    PAR_KEY_BOOL = 0,
+    PAR_KEY_NUM,
+    PAR_KEY_STR
+};
 
-#define _PAR_UNPACK_NBIT_LEN( p, type, ext, bit ) \
-    _PAR_UNPACK_NBIT_INT( p, type, ext, bit )
+typedef struct {
+    int type;
+    // string key
+    const void *str;
+    size_t len;
+    // number key, or 0/1 for boolean key
+    double num;
+    // integer key. num is also set to the nearest double
+    int isint;
+    int64_t i64;
+} par_key_t;
+
+
+static inline void par_key_int( par_key_t *key, int64_t v )
+{
+    key->type = PAR_KEY_NUM;
+    key->str = NULL;
+    key->len = 0;
+    key->num = (double)v;
+    key->isint = 1;
+    key->i64 = v;
+}
 
 
-// type: PAR_ISA_RAW, PAR_ISA_STR
-// len: *(uint_fast[8-64]_t*)(mem + cur + PAR_TYPE_SIZE)
-// val: mem + cur + PAR_TYPE[8-64]_SIZE
-#define _PAR_UNPACK_NBIT_BYTEA( p, type, ext, bit ) do { \
-    _PAR_UNPACK_NBIT_LEN( p, type, ext, bit ); \
-    _PAR_CHECK_BLKSPC( (p)->blksize, (p)->cur, (ext)->size.len ); \
-    (ext)->val.bytea = (p)->mem + (p)->cur; \
-    (p)->cur += (ext)->size.len; \
-}while(0)
+static inline void par_key_num( par_key_t *key, double v )
+{
+    key->type = PAR_KEY_NUM;
+    key->str = NULL;
+    key->len = 0;
+    key->num = v;
+    key->isint = 0;
+    key->i64 = 0;
+}
 
 
-static inline int par_unpack( par_unpack_t *p, par_extract_t *ext )
+// key of the extracted value. returns -1 if the type cannot be a key.
+static inline int par_key_ext( par_key_t *key, const par_extract_t *ext )
 {
-    if( p->cur < p->blksize )
-    {
-        par_type_t *type = (par_type_t*)p->mem + p->cur;
-
-        // init
-        ext->isa = type->isa;
-        ext->size.len = 0;
-        // 6 bit integer
-        if( ext->isa <= PAR_ISA_S6N_TAIL )
-        {
-            // small negative integer
-            if( ext->isa & PAR_ISA_S6N ){
-                ext->isa = PAR_ISA_S6N;
-                ext->val.i8 = -((int_fast8_t)(type->isa & ~PAR_ISA_S6N));
+    key->isint = 0;
+    key->i64 = 0;
+    switch( ext->isa ){
+        case PAR_ISA_STR5:
+        case PAR_ISA_STR8 ... PAR_ISA_STR64:
+            key->type = PAR_KEY_STR;
+            key->str = ext->val.bytea;
+            key->len = ext->size.len;
+            key->num = 0;
+            return 0;
+
+        case PAR_ISA_TRUE:
+        case PAR_ISA_FALSE:
+            key->type = PAR_KEY_BOOL;
+            key->str = NULL;
+            key->len = 0;
+            key->num = ( ext->isa == PAR_ISA_TRUE );
+            return 0;
+
+        case PAR_ISA_S6:
+        case PAR_ISA_S6N:
+        case PAR_ISA_S8:
+            par_key_int( key, ext->val.i8 );
+            return 0;
+        case PAR_ISA_S16:
+            par_key_int( key, ext->val.i16 );
+            return 0;
+        case PAR_ISA_S32:
+            par_key_int( key, ext->val.i32 );
+            return 0;
+        case PAR_ISA_S64:
+            par_key_int( key, ext->val.i64 );
+            return 0;
+        case PAR_ISA_U8:
+            par_key_int( key, ext->val.u8 );
+            return 0;
+        case PAR_ISA_U16:
+            par_key_int( key, ext->val.u16 );
+            return 0;
+        case PAR_ISA_U32:
+            par_key_int( key, ext->val.u32 );
+            return 0;
+        case PAR_ISA_U64:
+            if( ext->val.u64 > INT64_MAX ){
+                par_key_num( key, (double)ext->val.u64 );
             }
-            // small positive integer
             else {
-                ext->isa = PAR_ISA_S6;
-                ext->val.i8 = (int_fast8_t)type->isa;
+                par_key_int( key, (int64_t)ext->val.u64 );
             }
-            p->cur += PAR_TYPE_SIZE;
-            return PARCEL_OK;
-        }
-        // others
-        switch( ext->isa )
-        {
-            // 1 byte types
-            case PAR_ISA_NIL:
-            case PAR_ISA_TRUE:
-            case PAR_ISA_FALSE:
-            case PAR_ISA_PINF:
-            case PAR_ISA_NINF:
-            case PAR_ISA_NAN:
-            case PAR_ISA_SARR:
-            case PAR_ISA_SMAP:
-            case PAR_ISA_SSET:
-            case PAR_ISA_IDX:
-            case PAR_ISA_EOS:
-                p->cur += PAR_TYPE_SIZE;
-            break;
+            return 0;
+        case PAR_ISA_F32:
+            par_key_num( key, (double)ext->val.f32 );
+            return 0;
+        case PAR_ISA_F64:
+            par_key_num( key, (double)ext->val.f64 );
+            return 0;
+    }
 
-            // 8 bit
-            case PAR_ISA_U8:
-            case PAR_ISA_S8:
-                _PAR_UNPACK_NBIT_INT( p, type, ext, 8 );
-            break;
+    errno = PARCEL_EILSEQ;
+    return -1;
+}
 
-            case PAR_ISA_ARR8:
-            case PAR_ISA_MAP8:
-            case PAR_ISA_REF8:
-            case PAR_ISA_SET8:
-                _PAR_UNPACK_NBIT_LEN( p, type, ext, 8 );
-            break;
 
-            case PAR_ISA_RAW8:
-            case PAR_ISA_STR8:
-                _PAR_UNPACK_NBIT_BYTEA( p, type, ext, 8 );
-            break;
+// compare the integer and the float exactly. the float is not nan.
+static inline int _par_key_cmp_int( int64_t i, double d )
+{
+    int64_t t = 0;
 
-            // 16 bit
-            case PAR_ISA_U16:
-            case PAR_ISA_S16:
-                _PAR_UNPACK_NBIT_INT( p, type, ext, 16 );
-            break;
+    if( d < -9223372036854775808.0 ){
+        return 1;
+    }
+    else if( d >= 9223372036854775808.0 ){
+        return -1;
+    }
+    // compare with the integral part, and then the fractional part
+    t = (int64_t)d;
+    if( i != t ){
+        return ( i > t ) - ( i < t );
+    }
 
-            case PAR_ISA_ARR16:
-            case PAR_ISA_MAP16:
-            case PAR_ISA_REF16:
-            case PAR_ISA_SET16:
-                _PAR_UNPACK_NBIT_LEN( p, type, ext, 16 );
-            break;
+    return ( (double)t > d ) - ( (double)t < d );
+}
 
-            case PAR_ISA_RAW16:
-            case PAR_ISA_STR16:
-                _PAR_UNPACK_NBIT_BYTEA( p, type, ext, 16 );
-            break;
 
-            // 32 bit
-            case PAR_ISA_U32:
-            case PAR_ISA_S32:
-                _PAR_UNPACK_NBIT_INT( p, type, ext, 32 );
-            break;
+// booleans, numbers and then strings by length and bytes
+static inline int par_key_cmp( const par_key_t *x, const par_key_t *y )
+{
+    if( x->type != y->type ){
+        return ( x->type > y->type ) - ( x->type < y->type );
+    }
+    else if( x->type != PAR_KEY_STR )
+    {
+        if( x->isint && y->isint ){
+            return ( x->i64 > y->i64 ) - ( x->i64 < y->i64 );
+        }
+        else if( x->isint ){
+            return _par_key_cmp_int( x->i64, y->num );
+        }
+        else if( y->isint ){
+            return -_par_key_cmp_int( y->i64, x->num );
+        }
+        return ( x->num > y->num ) - ( x->num < y->num );
+    }
+    else if( x->len != y->len ){
+        return ( x->len > y->len ) - ( x->len < y->len );
+    }
 
-            case PAR_ISA_F32:
-                _PAR_UNPACK_NBIT_FLT( p, type, ext, 32 );
-            break;
+    return memcmp( x->str, y->str, x->len );
+}
 
-            case PAR_ISA_ARR32:
-            case PAR_ISA_MAP32:
-            case PAR_ISA_REF32:
-            case PAR_ISA_SET32:
-                _PAR_UNPACK_NBIT_LEN( p, type, ext, 32 );
-            break;
 
-            case PAR_ISA_RAW32:
-            case PAR_ISA_STR32:
-                _PAR_UNPACK_NBIT_BYTEA( p, type, ext, 32 );
-            break;
+// hash of the key in the offset table of indexed map.
+// XXH64 of the bytes of string, or the big-endian double of number.
+static inline uint32_t par_key_hash( const par_key_t *key )
+{
+    uint8_t buf[8];
+    uint64_t v = 0;
 
-            // 64 bit
-            case PAR_ISA_U64:
-            case PAR_ISA_S64:
-                _PAR_UNPACK_NBIT_INT( p, type, ext, 64 );
-            break;
+    switch( key->type ){
+        case PAR_KEY_STR:
+            return (uint32_t)par_xxh64( key->str, key->len, PAR_KEY_STR );
 
-            case PAR_ISA_F64:
-                _PAR_UNPACK_NBIT_FLT( p, type, ext, 64 );
-            break;
+        default:
+            // -0.0 is the same key as 0
+            if( key->num == 0 ){
+                v = 0;
+            }
+            else {
+                memcpy( &v, &key->num, sizeof( v ) );
+            }
+            par_store_be64( buf, v );
+            return (uint32_t)par_xxh64( buf, sizeof( buf ), key->type );
+    }
+}
 
-            case PAR_ISA_ARR64:
-            case PAR_ISA_MAP64:
-            case PAR_ISA_REF64:
-            case PAR_ISA_SET64:
-                _PAR_UNPACK_NBIT_LEN( p, type, ext, 64 );
-            break;
 
-            case PAR_ISA_RAW64:
-            case PAR_ISA_STR64:
-                _PAR_UNPACK_NBIT_BYTEA( p, type, ext, 64 );
-            break;
+// MARK: offset table of indexed array/map
 
-            // 5 bit length string
-            case PAR_ISA_STR5 ... PAR_ISA_STR5_TAIL:
-                ext->isa &= ~(0x1F);
-                ext->size.len = type->isa & 0x1F;
-                ext->val.bytea = p->mem + p->cur + PAR_TYPE_SIZE;
-                p->cur += PAR_TYPE_SIZE + ext->size.len;
-            break;
+typedef struct {
+    // width of len, size and offset
+    size_t width;
+    // bytes of table entry
+    size_t esize;
+    size_t len;
+    // bytes of elements
+    size_t size;
+    const uint8_t *tbl;
+} par_index_t;
+
+
+// offset table of the indexed array/map extracted by ext
+static inline void par_index_init( par_index_t *idx, const par_extract_t *ext )
+{
+    const uint8_t *hdr = (const uint8_t*)ext->val.bytea;
 
-            // 4 bit length array/map
-            case PAR_ISA_ARR4 ... PAR_ISA_MAP4_TAIL:
-                ext->isa &= ~(0xF);
-                ext->size.len = type->isa & 0xF;
-                p->cur += PAR_TYPE_SIZE;
-            break;
+    idx->width = hdr[0];
+    idx->esize = idx->width + ( ( ext->isa == PAR_ISA_IMAP ) ? 4 : 0 );
+    idx->len = ext->size.len;
+    idx->size = par_load_bewidth( hdr + 1 + idx->width, idx->width );
+    idx->tbl = hdr + 1 + idx->width * 2;
+}
 
-            // illegal byte sequence
-            default:
-                errno = PARCEL_EILSEQ;
-                return -1;
-        }
 
-        return PARCEL_OK;
-    }
+// offset of the i-th entry
+static inline size_t par_index_off( const par_index_t *idx, size_t i )
+{
+    const uint8_t *ent = idx->tbl + idx->esize * i;
 
-    // end-of-data
-    // no message available on memory block
-    errno = PARCEL_ENODATA;
-    return -2;
+    return par_load_bewidth( ent + idx->esize - idx->width, idx->width );
 }
 
 
-// unpack an index value of non-consecutive array
-static inline int par_unpack_idx( par_unpack_t *p, par_extract_t *ext )
+// hash of the i-th entry of map
+static inline uint32_t par_index_hash( const par_index_t *idx, size_t i )
 {
-    int rc = par_unpack( p, ext );
+    return par_load_be32( idx->tbl + idx->esize * i );
+}
 
-    if( rc == 0 )
+
+// first entry of map whose hash is greater than or equal to hash
+static inline size_t par_index_lower( const par_index_t *idx, uint32_t hash )
+{
+    size_t lo = 0;
+    size_t hi = idx->len;
+
+    while( lo < hi )
     {
-        // index value must be unsigned integer
-        switch( ext->isa ){
-            case PAR_ISA_S6:
-            case PAR_ISA_U8 ... PAR_ISA_U64:
-                return PARCEL_OK;
+        size_t mid = lo + ( hi - lo ) / 2;
+
+        if( par_index_hash( idx, mid ) < hash ){
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
         }
-        // illegal byte sequence
-        errno = PARCEL_EILSEQ;
-        return -1;
     }
 
-    return rc;
+    return lo;
 }
 
 
-// unpack a key value of map
-static inline int par_unpack_key( par_unpack_t *p, par_extract_t *ext,
-                                  int allow_eos )
-{
-    int rc = par_unpack( p, ext );
+// check payload space of raw/string after the type and length
+// NOTE: cur never exceeds blksize at this point.
+#define _PAR_CHECK_BYTEA( p, len ) do { \
+    if( ( (p)->blksize - (p)->cur ) < (len) ){ \
+        _PAR_ENOBLKS( p, len ); \
+        return -1; \
+    } \
+}while(0)
 
-    if( rc == 0 )
-    {
-        // check value type
-        switch( ext->isa ){
-            case PAR_ISA_STR5:
-            case PAR_ISA_STR8 ... PAR_ISA_STR64:
-            case PAR_ISA_S6:
-            case PAR_ISA_S6N:
-            case PAR_ISA_U8 ... PAR_ISA_S64:
-            case PAR_ISA_F16 ... PAR_ISA_F64:
-            case PAR_ISA_TRUE:
-            case PAR_ISA_FALSE:
-                return PARCEL_OK;
 
-            case PAR_ISA_EOS:
+// no space check for verified data
+#define _PAR_NOCHECK_BLKSPC( p, req )
+#define _PAR_NOCHECK_BYTEA( p, len )
+
+
+// MARK: type descriptor
+//
+// every type byte is mapped to a descriptor that holds the canonical type,
+// the decoding operation and the width of the payload that follows the type
+// byte. the operation also tells where the length comes from;
+//   PAR_OP_LEN*, PAR_OP_BYTEA*: the payload
+//   PAR_OP_STR5, PAR_OP_LEN4  : the low bits of the type byte
+//   others                    : no length
+//
+enum {
+    PAR_OP_ILSEQ = 0,   // illegal byte sequence
+    PAR_OP_TYPE,        // 1 byte type
+    PAR_OP_S6,          // 6 bit positive integer
+    PAR_OP_S6N,         // 6 bit negative integer
+    PAR_OP_U8,
+    PAR_OP_U16,
+    PAR_OP_U32,
+    PAR_OP_U64,
+    PAR_OP_S8,
+    PAR_OP_S16,
+    PAR_OP_S32,
+    PAR_OP_S64,
+    PAR_OP_F32,
+    PAR_OP_F64,
+    PAR_OP_LEN8,        // array, map, set and reference
+    PAR_OP_LEN16,
+    PAR_OP_LEN32,
+    PAR_OP_LEN64,
+    PAR_OP_BYTEA8,      // raw and string
+    PAR_OP_BYTEA16,
+    PAR_OP_BYTEA32,
+    PAR_OP_BYTEA64,
+    PAR_OP_STR5,        // 5 bit length string
+    PAR_OP_LEN4,        // 4 bit length array and map
+    PAR_OP_INDEX,       // indexed array and map
+    PAR_OP_REC,         // record
+    PAR_OP_COL,         // columnar array
+    PAR_OP_EXT,         // extension
+    PAR_OP_HYB          // hybrid array/map
+};
+
+typedef struct {
+    uint8_t isa;
+    uint8_t op;
+    uint8_t width;
+} par_isa_desc_t;
+
+#define _PAR_DESC_NBIT( isa, op ) \
+    [isa##8]  = { isa##8, op##8, 1 }, \
+    [isa##16] = { isa##16, op##16, 2 }, \
+    [isa##32] = { isa##32, op##32, 4 }, \
+    [isa##64] = { isa##64, op##64, 8 }
+
+#define _PAR_DESC_TYPE( isa ) \
+    [isa] = { isa, PAR_OP_TYPE, 0 }
+
+static const par_isa_desc_t PAR_ISA_DESC[256] = {
+    [PAR_ISA_S6 ... PAR_ISA_S6_TAIL] = { PAR_ISA_S6, PAR_OP_S6, 0 },
+    [PAR_ISA_S6N ... PAR_ISA_S6N_TAIL] = { PAR_ISA_S6N, PAR_OP_S6N, 0 },
+    _PAR_DESC_NBIT( PAR_ISA_U, PAR_OP_U ),
+    _PAR_DESC_NBIT( PAR_ISA_S, PAR_OP_S ),
+    _PAR_DESC_NBIT( PAR_ISA_RAW, PAR_OP_BYTEA ),
+    _PAR_DESC_NBIT( PAR_ISA_STR, PAR_OP_BYTEA ),
+    _PAR_DESC_NBIT( PAR_ISA_REF, PAR_OP_LEN ),
+    _PAR_DESC_NBIT( PAR_ISA_ARR, PAR_OP_LEN ),
+    _PAR_DESC_NBIT( PAR_ISA_MAP, PAR_OP_LEN ),
+    _PAR_DESC_NBIT( PAR_ISA_SET, PAR_OP_LEN ),
+    _PAR_DESC_TYPE( PAR_ISA_NAN ),
+    [PAR_ISA_F32] = { PAR_ISA_F32, PAR_OP_F32, 4 },
+    [PAR_ISA_F64] = { PAR_ISA_F64, PAR_OP_F64, 8 },
+    _PAR_DESC_TYPE( PAR_ISA_NINF ),
+    _PAR_DESC_TYPE( PAR_ISA_PINF ),
+    _PAR_DESC_TYPE( PAR_ISA_TRUE ),
+    _PAR_DESC_TYPE( PAR_ISA_FALSE ),
+    _PAR_DESC_TYPE( PAR_ISA_NIL ),
+    _PAR_DESC_TYPE( PAR_ISA_IDX ),
+    _PAR_DESC_TYPE( PAR_ISA_EOS ),
+    _PAR_DESC_TYPE( PAR_ISA_SARR ),
+    _PAR_DESC_TYPE( PAR_ISA_SMAP ),
+    _PAR_DESC_TYPE( PAR_ISA_SSET ),
+    [PAR_ISA_IARR] = { PAR_ISA_IARR, PAR_OP_INDEX, 1 },
+    [PAR_ISA_IMAP] = { PAR_ISA_IMAP, PAR_OP_INDEX, 1 },
+    [PAR_ISA_REC] = { PAR_ISA_REC, PAR_OP_REC, 5 },
+    [PAR_ISA_COL] = { PAR_ISA_COL, PAR_OP_COL, 1 },
+    [PAR_ISA_EXT] = { PAR_ISA_EXT, PAR_OP_EXT, 1 },
+    [PAR_ISA_HYB] = { PAR_ISA_HYB, PAR_OP_HYB, 1 },
+    [PAR_ISA_STR5 ... PAR_ISA_STR5_TAIL] = { PAR_ISA_STR5, PAR_OP_STR5, 0 },
+    [PAR_ISA_ARR4 ... PAR_ISA_ARR4_TAIL] = { PAR_ISA_ARR4, PAR_OP_LEN4, 0 },
+    [PAR_ISA_MAP4 ... PAR_ISA_MAP4_TAIL] = { PAR_ISA_MAP4, PAR_OP_LEN4, 0 }
+};
+
+#undef _PAR_DESC_TYPE
+#undef _PAR_DESC_NBIT
+
+
+// dispatch the decoding operation.
+// by default, the switch statement over the type byte compiles into a single
+// jump table and keeps the descriptor load out of the branch target.
+// define PARCEL_COMPUTED_GOTO to dispatch the operation of the descriptor by
+// computed goto instead.
+// NOTE: gcc never inlines the functions that contain a computed goto, that
+//       makes the decoder loops of the callers slower.
+#if defined(__GNUC__) && defined(PARCEL_COMPUTED_GOTO)
+
+#define _PAR_OP_DISPATCH( type, desc ) \
+    static const void *const _par_op_tbl[] = { \
+        &&PAR_OP_ILSEQ_L, &&PAR_OP_TYPE_L, &&PAR_OP_S6_L, &&PAR_OP_S6N_L, \
+        &&PAR_OP_U8_L, &&PAR_OP_U16_L, &&PAR_OP_U32_L, &&PAR_OP_U64_L, \
+        &&PAR_OP_S8_L, &&PAR_OP_S16_L, &&PAR_OP_S32_L, &&PAR_OP_S64_L, \
+        &&PAR_OP_F32_L, &&PAR_OP_F64_L, \
+        &&PAR_OP_LEN8_L, &&PAR_OP_LEN16_L, &&PAR_OP_LEN32_L, &&PAR_OP_LEN64_L, \
+        &&PAR_OP_BYTEA8_L, &&PAR_OP_BYTEA16_L, &&PAR_OP_BYTEA32_L, \
+        &&PAR_OP_BYTEA64_L, &&PAR_OP_STR5_L, &&PAR_OP_LEN4_L, \
+        &&PAR_OP_INDEX_L, &&PAR_OP_REC_L, &&PAR_OP_COL_L, &&PAR_OP_EXT_L, \
+        &&PAR_OP_HYB_L \
+    }; \
+    goto *_par_op_tbl[(desc).op];
+
+#define _PAR_OP_CASE( op, ... )     op##_L:
+
+#else
+
+#define _PAR_OP_DISPATCH( type, desc )  switch( type )
+#define _PAR_OP_CASE( op, ... )         __VA_ARGS__:
+
+#endif
+
+
+// payload of n bit value
+#define _PAR_UNPACK_NBIT_INT( ext, m, t, bit, payload ) do { \
+    (ext)->val.m##bit = (t##bit##_t)par_load_be##bit( payload ); \
+    return PARCEL_OK; \
+}while(0)
+
+#define _PAR_UNPACK_NBIT_FLT( ext, bit, payload ) do { \
+    uint##bit##_t _v = par_load_be##bit( payload ); \
+    memcpy( &(ext)->val.f##bit, &_v, sizeof( _v ) ); \
+    return PARCEL_OK; \
+}while(0)
+
+#define _PAR_UNPACK_NBIT_LEN( ext, bit, payload ) do { \
+    (ext)->size.len = par_load_be##bit( payload ); \
+    return PARCEL_OK; \
+}while(0)
+
+// type: PAR_ISA_RAW, PAR_ISA_STR
+// len: payload
+// val: mem + cur + PAR_TYPE_SIZE + width
+#define _PAR_UNPACK_NBIT_BYTEA( p, ext, bit, payload, chk ) do { \
+    (ext)->size.len = par_load_be##bit( payload ); \
+    chk##_BYTEA( p, (ext)->size.len ); \
+    (ext)->val.bytea = (p)->mem + (p)->cur; \
+    (p)->cur += (ext)->size.len; \
+    return PARCEL_OK; \
+}while(0)
+
+
+// type: PAR_ISA_IARR, PAR_ISA_IMAP
+// len: number of elements
+// val: the width byte of the header
+// the cursor is moved to the head of elements.
+#define _PAR_CHECK_INDEX    1
+#define _PAR_NOCHECK_INDEX  0
+
+static inline int _par_unpack_index( par_unpack_t *p, par_extract_t *ext,
+                                     uint8_t *hdr, int check )
+{
+    size_t width = hdr[0];
+    size_t esize = width + ( ( ext->isa == PAR_ISA_IMAP ) ? 4 : 0 );
+    uint_fast64_t size = 0;
+
+    if( check )
+    {
+        switch( width ){
+            case 1:
+            case 2:
+            case 4:
+            case 8:
+            break;
+
+            default:
+                errno = PARCEL_EILSEQ;
+                return -1;
+        }
+        _PAR_CHECK_BLKSPC( p, width * 2 );
+    }
+    ext->size.len = par_load_bewidth( hdr + 1, width );
+    size = par_load_bewidth( hdr + 1 + width, width );
+    ext->val.bytea = hdr;
+    p->cur += width * 2;
+    if( check && ( ext->size.len > ( p->blksize - p->cur ) / esize ||
+                   size > p->blksize - p->cur - ext->size.len * esize ) ){
+        _PAR_ENOBLKS( p, ext->size.len * esize + size );
+        return -1;
+    }
+    p->cur += ext->size.len * esize;
+
+    return PARCEL_OK;
+}
+
+
+// type: PAR_ISA_COL
+// len: number of rows
+// val: the width byte of the header
+// the cursor is moved to the head of columns.
+#define _PAR_CHECK_COL      1
+#define _PAR_NOCHECK_COL    0
+
+static inline int _par_unpack_col( par_unpack_t *p, par_extract_t *ext,
+                                   uint8_t *hdr, int check )
+{
+    size_t width = hdr[0];
+    uint_fast64_t ncol = 0;
+    uint_fast64_t size = 0;
+
+    if( check )
+    {
+        switch( width ){
+            case 1:
+            case 2:
+            case 4:
+            case 8:
+            break;
+
+            default:
+                errno = PARCEL_EILSEQ;
+                return -1;
+        }
+        _PAR_CHECK_BLKSPC( p, width * 3 );
+    }
+    ext->size.len = par_load_bewidth( hdr + 1, width );
+    ncol = par_load_bewidth( hdr + 1 + width, width );
+    size = par_load_bewidth( hdr + 1 + width * 2, width );
+    ext->val.bytea = hdr;
+    p->cur += width * 3;
+    if( check )
+    {
+        if( size > p->blksize - p->cur ){
+            _PAR_ENOBLKS( p, size );
+            return -1;
+        }
+        // every column has the presence bitmap or the values of all rows,
+        // that takes one bit per row at least.
+        else if( ( !ncol && ext->size.len ) || ext->size.len / 8 > size ){
+            errno = PARCEL_EILSEQ;
+            return -1;
+        }
+    }
+
+    return PARCEL_OK;
+}
+
+
+// type: PAR_ISA_EXT
+// len: payload
+// val: mem + cur + PAR_TYPE_SIZE + 1 + width + 1
+#define _PAR_CHECK_EXT      1
+#define _PAR_NOCHECK_EXT    0
+
+static inline int _par_unpack_ext( par_unpack_t *p, par_extract_t *ext,
+                                   uint8_t *hdr, int check )
+{
+    size_t width = hdr[0];
+
+    if( check )
+    {
+        switch( width ){
+            case 1:
+            case 2:
+            case 4:
+            case 8:
+            break;
+
+            default:
+                errno = PARCEL_EILSEQ;
+                return -1;
+        }
+        _PAR_CHECK_BLKSPC( p, width + 1 );
+    }
+    ext->size.len = par_load_bewidth( hdr + 1, width );
+    p->cur += width + 1;
+    if( check ){
+        _PAR_CHECK_BYTEA( p, ext->size.len );
+    }
+    ext->val.bytea = (uint8_t*)p->mem + p->cur;
+    p->cur += ext->size.len;
+
+    return PARCEL_OK;
+}
+
+
+// type id of the extension extracted by ext
+static inline uint8_t par_ext_id( const par_extract_t *ext )
+{
+    return ((const uint8_t*)ext->val.bytea)[-1];
+}
+
+
+// type: PAR_ISA_HYB
+// len: number of values of the array section
+// val: the width byte of the header
+// the cursor is moved to the head of the array section.
+#define _PAR_CHECK_HYB      1
+#define _PAR_NOCHECK_HYB    0
+
+static inline int _par_unpack_hyb( par_unpack_t *p, par_extract_t *ext,
+                                   uint8_t *hdr, int check )
+{
+    size_t width = hdr[0];
+
+    if( check )
+    {
+        switch( width ){
+            case 1:
+            case 2:
+            case 4:
+            case 8:
+            break;
+
+            default:
+                errno = PARCEL_EILSEQ;
+                return -1;
+        }
+        _PAR_CHECK_BLKSPC( p, width * 2 );
+    }
+    ext->size.len = par_load_bewidth( hdr + 1, width );
+    ext->val.bytea = hdr;
+    p->cur += width * 2;
+
+    return PARCEL_OK;
+}
+
+
+// number of key/value pairs of the hybrid array/map extracted by ext
+static inline size_t par_hyb_nmap( const par_extract_t *ext )
+{
+    const uint8_t *hdr = (const uint8_t*)ext->val.bytea;
+
+    return par_load_bewidth( hdr + 1 + hdr[0], hdr[0] );
+}
+
+
+// extract a value at the cursor position.
+// chk: _PAR_CHECK or _PAR_NOCHECK
+#define _PAR_UNPACK_VAL( p, ext, chk ) do { \
+    uint8_t *payload = (uint8_t*)(p)->mem + (p)->cur + PAR_TYPE_SIZE; \
+    const uint8_t type = payload[-PAR_TYPE_SIZE]; \
+    const par_isa_desc_t desc = PAR_ISA_DESC[type]; \
+    /* init */ \
+    (ext)->isa = desc.isa; \
+    (ext)->size.len = 0; \
+    _PAR_STATS_ISA( (p)->stats, type ); \
+    /* type and fixed width payload */ \
+    chk##_BLKSPC( p, PAR_TYPE_SIZE + desc.width ); \
+    (p)->cur += PAR_TYPE_SIZE + desc.width; \
+    _PAR_OP_DISPATCH( type, desc ) \
+    { \
+        _PAR_OP_CASE( PAR_OP_TYPE, case PAR_ISA_NAN: case PAR_ISA_NINF ... PAR_ISA_SSET ) \
+            return PARCEL_OK; \
+        /* 6 bit integer */ \
+        _PAR_OP_CASE( PAR_OP_S6, case PAR_ISA_S6 ... PAR_ISA_S6_TAIL ) \
+            (ext)->val.i8 = (int_fast8_t)type; \
+            return PARCEL_OK; \
+        _PAR_OP_CASE( PAR_OP_S6N, case PAR_ISA_S6N ... PAR_ISA_S6N_TAIL ) \
+            (ext)->val.i8 = -(int_fast8_t)( type & ~PAR_ISA_S6N ); \
+            return PARCEL_OK; \
+        /* integer */ \
+        _PAR_OP_CASE( PAR_OP_U8, case PAR_ISA_U8 ) \
+            _PAR_UNPACK_NBIT_INT( ext, u, uint, 8, payload ); \
+        _PAR_OP_CASE( PAR_OP_U16, case PAR_ISA_U16 ) \
+            _PAR_UNPACK_NBIT_INT( ext, u, uint, 16, payload ); \
+        _PAR_OP_CASE( PAR_OP_U32, case PAR_ISA_U32 ) \
+            _PAR_UNPACK_NBIT_INT( ext, u, uint, 32, payload ); \
+        _PAR_OP_CASE( PAR_OP_U64, case PAR_ISA_U64 ) \
+            _PAR_UNPACK_NBIT_INT( ext, u, uint, 64, payload ); \
+        _PAR_OP_CASE( PAR_OP_S8, case PAR_ISA_S8 ) \
+            _PAR_UNPACK_NBIT_INT( ext, i, int, 8, payload ); \
+        _PAR_OP_CASE( PAR_OP_S16, case PAR_ISA_S16 ) \
+            _PAR_UNPACK_NBIT_INT( ext, i, int, 16, payload ); \
+        _PAR_OP_CASE( PAR_OP_S32, case PAR_ISA_S32 ) \
+            _PAR_UNPACK_NBIT_INT( ext, i, int, 32, payload ); \
+        _PAR_OP_CASE( PAR_OP_S64, case PAR_ISA_S64 ) \
+            _PAR_UNPACK_NBIT_INT( ext, i, int, 64, payload ); \
+        /* floating-point */ \
+        _PAR_OP_CASE( PAR_OP_F32, case PAR_ISA_F32 ) \
+            _PAR_UNPACK_NBIT_FLT( ext, 32, payload ); \
+        _PAR_OP_CASE( PAR_OP_F64, case PAR_ISA_F64 ) \
+            _PAR_UNPACK_NBIT_FLT( ext, 64, payload ); \
+        /* array, map, set, reference */ \
+        _PAR_OP_CASE( PAR_OP_LEN8, case PAR_ISA_ARR8: case PAR_ISA_MAP8: \
+                      case PAR_ISA_REF8: case PAR_ISA_SET8 ) \
+            _PAR_UNPACK_NBIT_LEN( ext, 8, payload ); \
+        _PAR_OP_CASE( PAR_OP_LEN16, case PAR_ISA_ARR16: case PAR_ISA_MAP16: \
+                      case PAR_ISA_REF16: case PAR_ISA_SET16 ) \
+            _PAR_UNPACK_NBIT_LEN( ext, 16, payload ); \
+        _PAR_OP_CASE( PAR_OP_LEN32, case PAR_ISA_ARR32: case PAR_ISA_MAP32: \
+                      case PAR_ISA_REF32: case PAR_ISA_SET32 ) \
+            _PAR_UNPACK_NBIT_LEN( ext, 32, payload ); \
+        _PAR_OP_CASE( PAR_OP_LEN64, case PAR_ISA_ARR64: case PAR_ISA_MAP64: \
+                      case PAR_ISA_REF64: case PAR_ISA_SET64 ) \
+            _PAR_UNPACK_NBIT_LEN( ext, 64, payload ); \
+        /* raw, string */ \
+        _PAR_OP_CASE( PAR_OP_BYTEA8, case PAR_ISA_RAW8: case PAR_ISA_STR8 ) \
+            _PAR_UNPACK_NBIT_BYTEA( p, ext, 8, payload, chk ); \
+        _PAR_OP_CASE( PAR_OP_BYTEA16, case PAR_ISA_RAW16: case PAR_ISA_STR16 ) \
+            _PAR_UNPACK_NBIT_BYTEA( p, ext, 16, payload, chk ); \
+        _PAR_OP_CASE( PAR_OP_BYTEA32, case PAR_ISA_RAW32: case PAR_ISA_STR32 ) \
+            _PAR_UNPACK_NBIT_BYTEA( p, ext, 32, payload, chk ); \
+        _PAR_OP_CASE( PAR_OP_BYTEA64, case PAR_ISA_RAW64: case PAR_ISA_STR64 ) \
+            _PAR_UNPACK_NBIT_BYTEA( p, ext, 64, payload, chk ); \
+        /* 5 bit length string */ \
+        _PAR_OP_CASE( PAR_OP_STR5, case PAR_ISA_STR5 ... PAR_ISA_STR5_TAIL ) \
+            (ext)->size.len = type & 0x1F; \
+            chk##_BYTEA( p, (ext)->size.len ); \
+            (ext)->val.bytea = payload; \
+            (p)->cur += (ext)->size.len; \
+            return PARCEL_OK; \
+        /* 4 bit length array/map */ \
+        _PAR_OP_CASE( PAR_OP_LEN4, case PAR_ISA_ARR4 ... PAR_ISA_MAP4_TAIL ) \
+            (ext)->size.len = type & 0xF; \
+            return PARCEL_OK; \
+        /* indexed array/map */ \
+        _PAR_OP_CASE( PAR_OP_INDEX, case PAR_ISA_IARR: case PAR_ISA_IMAP ) \
+            return _par_unpack_index( p, ext, payload, chk##_INDEX ); \
+        /* record */ \
+        _PAR_OP_CASE( PAR_OP_REC, case PAR_ISA_REC ) \
+            (ext)->size.len = payload[0]; \
+            (ext)->val.u32 = par_load_be32( payload + 1 ); \
+            return PARCEL_OK; \
+        /* columnar array */ \
+        _PAR_OP_CASE( PAR_OP_COL, case PAR_ISA_COL ) \
+            return _par_unpack_col( p, ext, payload, chk##_COL ); \
+        /* extension */ \
+        _PAR_OP_CASE( PAR_OP_EXT, case PAR_ISA_EXT ) \
+            return _par_unpack_ext( p, ext, payload, chk##_EXT ); \
+        /* hybrid array/map */ \
+        _PAR_OP_CASE( PAR_OP_HYB, case PAR_ISA_HYB ) \
+            return _par_unpack_hyb( p, ext, payload, chk##_HYB ); \
+        /* illegal byte sequence */ \
+        _PAR_OP_CASE( PAR_OP_ILSEQ, default ) \
+            (p)->cur -= PAR_TYPE_SIZE + desc.width; \
+            errno = PARCEL_EILSEQ; \
+            return -1; \
+    } \
+}while(0)
+
+
+// extract a value of the verified data without any space check.
+// NOTE: the data must be verified by par_verify() or come from a trusted
+//       source.
+static inline int par_unpack_unchecked( par_unpack_t *p, par_extract_t *ext )
+{
+    _PAR_UNPACK_VAL( p, ext, _PAR_NOCHECK );
+}
+
+
+static inline int par_unpack( par_unpack_t *p, par_extract_t *ext )
+{
+    if( p->verified ){
+        return par_unpack_unchecked( p, ext );
+    }
+    else if( p->cur < p->blksize ){
+        _PAR_UNPACK_VAL( p, ext, _PAR_CHECK );
+    }
+
+    // end-of-data
+    // no message available on memory block
+    p->need = p->cur + 1;
+    errno = PARCEL_ENODATA;
+    return -2;
+}
+
+
+// unpack an index value of non-consecutive array
+static inline int par_unpack_idx( par_unpack_t *p, par_extract_t *ext )
+{
+    int rc = 0;
+
+    // verified data
+    if( p->verified ){
+        return par_unpack_unchecked( p, ext );
+    }
+
+    rc = par_unpack( p, ext );
+
+    if( rc == 0 )
+    {
+        // index value must be unsigned integer
+        switch( ext->isa ){
+            case PAR_ISA_S6:
+            case PAR_ISA_U8 ... PAR_ISA_U64:
+                return PARCEL_OK;
+        }
+        // illegal byte sequence
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return rc;
+}
+
+
+// unpack a key value of map
+static inline int par_unpack_key( par_unpack_t *p, par_extract_t *ext,
+                                  int allow_eos )
+{
+    int rc = 0;
+
+    // verified data
+    if( p->verified ){
+        rc = par_unpack_unchecked( p, ext );
+        return ( ext->isa == PAR_ISA_EOS ) ? PAR_ISA_EOS : rc;
+    }
+
+    rc = par_unpack( p, ext );
+
+    if( rc == 0 )
+    {
+        // check value type
+        switch( ext->isa ){
+            case PAR_ISA_STR5:
+            case PAR_ISA_STR8 ... PAR_ISA_STR64:
+            case PAR_ISA_S6:
+            case PAR_ISA_S6N:
+            case PAR_ISA_U8 ... PAR_ISA_S64:
+            case PAR_ISA_F16 ... PAR_ISA_F64:
+            case PAR_ISA_TRUE:
+            case PAR_ISA_FALSE:
+                return PARCEL_OK;
+
+            case PAR_ISA_EOS:
                 if( allow_eos ){
                     return PAR_ISA_EOS;
                 }
@@ -1350,11 +3356,63 @@ static inline int par_unpack_key( par_unpack_t *p, par_extract_t *ext,
 }
 
 
+// move the cursor to the value of key in the indexed array/map extracted by
+// ext. the cursor must be at the head of elements.
+// returns 1 if not found.
+static inline int par_unpack_index_find( par_unpack_t *p, par_extract_t *ext,
+                                         const par_key_t *key )
+{
+    size_t base = p->cur;
+    par_index_t idx;
+    par_extract_t kext;
+    par_key_t k;
+    uint32_t hash = 0;
+    size_t i = 0;
+
+    par_index_init( &idx, ext );
+    // array index
+    if( ext->isa == PAR_ISA_IARR )
+    {
+        if( key->type != PAR_KEY_NUM || key->num < 1 ||
+            key->num > (double)idx.len || key->num != (size_t)key->num ){
+            return 1;
+        }
+        p->cur = base + par_index_off( &idx, (size_t)key->num - 1 );
+        return 0;
+    }
+
+    // entries of the same hash
+    hash = par_key_hash( key );
+    for( i = par_index_lower( &idx, hash );
+         i < idx.len && par_index_hash( &idx, i ) == hash; i++ )
+    {
+        p->cur = base + par_index_off( &idx, i );
+        if( par_unpack_key( p, &kext, 0 ) != 0 ){
+            return -1;
+        }
+        else if( par_key_ext( &k, &kext ) == 0 && par_key_cmp( &k, key ) == 0 ){
+            return 0;
+        }
+    }
+    p->cur = base;
+
+    return 1;
+}
+
+
 // unpack an element of set
 static inline int par_unpack_elm( par_unpack_t *p, par_extract_t *ext,
                                   int allow_eos )
 {
-    int rc = par_unpack( p, ext );
+    int rc = 0;
+
+    // verified data
+    if( p->verified ){
+        rc = par_unpack_unchecked( p, ext );
+        return ( ext->isa == PAR_ISA_EOS ) ? PAR_ISA_EOS : rc;
+    }
+
+    rc = par_unpack( p, ext );
 
     if( rc == 0 )
     {
@@ -1364,6 +3422,7 @@ static inline int par_unpack_elm( par_unpack_t *p, par_extract_t *ext,
                 if( allow_eos ){
                     return PAR_ISA_EOS;
                 }
+                // fallthrough
             case PAR_ISA_IDX:
             case PAR_ISA_REF8 ... PAR_ISA_REF64:
                 // illegal byte sequence
@@ -1378,13 +3437,732 @@ static inline int par_unpack_elm( par_unpack_t *p, par_extract_t *ext,
 }
 
 
+// MARK: columns of columnar array
+
+typedef struct {
+    size_t width;
+    size_t nrow;
+    size_t ncol;
+    // bytes of columns
+    size_t size;
+} par_col_t;
+
+
+// header of the columnar array extracted by ext
+static inline void par_col_init( par_col_t *col, const par_extract_t *ext )
+{
+    const uint8_t *hdr = (const uint8_t*)ext->val.bytea;
+
+    col->width = hdr[0];
+    col->nrow = ext->size.len;
+    col->ncol = par_load_bewidth( hdr + 1 + col->width, col->width );
+    col->size = par_load_bewidth( hdr + 1 + col->width * 2, col->width );
+}
+
+
+typedef struct {
+    par_extract_t key;
+    // PAR_COL_* without PAR_COL_DENSE
+    uint8_t kind;
+    // presence bitmap. NULL if all rows have the value
+    const uint8_t *bitmap;
+    // number of values
+    size_t len;
+    // width of the integers, or the lengths of strings
+    size_t width;
+    // fixed width values, or lengths of strings
+    const uint8_t *data;
+    // bytes of strings
+    const uint8_t *bytes;
+} par_column_t;
+
+
+// number of the set bits in the bitmap of nbit bits.
+// returns -1 if the unused bits of the last byte are set.
+static inline int _par_col_bitcount( const uint8_t *bits, size_t nbit,
+                                     size_t *count )
+{
+    size_t nbyte = nbit / 8;
+    size_t n = 0;
+    size_t i = 0;
+
+    for(; i < nbyte; i++ ){
+        n += (size_t)__builtin_popcount( bits[i] );
+    }
+    if( nbit & 7 )
+    {
+        if( bits[nbyte] >> ( nbit & 7 ) ){
+            errno = PARCEL_EILSEQ;
+            return -1;
+        }
+        n += (size_t)__builtin_popcount( bits[nbyte] );
+    }
+    *count = n;
+
+    return PARCEL_OK;
+}
+
+
+// unpack the column at the cursor position of the columnar array col.
+// the cursor is moved to the next column, or to the first value of the
+// column of PAR_COL_ANY that must be unpacked by the caller.
+static inline int par_unpack_column( par_unpack_t *p, const par_col_t *col,
+                                     par_column_t *c )
+{
+    int check = !p->verified;
+    const uint8_t *mem = NULL;
+    uint8_t kind = 0;
+    size_t size = 0;
+    size_t i = 0;
+    int rc = par_unpack_key( p, &c->key, 0 );
+
+    if( rc != 0 ){
+        return rc;
+    }
+    else if( check ){
+        _PAR_CHECK_BLKSPC( p, 1 );
+    }
+    mem = (const uint8_t*)p->mem + p->cur;
+    kind = *mem++;
+    p->cur++;
+    c->kind = kind & ~PAR_COL_DENSE;
+    c->bitmap = NULL;
+    c->len = col->nrow;
+    c->width = 0;
+    c->bytes = NULL;
+    // presence bitmap
+    if( !( kind & PAR_COL_DENSE ) )
+    {
+        size = ( col->nrow + 7 ) / 8;
+        if( check ){
+            _PAR_CHECK_BYTEA( p, size );
+            if( _par_col_bitcount( mem, col->nrow, &c->len ) != 0 ){
+                return -1;
+            }
+        }
+        else {
+            _par_col_bitcount( mem, col->nrow, &c->len );
+        }
+        c->bitmap = mem;
+        mem += size;
+        p->cur += size;
+    }
+    c->data = mem;
+
+    switch( c->kind ){
+        case PAR_COL_ANY:
+            return PARCEL_OK;
+
+        case PAR_COL_BOOL:
+            size = ( c->len + 7 ) / 8;
+        break;
+
+        case PAR_COL_INT8 ... PAR_COL_INT64:
+            c->width = (size_t)1 << ( c->kind - PAR_COL_INT8 );
+            goto FIXED_WIDTH;
+
+        case PAR_COL_F64:
+            c->width = 8;
+FIXED_WIDTH:
+            if( check && c->len > ( p->blksize - p->cur ) / c->width ){
+                errno = PARCEL_ENOBLKS;
+                return -1;
+            }
+            size = c->len * c->width;
+        break;
+
+        case PAR_COL_STR:
+            if( check )
+            {
+                _PAR_CHECK_BLKSPC( p, 1 );
+                switch( *mem ){
+                    case 1:
+                    case 2:
+                    case 4:
+                    case 8:
+                    break;
+
+                    default:
+                        errno = PARCEL_EILSEQ;
+                        return -1;
+                }
+                if( c->len > ( p->blksize - p->cur - 1 ) / *mem ){
+                    errno = PARCEL_ENOBLKS;
+                    return -1;
+                }
+            }
+            c->width = *mem++;
+            c->data = mem;
+            size = 1 + c->len * c->width;
+            c->bytes = mem + c->len * c->width;
+            // total length of strings
+            for(; i < c->len; i++ )
+            {
+                uint_fast64_t len = par_load_bewidth( c->data + i * c->width,
+                                                      c->width );
+
+                if( check && len > p->blksize - p->cur - size ){
+                    errno = PARCEL_ENOBLKS;
+                    return -1;
+                }
+                size += len;
+            }
+        break;
+
+        default:
+            errno = PARCEL_EILSEQ;
+            return -1;
+    }
+
+    if( check ){
+        _PAR_CHECK_BYTEA( p, size );
+    }
+    p->cur += size;
+
+    return PARCEL_OK;
+}
+
+
+// the row has the value
+static inline int par_column_has( const par_column_t *c, size_t row )
+{
+    return !c->bitmap || ( ( c->bitmap[row >> 3] >> ( row & 7 ) ) & 1 );
+}
+
+
+// the i-th value of the column
+static inline int par_column_bool( const par_column_t *c, size_t i )
+{
+    return ( c->data[i >> 3] >> ( i & 7 ) ) & 1;
+}
+
+static inline int64_t par_column_int( const par_column_t *c, size_t i )
+{
+    uint64_t v = par_load_bewidth( c->data + i * c->width, c->width );
+    unsigned shift = 64 - (unsigned)c->width * 8;
+
+    // sign extension
+    return (int64_t)( v << shift ) >> shift;
+}
+
+static inline par_float64_t par_column_f64( const par_column_t *c, size_t i )
+{
+    uint64_t v = par_load_be64( c->data + i * 8 );
+    par_float64_t f = 0;
+
+    memcpy( &f, &v, sizeof( f ) );
+
+    return f;
+}
+
+static inline size_t par_column_strlen( const par_column_t *c, size_t i )
+{
+    return (size_t)par_load_bewidth( c->data + i * c->width, c->width );
+}
+
+
+// MARK: verification
+//
+// par_unpack_skip walks one complete value, including all elements of the
+// containers, and checks that every length is inside of the memory block
+// and every type is allowed at its position.
+// it returns PAR_ISA_IDX or PAR_ISA_EOS if the value is that marker.
+//
+#ifndef PAR_VERIFY_MAXDEPTH
+#define PAR_VERIFY_MAXDEPTH 4096
+#endif
+
+static inline int _par_unpack_skip( par_unpack_t *p, par_extract_t *ext,
+                                    size_t depth );
+
+
+// resume the walk of the container at off from the progress, and return the
+// number of elements that have been verified.
+static inline size_t _par_verify_resume( par_unpack_t *p, size_t off,
+                                         size_t depth )
+{
+    par_verify_t *v = p->progress;
+
+    if( v && depth <= v->nframe && v->frame[depth - 1].off == off ){
+        par_verify_frame_t *f = v->frame + depth - 1;
+
+        p->cur = f->cur;
+        p->nref = f->nref;
+        return f->nelt;
+    }
+
+    return 0;
+}
+
+
+// save the progress before walking the element at nelt of the container at
+// off.
+// NOTE: the frames are not truncated, since the frame of the container at
+//       the same offset is always the progress of the same value.
+static inline void _par_verify_save( par_unpack_t *p, size_t off,
+                                     size_t depth, size_t nelt )
+{
+    par_verify_t *v = p->progress;
+
+    if( v && depth <= PAR_VERIFY_NFRAME ){
+        v->frame[depth - 1] = (par_verify_frame_t){
+            .off = off,
+            .cur = p->cur,
+            .nelt = nelt,
+            .nref = p->nref
+        };
+        if( v->nframe < depth ){
+            v->nframe = depth;
+        }
+    }
+}
+
+
+static inline int _par_unpack_skip_val( par_unpack_t *p, size_t depth )
+{
+    par_extract_t ext;
+    int rc = _par_unpack_skip( p, &ext, depth );
+
+    // marker is not a value
+    if( rc > 0 ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return rc;
+}
+
+
+static inline int _par_unpack_skip_arrval( par_unpack_t *p, size_t depth,
+                                           int allow_eos )
+{
+    par_extract_t ext;
+    int rc = _par_unpack_skip( p, &ext, depth );
+
+    switch( rc ){
+        // non-consecutive array index and value
+        case PAR_ISA_IDX:
+            if( ( rc = par_unpack_idx( p, &ext ) ) == 0 ){
+                rc = _par_unpack_skip_val( p, depth );
+            }
+        break;
+
+        case PAR_ISA_EOS:
+            if( !allow_eos ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+        break;
+    }
+
+    return rc;
+}
+
+
+static inline int _par_unpack_skip_mapval( par_unpack_t *p, size_t depth,
+                                           int allow_eos )
+{
+    par_extract_t ext;
+    int rc = par_unpack_key( p, &ext, allow_eos );
+
+    if( rc == 0 ){
+        rc = _par_unpack_skip_val( p, depth );
+    }
+
+    return rc;
+}
+
+
+static inline int _par_unpack_skip_setval( par_unpack_t *p, size_t depth,
+                                           int allow_eos )
+{
+    par_extract_t ext;
+    int rc = _par_unpack_skip( p, &ext, depth );
+
+    switch( rc ){
+        case 0:
+            switch( ext.isa ){
+                case PAR_ISA_REF8 ... PAR_ISA_REF64:
+                    errno = PARCEL_EILSEQ;
+                    return -1;
+            }
+        break;
+
+        case PAR_ISA_EOS:
+            if( allow_eos ){
+                break;
+            }
+            // fallthrough
+        case PAR_ISA_IDX:
+            errno = PARCEL_EILSEQ;
+            return -1;
+    }
+
+    return rc;
+}
+
+
+static inline int _par_unpack_skip_recval( par_unpack_t *p, size_t depth,
+                                           int allow_eos )
+{
+    (void)allow_eos;
+    return _par_unpack_skip_val( p, depth );
+}
+
+
+// skip the columns of columnar array, and check that the columns match the
+// size of the header.
+static inline int _par_unpack_skip_col( par_unpack_t *p, par_extract_t *ext,
+                                        size_t depth )
+{
+    size_t base = p->cur;
+    par_col_t col;
+    par_column_t c;
+    size_t i = 0;
+    size_t j = 0;
+    int rc = 0;
+
+    par_col_init( &col, ext );
+    // verified data
+    if( p->verified ){
+        p->cur = base + col.size;
+        return PARCEL_OK;
+    }
+
+    for(; i < col.ncol; i++ )
+    {
+        if( ( rc = par_unpack_column( p, &col, &c ) ) != 0 ){
+            return rc;
+        }
+        for( j = 0; c.kind == PAR_COL_ANY && j < c.len; j++ )
+        {
+            if( ( rc = _par_unpack_skip_val( p, depth ) ) != 0 ){
+                return rc;
+            }
+        }
+    }
+
+    // size of columns
+    if( p->cur - base != col.size ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return PARCEL_OK;
+}
+
+
+// skip the elements of indexed array/map, and check that the offset table
+// matches the elements.
+static inline int _par_unpack_skip_index( par_unpack_t *p, par_extract_t *ext,
+                                          size_t depth )
+{
+    size_t base = p->cur;
+    par_index_t idx;
+    par_extract_t kext;
+    par_key_t key;
+    par_index_ent_t ent;
+    size_t i = 0;
+    int rc = 0;
+
+    par_index_init( &idx, ext );
+    // verified data
+    if( p->verified ){
+        p->cur = base + idx.size;
+        return PARCEL_OK;
+    }
+
+    // entries of map must be sorted
+    for( i = 1; ext->isa == PAR_ISA_IMAP && i < idx.len; i++ )
+    {
+        uint32_t prev = par_index_hash( &idx, i - 1 );
+        uint32_t hash = par_index_hash( &idx, i );
+
+        if( prev > hash || ( prev == hash && par_index_off( &idx, i - 1 ) >=
+                                             par_index_off( &idx, i ) ) ){
+            errno = PARCEL_EILSEQ;
+            return -1;
+        }
+    }
+
+    for( i = 0; i < idx.len; i++ )
+    {
+        ent.off = p->cur - base;
+        if( ext->isa == PAR_ISA_IARR ){
+            // element must be at the offset
+            if( par_index_off( &idx, i ) != ent.off ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+        }
+        // key must be in the table
+        else {
+            size_t j = 0;
+
+            if( ( rc = par_unpack_key( p, &kext, 0 ) ) != 0 ||
+                ( rc = par_key_ext( &key, &kext ) ) != 0 ){
+                return rc;
+            }
+            ent.hash = par_key_hash( &key );
+            j = par_index_lower( &idx, ent.hash );
+            while( j < idx.len && par_index_hash( &idx, j ) == ent.hash &&
+                   par_index_off( &idx, j ) < ent.off ){
+                j++;
+            }
+            if( j == idx.len || par_index_hash( &idx, j ) != ent.hash ||
+                par_index_off( &idx, j ) != ent.off ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+        }
+
+        if( ( rc = _par_unpack_skip_val( p, depth ) ) != 0 ){
+            return rc;
+        }
+    }
+
+    // size of elements
+    if( p->cur - base != idx.size ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return PARCEL_OK;
+}
+
+
+static inline int _par_unpack_skip_hyb( par_unpack_t *p, par_extract_t *ext,
+                                        size_t off, size_t depth )
+{
+    size_t narr = ext->size.len;
+    size_t len = narr + par_hyb_nmap( ext );
+    size_t i = _par_verify_resume( p, off, depth );
+    int rc = 0;
+
+    for(; i < len; i++ )
+    {
+        _par_verify_save( p, off, depth, i );
+        // array section has no index
+        if( i < narr ){
+            rc = _par_unpack_skip_val( p, depth );
+        }
+        else if( ( rc = _par_unpack_skip_mapval( p, depth, 0 ) ) > 0 ){
+            // not enough elements
+            rc = -1;
+        }
+        if( rc != 0 ){
+            return rc;
+        }
+    }
+
+    return PARCEL_OK;
+}
+
+
+static inline int _par_unpack_skip( par_unpack_t *p, par_extract_t *ext,
+                                    size_t depth )
+{
+    size_t cur = p->cur;
+    int (*skipf)( par_unpack_t*, size_t, int ) = NULL;
+    size_t len = 0;
+    size_t i = 0;
+    int rc = par_unpack( p, ext );
+
+    if( rc != 0 ){
+        return rc;
+    }
+    // record the offset of the value that can be referenced
+    else if( p->refmap && par_isref_target( ext->isa ) ){
+        p->refmap[cur >> 3] |= 1 << ( cur & 7 );
+    }
+
+    switch( ext->isa )
+    {
+        case PAR_ISA_ARR4:
+        case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+            skipf = _par_unpack_skip_arrval;
+        break;
+
+        case PAR_ISA_MAP4:
+        case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+            skipf = _par_unpack_skip_mapval;
+        break;
+
+        case PAR_ISA_SET8 ... PAR_ISA_SET64:
+            skipf = _par_unpack_skip_setval;
+        break;
+
+        case PAR_ISA_REC:
+            skipf = _par_unpack_skip_recval;
+        break;
+
+        case PAR_ISA_SARR:
+            skipf = _par_unpack_skip_arrval;
+            goto STREAM;
+
+        case PAR_ISA_SMAP:
+            skipf = _par_unpack_skip_mapval;
+            goto STREAM;
+
+        case PAR_ISA_SSET:
+            skipf = _par_unpack_skip_setval;
+            goto STREAM;
+
+        case PAR_ISA_IARR:
+        case PAR_ISA_IMAP:
+            if( ++depth > PAR_VERIFY_MAXDEPTH ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+            return _par_unpack_skip_index( p, ext, depth );
+
+        case PAR_ISA_COL:
+            if( ++depth > PAR_VERIFY_MAXDEPTH ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+            return _par_unpack_skip_col( p, ext, depth );
+
+        case PAR_ISA_HYB:
+            if( ++depth > PAR_VERIFY_MAXDEPTH ){
+                errno = PARCEL_EILSEQ;
+                return -1;
+            }
+            return _par_unpack_skip_hyb( p, ext, cur, depth );
+
+        // reference must point to the preceding container that has been
+        // walked. the offsets of the containers are recorded in refmap.
+        case PAR_ISA_REF8 ... PAR_ISA_REF64:
+            len = ext->size.len;
+            if( len < cur && par_isref_target( ((uint8_t*)p->mem)[len] ) &&
+                ( !p->refmap || ( p->refmap[len >> 3] >> ( len & 7 ) ) & 1 ) ){
+                p->nref++;
+                return PARCEL_OK;
+            }
+            errno = PARCEL_EILSEQ;
+            return -1;
+
+        // array index and end-of-stream marker
+        case PAR_ISA_IDX:
+        case PAR_ISA_EOS:
+            return ext->isa;
+
+        // scalar
+        default:
+            return PARCEL_OK;
+    }
+
+    // counted container
+    if( ++depth > PAR_VERIFY_MAXDEPTH ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+    len = ext->size.len;
+    for( i = _par_verify_resume( p, cur, depth ); i < len; i++ )
+    {
+        _par_verify_save( p, cur, depth, i );
+        if( ( rc = skipf( p, depth, 0 ) ) != 0 ){
+            // not enough elements
+            return ( rc > 0 ) ? -1 : rc;
+        }
+    }
+
+    return PARCEL_OK;
+
+STREAM:
+    if( ++depth > PAR_VERIFY_MAXDEPTH ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+    i = _par_verify_resume( p, cur, depth );
+    do {
+        _par_verify_save( p, cur, depth, i++ );
+    } while( ( rc = skipf( p, depth, 1 ) ) == 0 );
+
+    return ( rc == PAR_ISA_EOS ) ? PARCEL_OK : rc;
+}
+
+
+// skip a value without extracting the elements of containers
+static inline int par_unpack_skip( par_unpack_t *p, par_extract_t *ext )
+{
+    return _par_unpack_skip( p, ext, 0 );
+}
+
+
+// verify a value at the head of memory block and return its bytes in span.
+// if progress is not NULL, the verification is resumed from the progress of
+// the previous call, and the progress is kept if the value is not complete.
+// progress must be initialized by par_verify_init() for each value.
+static inline int par_verify_resume( void *mem, size_t blksize, size_t *span,
+                                     par_verify_t *progress )
+{
+    par_unpack_t p;
+    par_extract_t ext;
+    int rc = 0;
+
+    par_unpack_init( &p, mem, blksize );
+    p.progress = progress;
+    if( ( rc = par_unpack_skip( &p, &ext ) ) > 0 ){
+        // top-level value must not be a marker
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+    else if( rc == 0 && p.nref )
+    {
+        // walk again to check that the references point to the offsets of
+        // the preceding containers
+        uint8_t *refmap = (uint8_t*)calloc( ( p.cur >> 3 ) + 1, 1 );
+
+        if( !refmap ){
+            errno = PARCEL_ENOMEM;
+            return -1;
+        }
+        par_unpack_init( &p, mem, blksize );
+        p.refmap = refmap;
+        rc = par_unpack_skip( &p, &ext );
+        free( (void*)refmap );
+    }
+
+    if( rc == 0 ){
+        *span = p.cur;
+    }
+    else if( progress && ( errno == PARCEL_ENOBLKS ||
+                           errno == PARCEL_ENODATA ) ){
+        progress->need = p.need;
+    }
+
+    return rc;
+}
+
+
+static inline int par_verify( void *mem, size_t blksize, size_t *span )
+{
+    return par_verify_resume( mem, blksize, span, NULL );
+}
+
+#undef PAR_VERIFY_MAXDEPTH
+
+
 // MARK: undef _PAR_CHECK_BLKSPC
+#undef _PAR_ENOBLKS
 #undef _PAR_CHECK_BLKSPC
+#undef _PAR_NOCHECK_BLKSPC
+#undef _PAR_CHECK_BYTEA
+#undef _PAR_NOCHECK_BYTEA
 // MARK: undef _PAR_UNPACK_*
 #undef _PAR_UNPACK_NBIT_FLT
 #undef _PAR_UNPACK_NBIT_INT
 #undef _PAR_UNPACK_NBIT_LEN
 #undef _PAR_UNPACK_NBIT_BYTEA
+#undef _PAR_UNPACK_VAL
+#undef _PAR_OP_DISPATCH
+#undef _PAR_OP_CASE
+
+// MARK: undef _PAR_STATS_*
+#undef _PAR_STATS_ADD
+#undef _PAR_STATS_PEAK
+#undef _PAR_STATS_ISA
 
 // MARK: undef PAR_TYPE*_SIZE
 #undef PAR_TYPE_SIZE
@@ -0,0 +1,355 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  record.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#include "lparcel_pack.h"
+
+#define MODULE_MT   "parcel.record"
+
+// size of the buffer on the stack for encode()
+#define RECORD_STACK_BUFSIZE    2048
+
+// maximum number of fields
+#define RECORD_MAXFIELD     UINT8_MAX
+
+// field types in the order of the type names
+enum {
+    RECORD_ANY = 0,
+    RECORD_BOOLEAN,
+    RECORD_INTEGER,
+    RECORD_NUMBER,
+    RECORD_STRING,
+    RECORD_TABLE
+};
+
+static const char *const RECORD_TYPES[] = {
+    "any", "boolean", "integer", "number", "string", "table", NULL
+};
+
+// compiled schema
+typedef struct {
+    // hash of the schema
+    uint32_t schema;
+    size_t nfield;
+    // sequence of the field names
+    int ref_keys;
+    uint8_t types[];
+} lrecord_t;
+
+
+// pack the value at the top of stack as the field type
+static int pack_field( par_pack_t *p, lua_State *L, uint8_t type )
+{
+    int ltype = lua_type( L, -1 );
+
+    // all fields are optional
+    if( ltype == LUA_TNIL ){
+        return par_pack_nil( p );
+    }
+
+    switch( type ){
+        case RECORD_BOOLEAN:
+            if( ltype == LUA_TBOOLEAN ){
+                return par_pack_bool( p, (uint8_t)lua_toboolean( L, -1 ) );
+            }
+        break;
+
+        case RECORD_INTEGER:
+            if( ltype == LUA_TNUMBER &&
+                !LUANUM_ISDBL( lua_tonumber( L, -1 ) ) ){
+                return lparcel_pack_number( p, L, -1 );
+            }
+        break;
+
+        case RECORD_NUMBER:
+            if( ltype == LUA_TNUMBER ){
+                return lparcel_pack_number( p, L, -1 );
+            }
+        break;
+
+        case RECORD_STRING:
+            if( ltype == LUA_TSTRING ){
+                size_t len = 0;
+                const char *str = lua_tolstring( L, -1, &len );
+
+                return par_pack_str( p, (void*)str, len );
+            }
+        break;
+
+        case RECORD_TABLE:
+            if( ltype == LUA_TTABLE ){
+                return lparcel_pack_val( p, L, lua_gettop( L ) );
+            }
+        break;
+
+        default:
+            return lparcel_pack_val( p, L, lua_gettop( L ) );
+    }
+
+    // invalid type
+    errno = EINVAL;
+    return -1;
+}
+
+
+static int encode_lua( lua_State *L )
+{
+    lrecord_t *r = luaL_checkudata( L, 1, MODULE_MT );
+    char buf[RECORD_STACK_BUFSIZE];
+    par_pack_t p;
+    size_t i = 0;
+    int err = 0;
+
+    luaL_checktype( L, 2, LUA_TTABLE );
+    lua_settop( L, 2 );
+    lstate_pushref( L, r->ref_keys );
+    par_pack_init_mem( &p, buf, sizeof( buf ), NULL );
+    if( par_pack_record( &p, (uint8_t)r->nfield, r->schema ) != 0 ){
+        goto FAILED;
+    }
+    // pack the fields in order of the schema
+    for(; i < r->nfield; i++ )
+    {
+        lua_rawgeti( L, 3, (int)i + 1 );
+        lua_rawget( L, 2 );
+        if( pack_field( &p, L, r->types[i] ) != 0 ){
+            goto FAILED;
+        }
+        lua_pop( L, 1 );
+    }
+    lua_pushlstring( L, p.mem, p.cur );
+    par_pack_dispose( &p );
+
+    return 1;
+
+FAILED:
+    err = errno;
+    par_pack_dispose( &p );
+    lua_settop( L, 3 );
+    lua_pushnil( L );
+    // name of the field
+    if( i < r->nfield ){
+        lua_rawgeti( L, 3, (int)i + 1 );
+        lua_pushfstring( L, "%s: %s", lua_tostring( L, -1 ), strerror( err ) );
+        lua_replace( L, -2 );
+    }
+    else {
+        lua_pushstring( L, strerror( err ) );
+    }
+
+    return 2;
+}
+
+
+static int decode_lua( lua_State *L )
+{
+    lrecord_t *r = luaL_checkudata( L, 1, MODULE_MT );
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 2, &len );
+    par_unpack_t p;
+    par_extract_t ext;
+    size_t i = 0;
+
+    lua_settop( L, 2 );
+    par_unpack_init( &p, (void*)mem, len );
+    if( par_unpack( &p, &ext ) != 0 ){
+        goto FAILED;
+    }
+    // record of the other schema
+    else if( ext.isa != PAR_ISA_REC || ext.size.len != r->nfield ||
+             ext.val.u32 != r->schema ){
+        errno = PARCEL_EILSEQ;
+        goto FAILED;
+    }
+
+    lstate_pushref( L, r->ref_keys );
+    lua_createtable( L, 0, (int)r->nfield );
+    // set the fields by the names in order of the schema
+    for(; i < r->nfield; i++ )
+    {
+        lua_rawgeti( L, 3, (int)i + 1 );
+        if( lparcel_unpack_val( L, &p ) != 0 ){
+            goto FAILED;
+        }
+        lua_rawset( L, 4 );
+    }
+
+    return 1;
+
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, MODULE_MT );
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    lrecord_t *r = lua_touserdata( L, 1 );
+
+    lstate_unref( L, r->ref_keys );
+
+    return 0;
+}
+
+
+// index of the type name at idx, or -1. nil is the type "any".
+static int typeof_field( lua_State *L, int idx )
+{
+    const char *name = NULL;
+    int i = 0;
+
+    if( lua_isnil( L, idx ) ){
+        return RECORD_ANY;
+    }
+    else if( lua_type( L, idx ) == LUA_TSTRING ){
+        name = lua_tostring( L, idx );
+        for(; RECORD_TYPES[i]; i++ ){
+            if( strcmp( name, RECORD_TYPES[i] ) == 0 ){
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+
+// compile the schema; the sequence of the field names, or the pairs of the
+// field name and type name. e.g. { 'id', { 'name', 'string' } }
+static int compile_lua( lua_State *L )
+{
+    size_t nfield = 0;
+    lrecord_t *r = NULL;
+    luaL_Buffer b;
+    size_t len = 0;
+    size_t i = 0;
+    int type = 0;
+
+    luaL_checktype( L, 1, LUA_TTABLE );
+    lua_settop( L, 1 );
+    // number of fields
+    for(;; nfield++ ){
+        lua_rawgeti( L, 1, (int)nfield + 1 );
+        if( lua_isnil( L, -1 ) ){
+            lua_pop( L, 1 );
+            break;
+        }
+        lua_pop( L, 1 );
+    }
+    luaL_argcheck( L, nfield <= RECORD_MAXFIELD, 1, "too many fields" );
+
+    r = lua_newuserdata( L, sizeof( lrecord_t ) + nfield );
+    r->nfield = nfield;
+    r->ref_keys = LUA_NOREF;
+    // field names and their index
+    lua_createtable( L, (int)nfield, (int)nfield );
+
+    for(; i < nfield; i++ )
+    {
+        lua_rawgeti( L, 1, (int)i + 1 );
+        r->types[i] = RECORD_ANY;
+        if( lua_istable( L, -1 ) ){
+            lua_rawgeti( L, -1, 2 );
+            if( ( type = typeof_field( L, -1 ) ) == -1 ){
+                return luaL_argerror( L, 1, "unknown field type" );
+            }
+            r->types[i] = (uint8_t)type;
+            lua_pop( L, 1 );
+            lua_rawgeti( L, -1, 1 );
+            lua_replace( L, -2 );
+        }
+        if( lua_type( L, -1 ) != LUA_TSTRING ){
+            return luaL_argerror( L, 1, "field name must be string" );
+        }
+        // duplicated field
+        lua_pushvalue( L, -1 );
+        lua_rawget( L, 3 );
+        if( !lua_isnil( L, -1 ) ){
+            return luaL_argerror( L, 1, "duplicated field name" );
+        }
+        lua_pop( L, 1 );
+        lua_pushvalue( L, -1 );
+        lua_pushboolean( L, 1 );
+        lua_rawset( L, 3 );
+        lua_rawseti( L, 3, (int)i + 1 );
+    }
+
+    // hash of the field names and types
+    luaL_buffinit( L, &b );
+    for( i = 0; i < nfield; i++ ){
+        lua_rawgeti( L, 3, (int)i + 1 );
+        luaL_addvalue( &b );
+        luaL_addchar( &b, '\0' );
+        luaL_addstring( &b, RECORD_TYPES[r->types[i]] );
+        luaL_addchar( &b, '\0' );
+    }
+    luaL_pushresult( &b );
+    lua_tolstring( L, -1, &len );
+    r->schema = (uint32_t)par_xxh64( lua_tostring( L, -1 ), len, 0 );
+    lua_pop( L, 1 );
+
+    r->ref_keys = lstate_ref( L );
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+LUALIB_API int luaopen_parcel_record( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "compile", compile_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "encode", encode_lua },
+        { "decode", decode_lua },
+        { NULL, NULL }
+    };
+
+    // create metatable
+    lparcel_define_mt( L, MODULE_MT, mmethod, method );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
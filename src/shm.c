@@ -0,0 +1,189 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  shm.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lparcel_channel.h"
+
+// default number of slots and bytes of a slot
+#define SHM_NSLOT       1024
+#define SHM_SLOTSIZE    2048
+
+
+// map the queue of fd to the channel at the top of stack. the fd is owned by
+// the channel.
+static int map_queue( lparcel_channel_t *c, int fd, size_t size )
+{
+    void *mem = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0 );
+
+    c->fd = fd;
+    if( mem == MAP_FAILED ){
+        return -1;
+    }
+    c->q = (lparcel_queue_t*)mem;
+    c->mapsize = size;
+
+    return 0;
+}
+
+
+// new( [nslot [, slotsize]] )
+static int new_lua( lua_State *L )
+{
+    lua_Integer nslot = luaL_optinteger( L, 1, SHM_NSLOT );
+    lua_Integer slotsize = luaL_optinteger( L, 2, SHM_SLOTSIZE );
+    lparcel_channel_t *c = NULL;
+    size_t n = 0;
+    size_t stride = 0;
+    size_t size = 0;
+    int fd = -1;
+
+    luaL_argcheck( L, nslot > 0 && nslot <= INT32_MAX, 1,
+                   "nslot out of range" );
+    luaL_argcheck( L, slotsize > 0 && slotsize <= INT32_MAX, 2,
+                   "slotsize out of range" );
+    n = (size_t)nslot;
+    size = lparcel_queue_size( &n, (size_t)slotsize, &stride );
+
+    c = lparcel_channel_new( L );
+    if( !size || size > (size_t)INT64_MAX ){
+        errno = PARCEL_ENOMEM;
+    }
+#if defined(__linux__)
+    // the zero-filled memory of the file
+    else if( ( fd = memfd_create( "parcel.shm", MFD_CLOEXEC ) ) != -1 &&
+             ftruncate( fd, (off_t)size ) == 0 &&
+             map_queue( c, fd, size ) == 0 ){
+        lparcel_queue_init( c->q, n, (size_t)slotsize, stride );
+        c->mask = n - 1;
+        c->stride = stride;
+        c->slotsize = (size_t)slotsize;
+        return 1;
+    }
+    else if( fd != -1 && c->fd == -1 ){
+        close( fd );
+    }
+#else
+    else {
+        errno = PARCEL_ENOTSUP;
+    }
+#endif
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+// open( path|fd )
+static int open_lua( lua_State *L )
+{
+    lparcel_channel_t *c = NULL;
+    lparcel_queue_t *q = NULL;
+    struct stat st;
+    size_t n = 0;
+    size_t slotsize = 0;
+    size_t stride = 0;
+    int fd = -1;
+
+    // file descriptor is duplicated
+    if( lua_type( L, 1 ) == LUA_TNUMBER ){
+        fd = (int)lua_tointeger( L, 1 );
+        luaL_argcheck( L, fd >= 0, 1, "invalid file descriptor" );
+        fd = fcntl( fd, F_DUPFD_CLOEXEC, 0 );
+    }
+    else {
+        fd = open( luaL_checkstring( L, 1 ), O_RDWR|O_CLOEXEC );
+    }
+
+    c = lparcel_channel_new( L );
+    if( fd == -1 ){
+        goto FAILED;
+    }
+    else if( fstat( fd, &st ) != 0 ){
+        close( fd );
+        goto FAILED;
+    }
+    else if( (size_t)st.st_size < sizeof( lparcel_queue_t ) ){
+        close( fd );
+        errno = PARCEL_EILSEQ;
+        goto FAILED;
+    }
+    else if( map_queue( c, fd, (size_t)st.st_size ) != 0 ){
+        goto FAILED;
+    }
+
+    // geometry must match the size of the mapping. it is read once because
+    // the other process can modify it.
+    q = c->q;
+    n = q->nslot;
+    slotsize = q->slotsize;
+    if( q->magic != LPARCEL_QUEUE_MAGIC || !n || ( n & ( n - 1 ) ) ||
+        !slotsize || slotsize > INT32_MAX ||
+        lparcel_queue_size( &n, slotsize, &stride ) != c->mapsize ){
+        errno = PARCEL_EILSEQ;
+        goto FAILED;
+    }
+    c->mask = n - 1;
+    c->stride = stride;
+    c->slotsize = slotsize;
+
+    return 1;
+
+FAILED:
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+LUALIB_API int luaopen_parcel_shm( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "new", new_lua },
+        { "open", open_lua },
+        { NULL, NULL }
+    };
+
+    // metatable of the channel
+    luaopen_parcel_channel( L );
+    lua_pop( L, 1 );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
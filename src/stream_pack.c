@@ -32,6 +32,7 @@
 
 typedef struct {
     par_pack_t p;
+    par_stats_t stats;
     lua_State *L;
     lua_State *co;
     int ref_co;
@@ -44,6 +45,9 @@ static int coreduce( void *mem, size_t bytes, void *udata )
 {
     lparcel_fnstream_t *fns = (lparcel_fnstream_t*)udata;
     int rc = 0;
+#if LUA_VERSION_NUM >= 504
+    int nres = 0;
+#endif
 
     lstate_pushref( fns->co, fns->ref_fn );
     lua_pushinteger( fns->co, (lua_Integer)bytes );
@@ -51,7 +55,9 @@ static int coreduce( void *mem, size_t bytes, void *udata )
     lua_pushlstring( fns->co, mem, bytes );
 
     // run coroutine
-#if LUA_VERSION_NUM >= 502
+#if LUA_VERSION_NUM >= 504
+    rc = lua_resume( fns->co, fns->L, 2, &nres );
+#elif LUA_VERSION_NUM >= 502
     rc = lua_resume( fns->co, fns->L, 2 );
 #else
     rc = lua_resume( fns->co, 2 );
@@ -79,19 +85,23 @@ static int coreduce( void *mem, size_t bytes, void *udata )
 static int call_lua( lua_State *L )
 {
     lparcel_fnstream_t *fns = luaL_checkudata( L, 1, MODULE_MT );
-    // pack value
-    int rc = 0;
+    uint_fast64_t start = lparcel_nsec();
 
     lua_settop( L, 2 );
-    if( ( rc = lparcel_pack_val( &fns->p, L, 2 ) ) == 0 )
+    // pack value and reduce the remaining bytes
+    if( lparcel_pack_val( &fns->p, L, 2 ) == 0 )
     {
         lua_settop( L, 0 );
-        if( ( rc = coreduce( fns->p.mem, fns->p.cur, (void*)fns ) ) == 0 ){
+        if( par_pack_flush( &fns->p ) == 0 ){
+            // bytes are accounted by the reducer
+            lparcel_stats_update( &fns->stats, 0, start );
             lua_pushboolean( L, 1 );
             return 1;
         }
     }
 
+    // discard unreduced bytes
+    fns->p.cur = 0;
     // got error
     lua_pushnil( L );
     lua_pushstring( L, strerror( errno ) );
@@ -100,6 +110,18 @@ static int call_lua( lua_State *L )
 }
 
 
+static int stats_lua( lua_State *L )
+{
+    lparcel_fnstream_t *fns = luaL_checkudata( L, 1, MODULE_MT );
+
+    lparcel_stats( L, &fns->stats );
+    // peak size starts from the current memory block
+    par_pack_stats( &fns->p, &fns->stats );
+
+    return 1;
+}
+
+
 static int tostring_lua( lua_State *L )
 {
     return lparcel_tostring( L, MODULE_MT );
@@ -125,6 +147,8 @@ static int alloc_fnstream( lua_State *L, size_t blksize, int ref_fn )
     // alloc
     fns->co = lua_newthread( L );
     if( par_pack_init( &fns->p, blksize, coreduce, (void*)fns ) == 0 ){
+        memset( (void*)&fns->stats, 0, sizeof( par_stats_t ) );
+        par_pack_stats( &fns->p, &fns->stats );
         fns->L = L;
         // retain refs
         fns->ref_co = lstate_ref( L );
@@ -185,9 +209,13 @@ LUALIB_API int luaopen_parcel_stream_pack( lua_State *L )
         { "__call", call_lua },
         { NULL, NULL }
     };
+    struct luaL_Reg method[] = {
+        { "stats", stats_lua },
+        { NULL, NULL }
+    };
 
     // create metatable
-    lparcel_define_mt( L, MODULE_MT, mmethod, NULL );
+    lparcel_define_mt( L, MODULE_MT, mmethod, method );
     // create module table
     lparcel_define_method( L, funcs );
 
@@ -26,20 +26,131 @@
  *
  */
 
+#include <stdio.h>
+#include <unistd.h>
 #include "lparcel.h"
 
 #define MODULE_MT   "parcel.unpack"
+#define PROJECTION_MT   "parcel.unpack.projection"
+#define SLICE_MT    "parcel.slice"
+#define READER_MT   "parcel.unpack.reader"
+
+// metatable of the file handle of io library. lua 5.1 defines it in lualib.h
+#if !defined(LUA_FILEHANDLE)
+#define LUA_FILEHANDLE  "FILE*"
+#endif
+
+// maximum depth of projection
+#define PROJ_MAXDEPTH   256
+
+// maximum depth of nested containers. same as the verifier
+#define UNPACK_MAXDEPTH 4096
 
 typedef struct {
     par_unpack_t p;
+    par_stats_t stats;
     int ref_mem;
+    // strings of this length or longer are returned as the slices
+    size_t slice;
 } lunpack_t;
 
+// values read from the file descriptor
+typedef struct {
+    int fd;
+    int eof;
+    int ref_file;
+    par_stats_t stats;
+    // buffered bytes are mem[head] to mem[tail]
+    char *mem;
+    size_t size;
+    size_t head;
+    size_t tail;
+    // minimum and maximum bytes of the buffer
+    size_t readahead;
+    size_t max;
+    // progress of the verification of the value at head
+    par_verify_t verify;
+} lreader_t;
+
+// string in the serialized data
+typedef struct {
+    const char *mem;
+    size_t len;
+    int ref_mem;
+} lslice_t;
+
 
 static int unpack_val( lua_State *L, par_unpack_t *p, par_extract_t *ext );
 static int ext2lua( lua_State *L, par_unpack_t *p, par_extract_t *ext );
 
 
+// number of elements to be preallocated. each element takes one byte at
+// least, so the length of the broken data is limited by the remaining bytes.
+#define presize( p, len ) \
+    (int)( ( (len) < (p)->blksize - (p)->cur ) ? (len) : \
+                                                 (p)->blksize - (p)->cur )
+
+// index and end-of-stream in the nested container are illegal at the position
+// of the container itself.
+static inline int nested( int rc )
+{
+    if( rc > 0 ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return rc;
+}
+
+
+typedef int (*unpack_f)( lua_State *L, par_unpack_t *p, par_extract_t *ext );
+
+// enter the nested container. the container needs the stack space for the
+// table, key and value, and the depth is limited to keep the C stack.
+static inline int enter( lua_State *L, par_unpack_t *p )
+{
+    if( p->depth >= UNPACK_MAXDEPTH ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+    else if( !lua_checkstack( L, 3 ) ){
+        errno = ENOMEM;
+        return -1;
+    }
+    p->depth++;
+
+    return 0;
+}
+
+
+static inline int unpack_nested( lua_State *L, par_unpack_t *p,
+                                 par_extract_t *ext, unpack_f unpackf )
+{
+    int rc = enter( L, p );
+
+    if( rc == 0 ){
+        rc = nested( unpackf( L, p, ext ) );
+        p->depth--;
+    }
+
+    return rc;
+}
+
+
+// string key is always copied
+static int key2lua( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    switch( ext->isa ){
+        case PAR_ISA_RAW8 ... PAR_ISA_STR64:
+        case PAR_ISA_STR5:
+            lua_pushlstring( L, ext->val.bytea, ext->size.len );
+            return 0;
+    }
+
+    return ext2lua( L, p, ext );
+}
+
+
 static int unpack_array_val( lua_State *L, par_unpack_t *p, par_extract_t *ext,
                              int *idx )
 {
@@ -56,7 +167,7 @@ static int unpack_array_val( lua_State *L, par_unpack_t *p, par_extract_t *ext,
             // unpack key-value pair
             // unpack key
             if( ( rc = par_unpack_idx( p, ext ) ) == 0 &&
-                ( rc = ext2lua( L, p, ext ) ) == 0 &&
+                ( rc = key2lua( L, p, ext ) ) == 0 &&
                 ( rc = unpack_val( L, p, ext ) ) == 0 ){
                 lua_rawset( L, -3 );
             }
@@ -75,12 +186,14 @@ static int unpack_array( lua_State *L, par_unpack_t *p, par_extract_t *ext )
     size_t i = 0;
 
     // create table for array
-    lua_createtable( L, (int)len, 0 );
+    lua_createtable( L, presize( p, len ), 0 );
 
+    par_stats_enter( p->stats );
     // unpack array items
     for(; i < len && rc == 0; i++ ){
         rc = unpack_array_val( L, p, ext, &idx );
     }
+    par_stats_leave( p->stats );
 
     return rc;
 }
@@ -94,6 +207,7 @@ static int unpack_sarray( lua_State *L, par_unpack_t *p, par_extract_t *ext )
     // create table for array
     lua_createtable( L, 0, 0 );
 
+    par_stats_enter( p->stats );
 UNPACK_SARR:
     // unpack array items
     rc = unpack_array_val( L, p, ext, &idx );
@@ -103,10 +217,10 @@ UNPACK_SARR:
 
         // end-of-stream
         case PAR_ISA_EOS:
-            return 0;
+            rc = 0;
     }
+    par_stats_leave( p->stats );
 
-    // got error
     return rc;
 }
 
@@ -120,7 +234,7 @@ static int unpack_map_val( lua_State *L, par_unpack_t *p, par_extract_t *ext,
 
     // unpack key
     if( rc == 0 &&
-        ( rc = ext2lua( L, p, ext ) ) == 0 &&
+        ( rc = key2lua( L, p, ext ) ) == 0 &&
         ( rc = unpack_val( L, p, ext ) ) == 0 ){
         lua_rawset( L, -3 );
     }
@@ -136,12 +250,14 @@ static int unpack_map( lua_State *L, par_unpack_t *p, par_extract_t *ext )
     size_t len = ext->size.len;
 
     // create table for hashmap
-    lua_createtable( L, 0, (int)len );
+    lua_createtable( L, 0, presize( p, len ) );
 
+    par_stats_enter( p->stats );
     // unpack key-value pair
     for(; i < len && rc == 0; i++ ){
         rc = unpack_map_val( L, p, ext, 0 );
     }
+    par_stats_leave( p->stats );
 
     return rc;
 }
@@ -153,6 +269,7 @@ static int unpack_smap( lua_State *L, par_unpack_t *p, par_extract_t *ext )
     // create table for hashmap
     lua_createtable( L, 0, 0 );
 
+    par_stats_enter( p->stats );
 UNPACK_SMAP:
     // unpack key-value pair
     rc = unpack_map_val( L, p, ext, 1 );
@@ -162,8 +279,57 @@ UNPACK_SMAP:
 
         // end-of-stream
         case PAR_ISA_EOS:
-            return 0;
+            rc = 0;
+    }
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+// unpack the values of array section and then the key/value pairs
+static int unpack_hybrid( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    size_t narr = ext->size.len;
+    size_t nmap = par_hyb_nmap( ext );
+    size_t i = 0;
+    int rc = 0;
+
+    // create table for both of array and hashmap
+    lua_createtable( L, presize( p, narr ), presize( p, nmap ) );
+
+    par_stats_enter( p->stats );
+    for(; i < narr && rc == 0; i++ )
+    {
+        if( ( rc = nested( unpack_val( L, p, ext ) ) ) == 0 ){
+            lua_rawseti( L, -2, (int)i + 1 );
+        }
+    }
+    for( i = 0; i < nmap && rc == 0; i++ ){
+        rc = unpack_map_val( L, p, ext, 0 );
+    }
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+// unpack the fields of record as a sequence without the schema
+static int unpack_record( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    int rc = 0;
+    size_t len = ext->size.len;
+    size_t i = 0;
+
+    lua_createtable( L, presize( p, len ), 0 );
+    par_stats_enter( p->stats );
+    for(; i < len && rc == 0; i++ )
+    {
+        if( ( rc = nested( unpack_val( L, p, ext ) ) ) == 0 ){
+            lua_rawseti( L, -2, (int)i + 1 );
+        }
     }
+    par_stats_leave( p->stats );
 
     return rc;
 }
@@ -176,14 +342,17 @@ static int unpack_set( lua_State *L, par_unpack_t *p, par_extract_t *ext )
     size_t i = 0;
 
     // create table for set
-    lua_createtable( L, (int)len, 0 );
-    // unpack set items
+    lua_createtable( L, presize( p, len ), 0 );
+    par_stats_enter( p->stats );
+    // unpack set items as a sequence
     for(; i < len && rc == 0; i++ )
     {
-        if( ( rc = par_unpack_elm( p, ext, 0 ) ) == 0 ){
-            rc = ext2lua( L, p, ext );
+        if( ( rc = par_unpack_elm( p, ext, 0 ) ) == 0 &&
+            ( rc = ext2lua( L, p, ext ) ) == 0 ){
+            lua_rawseti( L, -2, (int)i + 1 );
         }
     }
+    par_stats_leave( p->stats );
 
     return rc;
 }
@@ -192,32 +361,221 @@ static int unpack_set( lua_State *L, par_unpack_t *p, par_extract_t *ext )
 static int unpack_sset( lua_State *L, par_unpack_t *p, par_extract_t *ext )
 {
     int rc = 0;
+    int idx = 1;
 
     // create table for set
     lua_createtable( L, 0, 0 );
 
+    par_stats_enter( p->stats );
 UNPACK_SSET:
-    // unpack element
-    if( ( rc = par_unpack_elm( p, ext, 1 ) ) == 0 )
-    {
-        rc = ext2lua( L, p, ext );
-        switch( rc ){
-            case 0:
+    // unpack element as a sequence
+    switch( ( rc = par_unpack_elm( p, ext, 1 ) ) ){
+        case 0:
+            if( ( rc = ext2lua( L, p, ext ) ) == 0 ){
+                lua_rawseti( L, -2, idx++ );
                 goto UNPACK_SSET;
+            }
+        break;
 
-            // end-of-stream
-            case PAR_ISA_EOS:
-                return 0;
+        // end-of-stream
+        case PAR_ISA_EOS:
+            rc = 0;
+    }
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+// push the slice of the memory block of the unpacker object
+static void push_slice( lua_State *L, lunpack_t *lu, const char *mem,
+                        size_t len )
+{
+    lslice_t *s = lua_newuserdata( L, sizeof( lslice_t ) );
+
+    s->mem = mem;
+    s->len = len;
+    s->ref_mem = LUA_NOREF;
+    luaL_getmetatable( L, SLICE_MT );
+    lua_setmetatable( L, -2 );
+    // keep the serialized data
+    lstate_pushref( L, lu->ref_mem );
+    s->ref_mem = lstate_ref( L );
+}
+
+
+// push the i-th value of the column of scalars. off is the offset of the
+// string in the bytes of the column.
+static void push_column_val( lua_State *L, par_unpack_t *p,
+                             const par_column_t *c, size_t i, size_t *off )
+{
+    lunpack_t *lu = p->udata;
+    par_float64_t num = 0;
+    size_t len = 0;
+
+    switch( c->kind ){
+        case PAR_COL_BOOL:
+            lua_pushboolean( L, par_column_bool( c, i ) );
+        break;
+
+        case PAR_COL_F64:
+            num = par_column_f64( c, i );
+            // integers are mixed in the column of numbers
+            if( num >= -9223372036854775808.0 && num < 9223372036854775808.0 &&
+                num == (par_float64_t)(int64_t)num ){
+                lua_pushinteger( L, (lua_Integer)num );
+            }
+            else {
+                lua_pushnumber( L, num );
+            }
+        break;
+
+        case PAR_COL_STR:
+            len = par_column_strlen( c, i );
+            if( lu && len >= lu->slice ){
+                push_slice( L, lu, (const char*)c->bytes + *off, len );
+            }
+            else {
+                lua_pushlstring( L, (const char*)c->bytes + *off, len );
+            }
+            *off += len;
+        break;
+
+        // integer
+        default:
+            lua_pushinteger( L, (lua_Integer)par_column_int( c, i ) );
+    }
+}
+
+
+// verify the whole columnar array before the tables of rows are created,
+// so the size of tables is not taken from the header of the broken data.
+static int verify_col( par_unpack_t *p, par_extract_t *ext )
+{
+    par_unpack_t v = *p;
+    par_extract_t e;
+
+    if( p->verified ){
+        return 0;
+    }
+    // the type byte precedes the width byte of the header
+    v.cur = (size_t)( (char*)ext->val.bytea - (char*)p->mem ) - 1;
+    v.stats = NULL;
+
+    return par_unpack_skip( &v, &e );
+}
+
+
+// unpack the columnar array as the array of maps, or as the map of column
+// arrays if bycol is true.
+static int unpack_col( lua_State *L, par_unpack_t *p, par_extract_t *ext,
+                       int bycol )
+{
+    size_t base = p->cur;
+    par_col_t col;
+    par_column_t c;
+    size_t i = 0;
+    size_t j = 0;
+    size_t row = 0;
+    size_t off = 0;
+    int rc = 0;
+
+    par_col_init( &col, ext );
+    // table, key, row or column, key and value
+    if( !lua_checkstack( L, 5 ) ){
+        errno = ENOMEM;
+        return -1;
+    }
+    else if( verify_col( p, ext ) != 0 ){
+        return -1;
+    }
+    else if( bycol ){
+        lua_createtable( L, 0, presize( p, col.ncol ) );
+    }
+    // the number of rows is limited by the bytes of columns
+    else {
+        lua_createtable( L, presize( p, col.nrow ), 0 );
+        for(; row < col.nrow; row++ ){
+            lua_createtable( L, 0, presize( p, col.ncol ) );
+            lua_rawseti( L, -2, (int)row + 1 );
         }
     }
 
-    // got error
+    par_stats_enter( p->stats );
+    for(; i < col.ncol && rc == 0; i++ )
+    {
+        if( ( rc = par_unpack_column( p, &col, &c ) ) != 0 ||
+            ( rc = key2lua( L, p, &c.key ) ) != 0 ){
+            break;
+        }
+        else if( bycol ){
+            lua_createtable( L, presize( p, col.nrow ), 0 );
+        }
+
+        off = 0;
+        for( j = 0, row = 0; j < c.len && rc == 0; j++, row++ )
+        {
+            // row of the j-th value
+            while( row < col.nrow && !par_column_has( &c, row ) ){
+                row++;
+            }
+            if( row == col.nrow ){
+                errno = PARCEL_EILSEQ;
+                rc = -1;
+                break;
+            }
+            else if( !bycol ){
+                lua_rawgeti( L, -2, (int)row + 1 );
+                lua_pushvalue( L, -2 );
+            }
+
+            if( c.kind != PAR_COL_ANY ){
+                push_column_val( L, p, &c, j, &off );
+            }
+            else if( ( rc = nested( unpack_val( L, p, ext ) ) ) != 0 ){
+                break;
+            }
+
+            if( bycol ){
+                lua_rawseti( L, -2, (int)row + 1 );
+            }
+            else {
+                lua_rawset( L, -3 );
+                lua_pop( L, 1 );
+            }
+        }
+
+        if( rc == 0 ){
+            if( bycol ){
+                lua_rawset( L, -3 );
+            }
+            else {
+                lua_pop( L, 1 );
+            }
+        }
+    }
+    par_stats_leave( p->stats );
+
+    // size of columns
+    if( rc == 0 && p->cur - base != col.size ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
     return rc;
 }
 
 
+static int unpack_rows( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    return unpack_col( L, p, ext, 0 );
+}
+
+
 static int ext2lua( lua_State *L, par_unpack_t *p, par_extract_t *ext )
 {
+    lunpack_t *lu = p->udata;
+
     switch( ext->isa )
     {
         // nil
@@ -250,7 +608,12 @@ static int ext2lua( lua_State *L, par_unpack_t *p, par_extract_t *ext )
         // string
         case PAR_ISA_RAW8 ... PAR_ISA_STR64:
         case PAR_ISA_STR5:
-            lua_pushlstring( L, ext->val.bytea, ext->size.len );
+            if( lu && ext->size.len >= lu->slice ){
+                push_slice( L, lu, ext->val.bytea, ext->size.len );
+            }
+            else {
+                lua_pushlstring( L, ext->val.bytea, ext->size.len );
+            }
             return 0;
 
         // signed values
@@ -304,26 +667,44 @@ static int ext2lua( lua_State *L, par_unpack_t *p, par_extract_t *ext )
         // array
         case PAR_ISA_ARR4:
         case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
-            return unpack_array( L, p, ext );
+        case PAR_ISA_IARR:
+            return unpack_nested( L, p, ext, unpack_array );
 
         // map
         case PAR_ISA_MAP4:
         case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
-            return unpack_map( L, p, ext );
+        case PAR_ISA_IMAP:
+            return unpack_nested( L, p, ext, unpack_map );
+
+        // hybrid array/map
+        case PAR_ISA_HYB:
+            return unpack_nested( L, p, ext, unpack_hybrid );
+
+        // record
+        case PAR_ISA_REC:
+            return unpack_nested( L, p, ext, unpack_record );
+
+        // columnar array
+        case PAR_ISA_COL:
+            return unpack_nested( L, p, ext, unpack_rows );
+
+        // extension
+        case PAR_ISA_EXT:
+            return lparcel_unpack_ext( L, ext );
 
         // set
         case PAR_ISA_SET8 ... PAR_ISA_SET64:
-            return unpack_set( L, p, ext );
+            return unpack_nested( L, p, ext, unpack_set );
 
         // stream array/map/set
         case PAR_ISA_SARR:
-            return unpack_sarray( L, p, ext );
+            return unpack_nested( L, p, ext, unpack_sarray );
 
         case PAR_ISA_SMAP:
-            return unpack_smap( L, p, ext );
+            return unpack_nested( L, p, ext, unpack_smap );
 
         case PAR_ISA_SSET:
-            return unpack_sset( L, p, ext );
+            return unpack_nested( L, p, ext, unpack_sset );
 
         // array index
         case PAR_ISA_IDX:
@@ -354,99 +735,1318 @@ static int unpack_val( lua_State *L, par_unpack_t *p, par_extract_t *ext )
 }
 
 
-static int unpack_lua( lua_State *L )
+// unpack a value at the cursor position for the other modules
+int lparcel_unpack_val( lua_State *L, par_unpack_t *p )
 {
-    size_t len = 0;
-    const char *mem = (const char*)luaL_checklstring( L, 1, &len );
-    par_unpack_t p;
     par_extract_t ext;
 
-    // init
-    par_unpack_init( &p, (void*)mem, len );
-    lua_settop( L, 1 );
-    // unpack
-    if( unpack_val( L, &p, &ext ) == 0 ){
-        return lua_gettop( L ) - 1;
+    return nested( unpack_val( L, p, &ext ) );
+}
+
+
+// MARK: projection
+//
+// a projection is a tree of the selected keys. the keys of a node are sorted
+// so that the key of map and the index of array can be found by bsearch
+// without pushing them to the lua stack.
+//
+typedef struct _proj_node_t proj_node_t;
+
+typedef struct {
+    par_key_t key;
+    // projection of the value, or NULL for the whole value
+    proj_node_t *child;
+} proj_key_t;
+
+struct _proj_node_t {
+    size_t nkey;
+    proj_key_t *keys;
+};
+
+// nodes, keys and strings are allocated in the same memory block
+typedef struct {
+    proj_node_t *node;
+    proj_key_t *key;
+    char *str;
+} proj_alloc_t;
+
+
+static int proj_cmp( const void *a, const void *b )
+{
+    return par_key_cmp( &((const proj_key_t*)a)->key,
+                        &((const proj_key_t*)b)->key );
+}
+
+
+// count number of nodes, keys and string bytes of the spec table at idx
+static void proj_count( lua_State *L, int arg, int idx, int depth,
+                        size_t *nnode, size_t *nkey, size_t *nbyte )
+{
+    if( depth > PROJ_MAXDEPTH ){
+        luaL_argerror( L, arg, "projection too deep" );
     }
+    luaL_checkstack( L, 3, NULL );
 
-    // got error
+    (*nnode)++;
     lua_pushnil( L );
-    lua_pushstring( L, strerror( errno ) );
+    while( lua_next( L, idx ) )
+    {
+        size_t len = 0;
+
+        switch( lua_type( L, -2 ) ){
+            case LUA_TSTRING:
+                lua_tolstring( L, -2, &len );
+                *nbyte += len;
+            case LUA_TNUMBER:
+            break;
+
+            default:
+                luaL_argerror( L, arg,
+                               "projection key must be string or number" );
+        }
 
-    return 2;
+        switch( lua_type( L, -1 ) ){
+            case LUA_TTABLE:
+                proj_count( L, arg, lua_gettop( L ), depth + 1, nnode, nkey,
+                            nbyte );
+                // fallthrough
+            case LUA_TBOOLEAN:
+                *nkey += lua_toboolean( L, -1 );
+            break;
+
+            default:
+                luaL_argerror( L, arg,
+                               "projection value must be boolean or table" );
+        }
+        lua_pop( L, 1 );
+    }
 }
 
 
-static int call_lua( lua_State *L )
+static proj_node_t *proj_fill( lua_State *L, int idx, proj_alloc_t *a )
 {
-    lunpack_t *lu = luaL_checkudata( L, 1, MODULE_MT );
-    par_extract_t ext;
+    proj_node_t *node = a->node++;
 
-    // unpack
-    if( unpack_val( L, &lu->p, &ext ) != -1 ){
-        return lua_gettop( L ) - 1;
+    // reserve the keys of this node before the keys of child nodes
+    node->nkey = 0;
+    node->keys = a->key;
+    lua_pushnil( L );
+    while( lua_next( L, idx ) ){
+        a->key += lua_toboolean( L, -1 );
+        lua_pop( L, 1 );
     }
 
-    // got error
     lua_pushnil( L );
-    lua_pushstring( L, strerror( errno ) );
+    while( lua_next( L, idx ) )
+    {
+        if( lua_toboolean( L, -1 ) )
+        {
+            proj_key_t *key = node->keys + node->nkey;
+            par_key_t *k = &key->key;
+
+            if( lua_type( L, -2 ) == LUA_TSTRING ){
+                const char *str = lua_tolstring( L, -2, &k->len );
+
+                k->type = PAR_KEY_STR;
+                k->str = memcpy( a->str, str, k->len );
+                k->num = 0;
+                k->isint = 0;
+                a->str += k->len;
+            }
+            else {
+                lparcel_numkey( L, -2, k );
+            }
+            key->child = NULL;
+            if( lua_type( L, -1 ) == LUA_TTABLE ){
+                key->child = proj_fill( L, lua_gettop( L ), a );
+            }
+            node->nkey++;
+        }
+        lua_pop( L, 1 );
+    }
+    qsort( (void*)node->keys, node->nkey, sizeof( proj_key_t ), proj_cmp );
 
-    return 2;
+    return node;
 }
 
 
-static int tostring_lua( lua_State *L )
+// compile the spec table at idx and push the projection
+static proj_node_t *proj_compile( lua_State *L, int arg, int idx )
 {
-    return lparcel_tostring( L, MODULE_MT );
+    size_t nnode = 0;
+    size_t nkey = 0;
+    size_t nbyte = 0;
+    proj_alloc_t a;
+
+    proj_count( L, arg, idx, 0, &nnode, &nkey, &nbyte );
+    a.node = lua_newuserdata( L, sizeof( proj_node_t ) * nnode +
+                                 sizeof( proj_key_t ) * nkey + nbyte );
+    a.key = (proj_key_t*)( a.node + nnode );
+    a.str = (char*)( a.key + nkey );
+    luaL_getmetatable( L, PROJECTION_MT );
+    lua_setmetatable( L, -2 );
+
+    return proj_fill( L, idx, &a );
 }
 
 
-static int gc_lua( lua_State *L )
+// projection object or spec table at idx
+static proj_node_t *proj_check( lua_State *L, int idx )
 {
-    lunpack_t *lu = lua_touserdata( L, 1 );
+    if( lua_type( L, idx ) == LUA_TTABLE ){
+        proj_node_t *node = proj_compile( L, idx, idx );
 
-    lstate_unref( L, lu->ref_mem );
+        // keep the projection on the stack
+        lua_replace( L, idx );
+        return node;
+    }
 
-    return 0;
+    return luaL_checkudata( L, idx, PROJECTION_MT );
 }
 
 
-static int new_lua( lua_State *L )
+// find the key of the extracted value
+static proj_key_t *proj_find( proj_node_t *node, par_extract_t *ext )
 {
-    size_t len = 0;
-    const char *mem = (const char*)luaL_checklstring( L, 1, &len );
-    int ref = 0;
-    lunpack_t *lu = NULL;
+    proj_key_t key;
 
-    lua_settop( L, 1 );
-    ref = lstate_ref( L );
-    lu = lua_newuserdata( L, sizeof( lunpack_t ) );
-    lu->ref_mem = ref;
-    par_unpack_init( &lu->p, (void*)mem, len );
-    luaL_getmetatable( L, MODULE_MT );
-    lua_setmetatable( L, -2 );
+    if( !node->nkey || par_key_ext( &key.key, ext ) != 0 ){
+        return NULL;
+    }
 
-    return 1;
+    return bsearch( (const void*)&key, (const void*)node->keys, node->nkey,
+                    sizeof( proj_key_t ), proj_cmp );
 }
 
 
-LUALIB_API int luaopen_parcel_unpack( lua_State *L )
+static int unpack_proj_val( lua_State *L, par_unpack_t *p, par_extract_t *ext,
+                            proj_node_t *node );
+
+
+// skip the value of unselected key without extracting
+static int unpack_proj_skip( par_unpack_t *p )
 {
-    struct luaL_Reg funcs[] = {
-        { "new", new_lua },
-        { "unpack", unpack_lua },
-        { NULL, NULL }
-    };
-    // oo interface
-    struct luaL_Reg mmethod[] = {
-        { "__gc", gc_lua },
-        { "__tostring", tostring_lua },
-        { "__call", call_lua },
+    par_extract_t ext;
+    int rc = par_unpack_skip( p, &ext );
+
+    // marker is not a value
+    if( rc > 0 ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return rc;
+}
+
+
+// unpack the selected key/value pairs into the table at the top of stack
+static int unpack_proj_pairs( lua_State *L, par_unpack_t *p,
+                              par_extract_t *ext, proj_node_t *node,
+                              int stream, size_t len )
+{
+    proj_key_t *key = NULL;
+    int rc = 0;
+
+    while( stream || len-- )
+    {
+        if( ( rc = par_unpack_key( p, ext, stream ) ) != 0 ){
+            // end-of-stream
+            if( rc == PAR_ISA_EOS && stream ){
+                rc = 0;
+            }
+            else if( rc > 0 ){
+                errno = PARCEL_EILSEQ;
+                rc = -1;
+            }
+            break;
+        }
+        // skip unselected key
+        else if( !( key = proj_find( node, ext ) ) ){
+            if( ( rc = unpack_proj_skip( p ) ) != 0 ){
+                break;
+            }
+        }
+        // unpack key-value pair
+        else if( ( rc = ext2lua( L, p, ext ) ) != 0 ||
+                 ( rc = unpack_proj_val( L, p, ext, key->child ) ) != 0 ){
+            break;
+        }
+        else {
+            lua_rawset( L, -3 );
+        }
+    }
+
+    return rc;
+}
+
+
+static int unpack_proj_map( lua_State *L, par_unpack_t *p, par_extract_t *ext,
+                            proj_node_t *node )
+{
+    int rc = 0;
+
+    // create table for selected keys
+    lua_createtable( L, 0, (int)node->nkey );
+
+    par_stats_enter( p->stats );
+    rc = unpack_proj_pairs( L, p, ext, node, ext->isa == PAR_ISA_SMAP,
+                            ext->size.len );
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+static int unpack_proj_array( lua_State *L, par_unpack_t *p,
+                              par_extract_t *ext, proj_node_t *node )
+{
+    int stream = ( ext->isa == PAR_ISA_SARR );
+    size_t len = ext->size.len;
+    proj_key_t *key = NULL;
+    par_extract_t idx;
+    uint_fast64_t seq = 1;
+    size_t cur = 0;
+    int rc = 0;
+
+    // create table for selected indexes
+    lua_createtable( L, 0, (int)node->nkey );
+
+    par_stats_enter( p->stats );
+    while( stream || len-- )
+    {
+        cur = p->cur;
+        if( ( rc = par_unpack( p, ext ) ) != 0 ){
+            break;
+        }
+
+        switch( ext->isa ){
+            // end-of-stream
+            case PAR_ISA_EOS:
+                if( !stream ){
+                    errno = PARCEL_EILSEQ;
+                    rc = -1;
+                }
+                goto DONE;
+
+            // non-consecutive index and value
+            case PAR_ISA_IDX:
+                if( ( rc = par_unpack_idx( p, &idx ) ) != 0 ){
+                    goto DONE;
+                }
+                cur = p->cur;
+            break;
+
+            default:
+                idx.isa = PAR_ISA_U64;
+                idx.val.u64 = seq++;
+        }
+
+        // rewind and skip unselected index
+        p->cur = cur;
+        if( !( key = proj_find( node, &idx ) ) ){
+            if( ( rc = unpack_proj_skip( p ) ) != 0 ){
+                break;
+            }
+        }
+        // unpack index-value pair
+        else if( ( rc = ext2lua( L, p, &idx ) ) != 0 ||
+                 ( rc = unpack_proj_val( L, p, ext, key->child ) ) != 0 ){
+            break;
+        }
+        else {
+            lua_rawset( L, -3 );
+        }
+    }
+
+DONE:
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+// the values of array section are selected by the consecutive indexes
+static int unpack_proj_hybrid( lua_State *L, par_unpack_t *p,
+                               par_extract_t *ext, proj_node_t *node )
+{
+    size_t narr = ext->size.len;
+    size_t nmap = par_hyb_nmap( ext );
+    proj_key_t *key = NULL;
+    par_extract_t idx;
+    size_t i = 0;
+    int rc = 0;
+
+    // create table for selected keys
+    lua_createtable( L, 0, (int)node->nkey );
+
+    par_stats_enter( p->stats );
+    idx.isa = PAR_ISA_U64;
+    for(; i < narr && rc == 0; i++ )
+    {
+        idx.val.u64 = i + 1;
+        // skip unselected index
+        if( !( key = proj_find( node, &idx ) ) ){
+            rc = unpack_proj_skip( p );
+        }
+        // unpack index-value pair
+        else if( ( rc = ext2lua( L, p, &idx ) ) == 0 &&
+                 ( rc = unpack_proj_val( L, p, ext, key->child ) ) == 0 ){
+            lua_rawset( L, -3 );
+        }
+    }
+    if( rc == 0 ){
+        rc = unpack_proj_pairs( L, p, ext, node, 0, nmap );
+    }
+    par_stats_leave( p->stats );
+
+    return rc;
+}
+
+
+// look up the selected keys in the offset table of the indexed array/map
+// instead of walking the elements.
+static int unpack_proj_index( lua_State *L, par_unpack_t *p,
+                              par_extract_t *ext, proj_node_t *node )
+{
+    size_t base = p->cur;
+    par_extract_t val;
+    par_index_t idx;
+    size_t i = 0;
+    int rc = 0;
+
+    par_index_init( &idx, ext );
+    // create table for selected keys
+    lua_createtable( L, 0, (int)node->nkey );
+
+    par_stats_enter( p->stats );
+    for(; i < node->nkey; i++ )
+    {
+        par_key_t *key = &node->keys[i].key;
+
+        p->cur = base;
+        if( ( rc = par_unpack_index_find( p, ext, key ) ) == 1 ){
+            rc = 0;
+            continue;
+        }
+        else if( rc != 0 ){
+            break;
+        }
+
+        // unpack key-value pair
+        if( key->type == PAR_KEY_STR ){
+            lua_pushlstring( L, key->str, key->len );
+        }
+        else {
+            lparcel_pushnumkey( L, key );
+        }
+        if( ( rc = unpack_proj_val( L, p, &val, node->keys[i].child ) ) != 0 ){
+            break;
+        }
+        lua_rawset( L, -3 );
+    }
+    par_stats_leave( p->stats );
+    p->cur = base + idx.size;
+
+    return rc;
+}
+
+
+// unpack a value with the projection.
+// the whole value is unpacked if node is NULL or value is not a container.
+static int unpack_proj_val( lua_State *L, par_unpack_t *p, par_extract_t *ext,
+                            proj_node_t *node )
+{
+    int rc = par_unpack( p, ext );
+
+    if( rc != 0 ){
+        return ( rc == -2 ) ? -2 : -1;
+    }
+    // key, value and table
+    else if( !lua_checkstack( L, 3 ) ){
+        errno = ENOMEM;
+        return -1;
+    }
+    else if( node )
+    {
+        switch( ext->isa ){
+            case PAR_ISA_ARR4:
+            case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+            case PAR_ISA_SARR:
+                return unpack_proj_array( L, p, ext, node );
+
+            case PAR_ISA_MAP4:
+            case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+            case PAR_ISA_SMAP:
+                return unpack_proj_map( L, p, ext, node );
+
+            case PAR_ISA_IARR:
+            case PAR_ISA_IMAP:
+                return unpack_proj_index( L, p, ext, node );
+
+            case PAR_ISA_HYB:
+                return unpack_proj_hybrid( L, p, ext, node );
+        }
+    }
+
+    // marker is not a value
+    if( ( rc = ext2lua( L, p, ext ) ) > 0 ){
+        errno = PARCEL_EILSEQ;
+        return -1;
+    }
+
+    return rc;
+}
+
+
+static int projection_lua( lua_State *L )
+{
+    luaL_checktype( L, 1, LUA_TTABLE );
+    lua_settop( L, 1 );
+    proj_compile( L, 1, 1 );
+
+    return 1;
+}
+
+
+static int proj_tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, PROJECTION_MT );
+}
+
+
+// MARK: decoding into the existing tables
+//
+// the value at the top of stack is replaced with the decoded value. the table
+// is reused for the array or map, and the stale keys are removed after the
+// elements are decoded into it.
+//
+static int into_ext( lua_State *L, par_unpack_t *p, par_extract_t *ext );
+
+static int into_val( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    switch( par_unpack( p, ext ) )
+    {
+        case -2:
+            return -2;
+
+        case 0:
+            return into_ext( L, p, ext );
+
+        default:
+            return -1;
+    }
+}
+
+
+// remove the keys of the table at the top of stack that are not found in
+// the elements from head. nmap is the number of key/value pairs that follow
+// the array section of the hybrid array/map.
+static int into_clear( lua_State *L, par_unpack_t *p, size_t head, size_t len,
+                       size_t nmap, int stream, int ismap )
+{
+    size_t cur = p->cur;
+    par_extract_t ext;
+    lua_Integer idx = 1;
+    size_t i = 0;
+    int rc = 0;
+
+    if( !lua_checkstack( L, 5 ) ){
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // set of keys
+    p->cur = head;
+    lua_createtable( L, 0, presize( p, len ) );
+NEXT_SECTION:
+    for(; stream || i < len; i++ )
+    {
+        if( ismap ){
+            rc = par_unpack_key( p, &ext, stream );
+        }
+        // consecutive value
+        else if( ( rc = par_unpack_skip( p, &ext ) ) == 0 ){
+            lua_pushinteger( L, idx++ );
+            goto SETKEY;
+        }
+        // non-consecutive array index
+        else if( rc == PAR_ISA_IDX ){
+            rc = par_unpack_idx( p, &ext );
+        }
+
+        if( rc != 0 || ( rc = key2lua( L, p, &ext ) ) != 0 ){
+            break;
+        }
+        else if( ( rc = par_unpack_skip( p, &ext ) ) != 0 ){
+            lua_pop( L, 1 );
+            break;
+        }
+SETKEY:
+        lua_pushboolean( L, 1 );
+        lua_rawset( L, -3 );
+    }
+    if( rc == 0 && nmap ){
+        len = nmap;
+        nmap = 0;
+        i = 0;
+        ismap = 1;
+        goto NEXT_SECTION;
+    }
+    p->cur = cur;
+    if( rc != 0 && rc != PAR_ISA_EOS ){
+        return -1;
+    }
+
+    // push space
+    lua_pushnil( L );
+    while( lua_next( L, -3 ) )
+    {
+        lua_pop( L, 1 );
+        lua_pushvalue( L, -1 );
+        lua_rawget( L, -3 );
+        if( lua_isnil( L, -1 ) ){
+            lua_pushvalue( L, -2 );
+            lua_pushnil( L );
+            lua_rawset( L, -6 );
+        }
+        lua_pop( L, 1 );
+    }
+    lua_pop( L, 1 );
+
+    return 0;
+}
+
+
+// decode the elements of array or map into the table at the top of stack.
+// the array section of the hybrid array/map is decoded by index, and the
+// following key/value pairs are decoded by key.
+static int into_table( lua_State *L, par_unpack_t *p, par_extract_t *ext,
+                       int ismap )
+{
+    size_t head = p->cur;
+    size_t narr = ext->size.len;
+    size_t len = narr;
+    int hybrid = ( ext->isa == PAR_ISA_HYB );
+    size_t nmap = ( hybrid ) ? par_hyb_nmap( ext ) : 0;
+    int stream = ( ext->isa == PAR_ISA_SARR || ext->isa == PAR_ISA_SMAP );
+    lua_Integer idx = 1;
+    size_t nkey = 0;
+    size_t i = 0;
+    int rc = 0;
+
+    par_stats_enter( p->stats );
+NEXT_SECTION:
+    for(; stream || i < len; i++ )
+    {
+        int extracted = 0;
+
+        if( ismap ){
+            rc = par_unpack_key( p, ext, stream );
+        }
+        else if( ( rc = par_unpack( p, ext ) ) == 0 )
+        {
+            switch( ext->isa ){
+                // non-consecutive array index
+                case PAR_ISA_IDX:
+                    if( !hybrid ){
+                        rc = par_unpack_idx( p, ext );
+                        break;
+                    }
+                    // array section of hybrid has no index
+                    errno = PARCEL_EILSEQ;
+                    rc = -1;
+                break;
+
+                case PAR_ISA_EOS:
+                    if( stream ){
+                        rc = PAR_ISA_EOS;
+                        break;
+                    }
+                    errno = PARCEL_EILSEQ;
+                    rc = -1;
+                break;
+
+                // consecutive value
+                default:
+                    lua_pushinteger( L, idx++ );
+                    extracted = 1;
+            }
+        }
+
+        if( rc != 0 || ( !extracted && ( rc = key2lua( L, p, ext ) ) != 0 ) ){
+            break;
+        }
+        // current value
+        lua_pushvalue( L, -1 );
+        lua_rawget( L, -3 );
+        rc = ( extracted ) ? into_ext( L, p, ext ) : into_val( L, p, ext );
+        if( ( rc = nested( rc ) ) != 0 ){
+            break;
+        }
+        nkey += !lua_isnil( L, -1 );
+        lua_rawset( L, -3 );
+    }
+    if( rc == 0 && hybrid && !ismap ){
+        len = nmap;
+        i = 0;
+        ismap = 1;
+        goto NEXT_SECTION;
+    }
+    par_stats_leave( p->stats );
+
+    if( rc == 0 || rc == PAR_ISA_EOS )
+    {
+        size_t n = 0;
+
+        // the table has the stale keys.
+        // NOTE: the duplicate keys of the broken data may hide the stale keys
+        lua_pushnil( L );
+        while( lua_next( L, -2 ) ){
+            lua_pop( L, 1 );
+            n++;
+        }
+        rc = ( n == nkey ) ? 0 :
+             into_clear( L, p, head, narr, nmap, stream, ismap && !hybrid );
+    }
+
+    return rc;
+}
+
+
+static int into_ext( lua_State *L, par_unpack_t *p, par_extract_t *ext )
+{
+    int ismap = 0;
+    int rc = 0;
+
+    if( lua_type( L, -1 ) == LUA_TTABLE )
+    {
+        switch( ext->isa ){
+            case PAR_ISA_MAP4:
+            case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+            case PAR_ISA_IMAP:
+            case PAR_ISA_SMAP:
+                ismap = 1;
+                // fallthrough
+            case PAR_ISA_ARR4:
+            case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+            case PAR_ISA_IARR:
+            case PAR_ISA_SARR:
+            case PAR_ISA_HYB:
+                if( ( rc = enter( L, p ) ) == 0 ){
+                    rc = into_table( L, p, ext, ismap );
+                    p->depth--;
+                }
+                return rc;
+        }
+    }
+    // replace with the new value
+    lua_pop( L, 1 );
+
+    return ext2lua( L, p, ext );
+}
+
+
+static int into_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    par_unpack_t p;
+    par_extract_t ext;
+
+    luaL_checktype( L, 2, LUA_TTABLE );
+    par_unpack_init( &p, (void*)mem, len );
+    lua_settop( L, 2 );
+    if( nested( into_val( L, &p, &ext ) ) == 0 ){
+        return 1;
+    }
+
+    // got error
+    lua_settop( L, 0 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int unpack_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    par_unpack_t p;
+    par_extract_t ext;
+    int rc = 0;
+
+    // init
+    par_unpack_init( &p, (void*)mem, len );
+    lua_settop( L, 2 );
+    // unpack
+    if( lua_isnil( L, 2 ) ){
+        rc = unpack_val( L, &p, &ext );
+    }
+    // unpack selected keys
+    else {
+        rc = unpack_proj_val( L, &p, &ext, proj_check( L, 2 ) );
+    }
+
+    if( rc == 0 ){
+        return lua_gettop( L ) - 2;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int columns_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    par_unpack_t p;
+    par_extract_t ext;
+    int rc = 0;
+
+    // init
+    par_unpack_init( &p, (void*)mem, len );
+    lua_settop( L, 1 );
+    if( ( rc = par_unpack( &p, &ext ) ) == 0 )
+    {
+        size_t nrow = ext.size.len;
+
+        if( ext.isa != PAR_ISA_COL ){
+            errno = PARCEL_EILSEQ;
+        }
+        else if( unpack_col( L, &p, &ext, 1 ) == 0 ){
+            lua_pushinteger( L, (lua_Integer)nrow );
+            return 2;
+        }
+    }
+
+    // got error
+    lua_settop( L, 1 );
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int unchecked_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    par_unpack_t p;
+    par_extract_t ext;
+    int rc = 0;
+
+    // init without space check
+    par_unpack_init( &p, (void*)mem, len );
+    p.verified = 1;
+    lua_settop( L, 2 );
+    // unpack
+    if( !len ){
+        errno = PARCEL_ENODATA;
+        rc = -2;
+    }
+    else if( lua_isnil( L, 2 ) ){
+        rc = unpack_val( L, &p, &ext );
+    }
+    // unpack selected keys
+    else {
+        rc = unpack_proj_val( L, &p, &ext, proj_check( L, 2 ) );
+    }
+
+    if( rc == 0 ){
+        return lua_gettop( L ) - 2;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int verify_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    size_t span = 0;
+
+    if( par_verify( (void*)mem, len, &span ) == 0 ){
+        lua_pushinteger( L, (lua_Integer)span );
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int call_lua( lua_State *L )
+{
+    lunpack_t *lu = luaL_checkudata( L, 1, MODULE_MT );
+    par_extract_t ext;
+    uint_fast64_t start = lparcel_nsec();
+    size_t cur = lu->p.cur;
+    int rc = unpack_val( L, &lu->p, &ext );
+
+    lparcel_stats_update( &lu->stats, lu->p.cur - cur, start );
+    // unpack
+    if( rc != -1 ){
+        return lua_gettop( L ) - 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int stats_lua( lua_State *L )
+{
+    lunpack_t *lu = luaL_checkudata( L, 1, MODULE_MT );
+
+    return lparcel_stats( L, &lu->stats );
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, MODULE_MT );
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    lunpack_t *lu = lua_touserdata( L, 1 );
+
+    lstate_unref( L, lu->ref_mem );
+
+    return 0;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    lua_Integer slice = luaL_optinteger( L, 2, 0 );
+    int ref = 0;
+    lunpack_t *lu = NULL;
+
+    lua_settop( L, 1 );
+    ref = lstate_ref( L );
+    lu = lua_newuserdata( L, sizeof( lunpack_t ) );
+    lu->ref_mem = ref;
+    lu->slice = 0;
+    par_unpack_init( &lu->p, (void*)mem, len );
+    memset( (void*)&lu->stats, 0, sizeof( par_stats_t ) );
+    par_unpack_stats( &lu->p, &lu->stats );
+    // return large strings as the slices
+    if( slice > 0 ){
+        lu->slice = (size_t)slice;
+        lu->p.udata = (void*)lu;
+    }
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+// MARK: reader
+
+// default number of bytes to be read at once
+#define READER_READAHEAD    65536
+
+// read the bytes following the buffered bytes. the buffered bytes are moved
+// to the head of the buffer, and the buffer is grown if the free space is
+// less than readahead. returns 0 at end-of-file.
+static ssize_t reader_fill( lreader_t *r )
+{
+    ssize_t rv = 0;
+
+    if( r->head )
+    {
+        if( r->head == r->tail ){
+            r->head = r->tail = 0;
+        }
+        else if( r->size - r->tail < r->readahead ){
+            memmove( r->mem, r->mem + r->head, r->tail - r->head );
+            r->tail -= r->head;
+            r->head = 0;
+        }
+    }
+
+    if( r->size - r->tail < r->readahead )
+    {
+        size_t size = r->size * 2;
+        char *mem = NULL;
+
+        if( size < r->tail + r->readahead ){
+            size = r->tail + r->readahead;
+        }
+        if( r->max && size > r->max ){
+            size = r->max;
+        }
+        // value is larger than the maximum size
+        if( size <= r->tail ){
+            errno = EMSGSIZE;
+            return -1;
+        }
+        else if( !( mem = realloc( r->mem, size ) ) ){
+            return -1;
+        }
+        r->mem = mem;
+        r->size = size;
+#if !defined(PARCEL_NO_STATS)
+        r->stats.nrealloc++;
+        if( r->stats.peak < size ){
+            r->stats.peak = size;
+        }
+#endif
+    }
+
+    while( ( rv = read( r->fd, r->mem + r->tail, r->size - r->tail ) ) == -1 &&
+           errno == EINTR );
+    if( rv > 0 ){
+        r->tail += (size_t)rv;
+    }
+    else if( rv == 0 ){
+        r->eof = 1;
+    }
+
+    return rv;
+}
+
+
+static int reader_call_lua( lua_State *L )
+{
+    lreader_t *r = luaL_checkudata( L, 1, READER_MT );
+    uint_fast64_t start = lparcel_nsec();
+    par_unpack_t p;
+    par_extract_t ext;
+    size_t span = 0;
+    int rc = 0;
+
+    lua_settop( L, 1 );
+    for(;;)
+    {
+        // the value requires more bytes than the previous verification
+        if( r->tail - r->head < r->verify.need ){
+            if( r->eof ){
+                errno = PARCEL_ENOBLKS;
+                break;
+            }
+        }
+        else if( r->head < r->tail )
+        {
+            // unpack a complete value in the buffer
+            if( par_verify_resume( r->mem + r->head, r->tail - r->head, &span,
+                                   &r->verify ) == 0 )
+            {
+                par_unpack_init( &p, r->mem + r->head, span );
+                p.verified = 1;
+                par_unpack_stats( &p, &r->stats );
+                r->head += span;
+                par_verify_init( &r->verify );
+                rc = unpack_val( L, &p, &ext );
+                lparcel_stats_update( &r->stats, span, start );
+                if( rc == 0 ){
+                    return 1;
+                }
+                break;
+            }
+            // the value straddles the end of buffer
+            else if( errno != PARCEL_ENOBLKS && errno != PARCEL_ENODATA ){
+                break;
+            }
+            // truncated value
+            else if( r->eof ){
+                errno = PARCEL_ENOBLKS;
+                break;
+            }
+            // value is larger than the maximum size
+            else if( r->max && r->verify.need > r->max ){
+                errno = EMSGSIZE;
+                break;
+            }
+        }
+        // end-of-file
+        else if( r->eof ){
+            return 0;
+        }
+
+        if( reader_fill( r ) == -1 ){
+            break;
+        }
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+static int reader_stats_lua( lua_State *L )
+{
+    lreader_t *r = luaL_checkudata( L, 1, READER_MT );
+
+    return lparcel_stats( L, &r->stats );
+}
+
+
+static int reader_tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, READER_MT );
+}
+
+
+static int reader_gc_lua( lua_State *L )
+{
+    lreader_t *r = lua_touserdata( L, 1 );
+
+    lstate_unref( L, r->ref_file );
+    free( (void*)r->mem );
+
+    return 0;
+}
+
+
+// reader( fd_or_file [, opts] )
+static int reader_lua( lua_State *L )
+{
+    int fd = -1;
+    lua_Integer readahead = READER_READAHEAD;
+    lua_Integer max = 0;
+    lreader_t *r = NULL;
+
+    // file descriptor or file handle of io library
+    if( lua_type( L, 1 ) == LUA_TNUMBER ){
+        fd = (int)lua_tointeger( L, 1 );
+        luaL_argcheck( L, fd >= 0, 1, "invalid file descriptor" );
+    }
+    else {
+        FILE **f = luaL_checkudata( L, 1, LUA_FILEHANDLE );
+
+#if LUA_VERSION_NUM >= 502
+        luaL_argcheck( L, ((luaL_Stream*)f)->closef, 1, "closed file" );
+#else
+        luaL_argcheck( L, *f, 1, "closed file" );
+#endif
+        fd = fileno( *f );
+    }
+
+    // options
+    if( !lua_isnoneornil( L, 2 ) )
+    {
+        luaL_checktype( L, 2, LUA_TTABLE );
+        lua_getfield( L, 2, "readahead" );
+        readahead = luaL_optinteger( L, -1, READER_READAHEAD );
+        luaL_argcheck( L, readahead > 0, 2, "readahead must be positive" );
+        lua_getfield( L, 2, "max" );
+        max = luaL_optinteger( L, -1, 0 );
+        luaL_argcheck( L, max >= 0, 2, "max must not be negative" );
+        if( max && readahead > max ){
+            readahead = max;
+        }
+    }
+
+    lua_settop( L, 1 );
+    r = lua_newuserdata( L, sizeof( lreader_t ) );
+    *r = (lreader_t){
+        .fd = fd,
+        .eof = 0,
+        .ref_file = LUA_NOREF,
+        .mem = NULL,
+        .size = 0,
+        .head = 0,
+        .tail = 0,
+        .readahead = (size_t)readahead,
+        .max = (size_t)max
+    };
+    par_verify_init( &r->verify );
+    // keep the file handle open
+    if( lua_type( L, 1 ) == LUA_TUSERDATA ){
+        lua_pushvalue( L, 1 );
+        r->ref_file = lstate_ref( L );
+    }
+    luaL_getmetatable( L, READER_MT );
+    lua_setmetatable( L, -2 );
+
+    return 1;
+}
+
+
+// MARK: slice
+
+static int slice_len_lua( lua_State *L )
+{
+    lslice_t *s = luaL_checkudata( L, 1, SLICE_MT );
+
+    lua_pushinteger( L, (lua_Integer)s->len );
+
+    return 1;
+}
+
+
+static int slice_tostring_lua( lua_State *L )
+{
+    lslice_t *s = luaL_checkudata( L, 1, SLICE_MT );
+
+    lua_pushlstring( L, s->mem, s->len );
+
+    return 1;
+}
+
+
+// position relative to the end like string.sub
+#define slice_posrelat( pos, len ) \
+    ( ( (pos) >= 0 ) ? (size_t)(pos) : \
+      ( (size_t)-(pos) > (len) ) ? 0 : (len) - (size_t)-(pos) + 1 )
+
+static int slice_sub_lua( lua_State *L )
+{
+    lslice_t *s = luaL_checkudata( L, 1, SLICE_MT );
+    size_t head = slice_posrelat( luaL_checkinteger( L, 2 ), s->len );
+    size_t tail = slice_posrelat( luaL_optinteger( L, 3, -1 ), s->len );
+
+    if( head < 1 ){
+        head = 1;
+    }
+    if( tail > s->len ){
+        tail = s->len;
+    }
+
+    if( head <= tail ){
+        lua_pushlstring( L, s->mem + head - 1, tail - head + 1 );
+    }
+    else {
+        lua_pushliteral( L, "" );
+    }
+
+    return 1;
+}
+
+#undef slice_posrelat
+
+
+// write the bytes to the file descriptor.
+// returns the number of bytes written that is less than the length if fd
+// would block.
+static int slice_write_lua( lua_State *L )
+{
+    lslice_t *s = luaL_checkudata( L, 1, SLICE_MT );
+    int fd = (int)luaL_checkinteger( L, 2 );
+    size_t nbyte = 0;
+
+    while( nbyte < s->len )
+    {
+        ssize_t rv = write( fd, s->mem + nbyte, s->len - nbyte );
+
+        if( rv != -1 ){
+            nbyte += (size_t)rv;
+        }
+        else if( errno == EAGAIN || errno == EWOULDBLOCK ){
+            break;
+        }
+        // got error
+        else if( errno != EINTR ){
+            lua_pushnil( L );
+            lua_pushstring( L, strerror( errno ) );
+            return 2;
+        }
+    }
+    lua_pushinteger( L, (lua_Integer)nbyte );
+
+    return 1;
+}
+
+
+static int slice_tostr_lua( lua_State *L )
+{
+    return lparcel_tostring( L, SLICE_MT );
+}
+
+
+static int slice_gc_lua( lua_State *L )
+{
+    lslice_t *s = lua_touserdata( L, 1 );
+
+    lstate_unref( L, s->ref_mem );
+
+    return 0;
+}
+
+
+LUALIB_API int luaopen_parcel_unpack( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "new", new_lua },
+        { "unpack", unpack_lua },
+        { "unchecked", unchecked_lua },
+        { "columns", columns_lua },
+        { "into", into_lua },
+        { "verify", verify_lua },
+        { "reader", reader_lua },
+        { "projection", projection_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg proj_mmethod[] = {
+        { "__tostring", proj_tostring_lua },
+        { NULL, NULL }
+    };
+    // oo interface
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { "__call", call_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg method[] = {
+        { "stats", stats_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg reader_mmethod[] = {
+        { "__gc", reader_gc_lua },
+        { "__tostring", reader_tostring_lua },
+        { "__call", reader_call_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg reader_method[] = {
+        { "stats", reader_stats_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg slice_mmethod[] = {
+        { "__gc", slice_gc_lua },
+        { "__tostring", slice_tostr_lua },
+        { "__len", slice_len_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg slice_method[] = {
+        { "tostring", slice_tostring_lua },
+        { "sub", slice_sub_lua },
+        { "write", slice_write_lua },
         { NULL, NULL }
     };
 
     // create metatable
-    lparcel_define_mt( L, MODULE_MT, mmethod, NULL );
+    lparcel_define_mt( L, MODULE_MT, mmethod, method );
+    lparcel_define_mt( L, PROJECTION_MT, proj_mmethod, NULL );
+    lparcel_define_mt( L, SLICE_MT, slice_mmethod, slice_method );
+    lparcel_define_mt( L, READER_MT, reader_mmethod, reader_method );
     // create module table
     lparcel_define_method( L, funcs );
 
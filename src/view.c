@@ -0,0 +1,592 @@
+/*
+ *  Copyright 2015 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  view.c
+ *  lua-parcel
+ *
+ *  Created by Masatoshi Teruya on 2026/10/18.
+ *
+ */
+
+
+#include "lparcel.h"
+
+#define MODULE_MT   "parcel.view"
+
+// element of the container
+typedef struct {
+    par_key_t key;
+    // offset of the value
+    size_t val;
+} view_elt_t;
+
+// proxy of the container at off
+typedef struct {
+    const char *mem;
+    size_t blksize;
+    size_t off;
+    int ref_bin;
+    // table of the visited values
+    int ref_cache;
+    // element index that is created on first access
+    size_t nelt;
+    view_elt_t *elts;
+} lview_t;
+
+
+static int push_val( lua_State *L, lview_t *v, size_t off );
+
+
+static int elt_cmp( const void *a, const void *b )
+{
+    return par_key_cmp( &((const view_elt_t*)a)->key,
+                        &((const view_elt_t*)b)->key );
+}
+
+
+// set the lua value at idx to key. returns -1 if it cannot be a key.
+static int lua2key( lua_State *L, int idx, par_key_t *key )
+{
+    key->str = NULL;
+    key->len = 0;
+    key->num = 0;
+    key->isint = 0;
+    switch( lua_type( L, idx ) ){
+        case LUA_TSTRING:
+            key->type = PAR_KEY_STR;
+            key->str = lua_tolstring( L, idx, &key->len );
+            return 0;
+
+        case LUA_TNUMBER:
+            lparcel_numkey( L, idx, key );
+            return isnan( key->num ) ? -1 : 0;
+
+        case LUA_TBOOLEAN:
+            key->type = PAR_KEY_BOOL;
+            key->num = lua_toboolean( L, idx );
+            return 0;
+    }
+
+    return -1;
+}
+
+
+static void push_key( lua_State *L, par_key_t *key )
+{
+    switch( key->type ){
+        case PAR_KEY_STR:
+            lua_pushlstring( L, key->str, key->len );
+        break;
+
+        case PAR_KEY_BOOL:
+            lua_pushboolean( L, (int)key->num );
+        break;
+
+        default:
+            lparcel_pushnumkey( L, key );
+    }
+}
+
+
+static int push_elts( view_elt_t **elts, size_t *nelt, size_t *size,
+                      view_elt_t *elt )
+{
+    if( *nelt == *size ){
+        size_t newsize = ( *size ) ? *size * 2 : 8;
+        view_elt_t *ptr = realloc( *elts, sizeof( view_elt_t ) * newsize );
+
+        if( !ptr ){
+            return -1;
+        }
+        *elts = ptr;
+        *size = newsize;
+    }
+    (*elts)[(*nelt)++] = *elt;
+
+    return 0;
+}
+
+
+// create the element index of the container by one pass over the bytes.
+// the elements are sorted by key to be found by bsearch.
+static int index_elts( lview_t *v )
+{
+    par_unpack_t p;
+    par_extract_t ext;
+    view_elt_t elt;
+    view_elt_t *elts = NULL;
+    size_t nelt = 0;
+    size_t size = 0;
+    size_t len = 0;
+    size_t nmap = 0;
+    int64_t seq = 1;
+    int stream = 0;
+    int ismap = 0;
+    int rc = 0;
+
+    // data has been verified by new()
+    par_unpack_init( &p, (void*)v->mem, v->blksize );
+    p.verified = 1;
+    p.cur = v->off;
+    par_unpack( &p, &ext );
+    switch( ext.isa ){
+        case PAR_ISA_SMAP:
+            stream = 1;
+            // fallthrough
+        case PAR_ISA_MAP4:
+        case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+        case PAR_ISA_IMAP:
+            ismap = 1;
+        break;
+
+        case PAR_ISA_SARR:
+        case PAR_ISA_SSET:
+            stream = 1;
+        break;
+
+        // key/value pairs follow the array section
+        case PAR_ISA_HYB:
+            nmap = par_hyb_nmap( &ext );
+        break;
+    }
+
+    len = ext.size.len;
+NEXT_SECTION:
+    while( stream || len-- )
+    {
+        if( ismap ){
+            if( par_unpack_key( &p, &ext, stream ) != 0 ||
+                par_key_ext( &elt.key, &ext ) != 0 ){
+                break;
+            }
+            elt.val = p.cur;
+            rc = par_unpack_skip( &p, &ext );
+        }
+        else {
+            elt.val = p.cur;
+            rc = par_unpack_skip( &p, &ext );
+            // non-consecutive index and value
+            if( rc == PAR_ISA_IDX ){
+                if( par_unpack( &p, &ext ) != 0 ||
+                    par_key_ext( &elt.key, &ext ) != 0 ){
+                    break;
+                }
+                elt.val = p.cur;
+                rc = par_unpack_skip( &p, &ext );
+            }
+            else if( rc == 0 ){
+                par_key_int( &elt.key, seq++ );
+            }
+        }
+
+        if( rc != 0 ){
+            break;
+        }
+        else if( push_elts( &elts, &nelt, &size, &elt ) != 0 ){
+            free( (void*)elts );
+            return -1;
+        }
+    }
+    if( rc == 0 && nmap ){
+        len = nmap;
+        nmap = 0;
+        ismap = 1;
+        goto NEXT_SECTION;
+    }
+
+    if( nelt ){
+        qsort( (void*)elts, nelt, sizeof( view_elt_t ), elt_cmp );
+    }
+    v->nelt = nelt;
+    // non-NULL if container is empty
+    v->elts = ( elts ) ? elts : (view_elt_t*)v;
+
+    return 0;
+}
+
+
+// find the element of the key at idx
+static view_elt_t *find_elt( lua_State *L, lview_t *v, int idx )
+{
+    view_elt_t key;
+
+    if( !v->elts && index_elts( v ) != 0 ){
+        luaL_error( L, "failed to index " MODULE_MT ": %s", strerror( errno ) );
+    }
+    else if( !v->nelt || lua2key( L, idx, &key.key ) != 0 ){
+        return NULL;
+    }
+
+    return bsearch( (const void*)&key, (const void*)v->elts, v->nelt,
+                    sizeof( view_elt_t ), elt_cmp );
+}
+
+
+// find the element of the key at idx by the offset table of the indexed
+// array/map without creating the element index.
+// returns 1 if the container is not indexed.
+static int find_index( lua_State *L, lview_t *v, int idx, view_elt_t *elt )
+{
+    par_unpack_t p;
+    par_extract_t ext;
+
+    // data has been verified by new()
+    par_unpack_init( &p, (void*)v->mem, v->blksize );
+    p.verified = 1;
+    p.cur = v->off;
+    par_unpack( &p, &ext );
+    if( ext.isa != PAR_ISA_IARR && ext.isa != PAR_ISA_IMAP ){
+        return 1;
+    }
+    else if( lua2key( L, idx, &elt->key ) != 0 ||
+             par_unpack_index_find( &p, &ext, &elt->key ) != 0 ){
+        return -1;
+    }
+    elt->val = p.cur;
+
+    return 0;
+}
+
+
+// push the cached value of the key at idx, or the value of elt and cache it
+static void push_elt( lua_State *L, lview_t *v, int idx, view_elt_t *elt )
+{
+    lstate_pushref( L, v->ref_cache );
+    lua_pushvalue( L, idx );
+    lua_rawget( L, -2 );
+    if( lua_isnil( L, -1 ) ){
+        lua_pop( L, 1 );
+        push_val( L, v, elt->val );
+        lua_pushvalue( L, idx );
+        lua_pushvalue( L, -2 );
+        lua_rawset( L, -4 );
+    }
+    lua_replace( L, -2 );
+}
+
+
+static int index_lua( lua_State *L )
+{
+    lview_t *v = luaL_checkudata( L, 1, MODULE_MT );
+    view_elt_t found;
+    view_elt_t *elt = NULL;
+
+    switch( v->elts ? 1 : find_index( L, v, 2, &found ) ){
+        case 0:
+            elt = &found;
+        break;
+        case 1:
+            elt = find_elt( L, v, 2 );
+        break;
+    }
+
+    if( elt ){
+        push_elt( L, v, 2, elt );
+    }
+    else {
+        lua_pushnil( L );
+    }
+
+    return 1;
+}
+
+
+static int newindex_lua( lua_State *L )
+{
+    return luaL_error( L, "attempt to modify " MODULE_MT );
+}
+
+
+// length of the sequence from 1 like the length of table
+static int len_lua( lua_State *L )
+{
+    lview_t *v = luaL_checkudata( L, 1, MODULE_MT );
+    view_elt_t *elt = NULL;
+    lua_Integer n = 0;
+
+    lua_pushinteger( L, 1 );
+    if( ( elt = find_elt( L, v, -1 ) ) ){
+        view_elt_t *tail = v->elts + v->nelt;
+
+        // number keys are sorted
+        for(; elt < tail && elt->key.type == PAR_KEY_NUM &&
+              elt->key.num == n + 1; elt++ ){
+            n++;
+        }
+    }
+    lua_pushinteger( L, n );
+
+    return 1;
+}
+
+
+static int next_lua( lua_State *L )
+{
+    lview_t *v = luaL_checkudata( L, 1, MODULE_MT );
+    size_t pos = (size_t)lua_tointeger( L, lua_upvalueindex( 1 ) );
+
+    if( !v->elts && index_elts( v ) != 0 ){
+        return luaL_error( L, "failed to index " MODULE_MT ": %s",
+                           strerror( errno ) );
+    }
+    else if( pos < v->nelt ){
+        lua_pushinteger( L, (lua_Integer)pos + 1 );
+        lua_replace( L, lua_upvalueindex( 1 ) );
+        lua_settop( L, 1 );
+        push_key( L, &v->elts[pos].key );
+        push_elt( L, v, 2, v->elts + pos );
+        return 2;
+    }
+
+    return 0;
+}
+
+
+static int pairs_lua( lua_State *L )
+{
+    luaL_checkudata( L, 1, MODULE_MT );
+    lua_pushinteger( L, 0 );
+    lua_pushcclosure( L, next_lua, 1 );
+    lua_pushvalue( L, 1 );
+    lua_pushnil( L );
+
+    return 3;
+}
+
+
+static int tostring_lua( lua_State *L )
+{
+    return lparcel_tostring( L, MODULE_MT );
+}
+
+
+static int gc_lua( lua_State *L )
+{
+    lview_t *v = lua_touserdata( L, 1 );
+
+    lstate_unref( L, v->ref_bin );
+    lstate_unref( L, v->ref_cache );
+    if( v->elts != (view_elt_t*)v ){
+        free( (void*)v->elts );
+    }
+
+    return 0;
+}
+
+
+// push the proxy of the container at off
+static void push_view( lua_State *L, const char *mem, size_t blksize,
+                       size_t off, int ref_bin )
+{
+    lview_t *v = lua_newuserdata( L, sizeof( lview_t ) );
+
+    memset( (void*)v, 0, sizeof( lview_t ) );
+    v->mem = mem;
+    v->blksize = blksize;
+    v->off = off;
+    v->ref_bin = LUA_NOREF;
+    v->ref_cache = LUA_NOREF;
+    luaL_getmetatable( L, MODULE_MT );
+    lua_setmetatable( L, -2 );
+    // keep the serialized data
+    lstate_pushref( L, ref_bin );
+    v->ref_bin = lstate_ref( L );
+    lua_newtable( L );
+    v->ref_cache = lstate_ref( L );
+}
+
+
+static int push_val( lua_State *L, lview_t *v, size_t off )
+{
+    par_unpack_t p;
+    par_extract_t ext;
+
+    par_unpack_init( &p, (void*)v->mem, v->blksize );
+    p.verified = 1;
+    p.cur = off;
+    par_unpack( &p, &ext );
+    switch( ext.isa )
+    {
+        case PAR_ISA_NIL:
+            lua_pushnil( L );
+            return 0;
+
+        case PAR_ISA_TRUE:
+            lua_pushboolean( L, 1 );
+            return 0;
+        case PAR_ISA_FALSE:
+            lua_pushboolean( L, 0 );
+            return 0;
+
+        case PAR_ISA_NAN:
+            lua_pushnumber( L, NAN );
+            return 0;
+        case PAR_ISA_PINF:
+            lua_pushnumber( L, INFINITY );
+            return 0;
+        case PAR_ISA_NINF:
+            lua_pushnumber( L, -INFINITY );
+            return 0;
+
+        case PAR_ISA_RAW8 ... PAR_ISA_STR64:
+        case PAR_ISA_STR5:
+            lua_pushlstring( L, ext.val.bytea, ext.size.len );
+            return 0;
+
+        case PAR_ISA_S6:
+        case PAR_ISA_S6N:
+        case PAR_ISA_S8:
+            lua_pushinteger( L, (lua_Integer)ext.val.i8 );
+            return 0;
+        case PAR_ISA_S16:
+            lua_pushinteger( L, (lua_Integer)ext.val.i16 );
+            return 0;
+        case PAR_ISA_S32:
+            lua_pushinteger( L, (lua_Integer)ext.val.i32 );
+            return 0;
+        case PAR_ISA_S64:
+            lua_pushinteger( L, (lua_Integer)ext.val.i64 );
+            return 0;
+        case PAR_ISA_U8:
+            lua_pushinteger( L, (lua_Integer)ext.val.u8 );
+            return 0;
+        case PAR_ISA_U16:
+            lua_pushinteger( L, (lua_Integer)ext.val.u16 );
+            return 0;
+        case PAR_ISA_U32:
+            lua_pushinteger( L, (lua_Integer)ext.val.u32 );
+            return 0;
+        case PAR_ISA_U64:
+            lua_pushinteger( L, (lua_Integer)ext.val.u64 );
+            return 0;
+
+        case PAR_ISA_F32:
+            lua_pushnumber( L, ext.val.f32 );
+            return 0;
+        case PAR_ISA_F64:
+            lua_pushnumber( L, ext.val.f64 );
+            return 0;
+
+        // containers
+        case PAR_ISA_ARR4:
+        case PAR_ISA_ARR8 ... PAR_ISA_ARR64:
+        case PAR_ISA_MAP4:
+        case PAR_ISA_MAP8 ... PAR_ISA_MAP64:
+        case PAR_ISA_SET8 ... PAR_ISA_SET64:
+        case PAR_ISA_SARR:
+        case PAR_ISA_SMAP:
+        case PAR_ISA_SSET:
+        case PAR_ISA_IARR:
+        case PAR_ISA_IMAP:
+        case PAR_ISA_REC:
+        case PAR_ISA_HYB:
+            push_view( L, v->mem, v->blksize, off, v->ref_bin );
+            return 0;
+
+        // reference to the preceding container. the target is extracted by
+        // the checked decoder, and the reference to the reference is
+        // followed backward.
+        case PAR_ISA_REF8 ... PAR_ISA_REF64:
+            p.verified = 0;
+            while( ext.size.len < off )
+            {
+                off = ext.size.len;
+                p.cur = off;
+                if( par_unpack( &p, &ext ) != 0 ||
+                    !par_isref_target( ext.isa ) ){
+                    break;
+                }
+                switch( ext.isa ){
+                    case PAR_ISA_REF8 ... PAR_ISA_REF64:
+                        continue;
+                }
+                push_view( L, v->mem, v->blksize, off, v->ref_bin );
+                return 0;
+            }
+            break;
+
+        // columnar array is unpacked as a whole
+        case PAR_ISA_COL:
+            p.cur = off;
+            return lparcel_unpack_val( L, &p );
+
+        case PAR_ISA_EXT:
+            if( lparcel_unpack_ext( L, &ext ) == 0 ){
+                return 0;
+            }
+            break;
+    }
+
+    lua_pushnil( L );
+    return -1;
+}
+
+
+static int new_lua( lua_State *L )
+{
+    size_t len = 0;
+    const char *mem = lparcel_checkbin( L, 1, &len );
+    size_t span = 0;
+    lview_t v;
+
+    if( par_verify( (void*)mem, len, &span ) == 0 ){
+        lua_settop( L, 1 );
+        v.mem = mem;
+        v.blksize = span;
+        v.ref_bin = lstate_ref( L );
+        // scalar value is returned as is
+        push_val( L, &v, 0 );
+        lstate_unref( L, v.ref_bin );
+        return 1;
+    }
+
+    // got error
+    lua_pushnil( L );
+    lua_pushstring( L, strerror( errno ) );
+
+    return 2;
+}
+
+
+LUALIB_API int luaopen_parcel_view( lua_State *L )
+{
+    struct luaL_Reg funcs[] = {
+        { "new", new_lua },
+        { "pairs", pairs_lua },
+        { NULL, NULL }
+    };
+    struct luaL_Reg mmethod[] = {
+        { "__gc", gc_lua },
+        { "__tostring", tostring_lua },
+        { "__index", index_lua },
+        { "__newindex", newindex_lua },
+        { "__len", len_lua },
+        { "__pairs", pairs_lua },
+        { NULL, NULL }
+    };
+
+    // create metatable
+    lparcel_define_mt( L, MODULE_MT, mmethod, NULL );
+    // create module table
+    lparcel_define_method( L, funcs );
+
+    return 1;
+}
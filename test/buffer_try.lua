@@ -0,0 +1,140 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack').unpack;
+local buffer = require('parcel.buffer');
+local val = {
+    name = 'state', flag = true, count = 1000, ratio = 0.5,
+    stats = { hits = 70000, misses = -1 },
+    list = { 10, 20, 30, [100] = 'x' },
+};
+local bin = pack( val );
+local buf = ifNil( buffer.new( bin ) );
+
+ifNotEqual( #buf, #bin );
+ifNotEqual( buf:bytes(), bin );
+
+-- same width
+ifNotEqual( buf:set( { 'flag' }, false ), true );
+val.flag = false;
+-- U16 slot
+ifNotEqual( buf:set( { 'count' }, 7 ), true );
+val.count = 7;
+ifNotEqual( buf:set( { 'count' }, -300 ), true );
+val.count = -300;
+-- U32 slot
+ifNotEqual( buffer.set( buf, { 'stats', 'hits' }, 70001 ), true );
+val.stats.hits = 70001;
+-- F64 slot
+ifNotEqual( buf:set( { 'ratio' }, 0.25 ), true );
+val.ratio = 0.25;
+-- same length string
+ifNotEqual( buf:set( { 'name' }, 'STATE' ), true );
+val.name = 'STATE';
+-- array elements
+ifNotEqual( buf:set( { 'list', 2 }, 21 ), true );
+val.list[2] = 21;
+ifNotEqual( buf:set( { 'list', 100 }, 'y' ), true );
+val.list[100] = 'y';
+ifNotEqual( inspect( unpack( buf ) ), inspect( val ) );
+
+-- resize is needed
+ifNotEqual( buf:set( { 'count' }, 4294967296 ), false );
+ifNotEqual( buf:set( { 'count' }, 1.5 ), false );
+ifNotEqual( buf:set( { 'name' }, 'longer name' ), false );
+ifNotEqual( buf:set( { 'flag' }, 1000 ), false );
+ifNotEqual( inspect( unpack( buf ) ), inspect( val ) );
+
+-- only the scalar value can be set
+ifTrue( pcall( buf.set, buf, { 'flag' }, {} ) );
+ifTrue( pcall( buf.set, buf, { 'flag' }, print ) );
+ifTrue( pcall( buf.set, buf, { 'flag' }, buf ) );
+ifTrue( pcall( buf.set, buf, { 'flag' }, coroutine.create( print ) ) );
+ifTrue( pcall( buf.set, buf, { 'flag' }, nil ) );
+ifTrue( pcall( buf.set, buf, { 'flag' } ) );
+ifNotEqual( inspect( unpack( buf ) ), inspect( val ) );
+
+-- not found
+ifNotNil( buf:set( { 'unknown' }, 1 ) );
+ifNotNil( buf:set( { 'list', 4 }, 1 ) );
+ifNotNil( buf:set( { 'name', 'x' }, 1 ) );
+
+-- invalid data
+ifNotNil( buffer.new( '\255\255' ) );
+
+-- shared block is immutable
+do
+    local view = require('parcel.view');
+    local shared = ifNil( buffer.adopt( buf:share() ) );
+
+    ifNotEqual( shared:bytes(), buf:bytes() );
+    ifNotEqual( inspect( unpack( shared ) ), inspect( val ) );
+    ifNotEqual( ifNil( view.new( shared ) ).stats.hits, 70001 );
+    ifNotNil( buf:set( { 'flag' }, true ) );
+    ifNotNil( shared:set( { 'flag' }, true ) );
+    -- copy is mutable
+    ifNotEqual( ifNil( buffer.new( shared ) ):set( { 'flag' }, true ), true );
+    ifTrue( pcall( buffer.adopt, 'ptr' ) );
+    shared = nil;
+end
+-- nested views release the buffer in the following cycles
+for _ = 1, 4 do
+    collectgarbage();
+end
+ifNotEqual( buf:set( { 'flag' }, true ), true );
+
+-- columnar array
+do
+    local rows = {};
+    for i = 1, 20 do
+        rows[i] = {
+            id = i,
+            big = i * 100000,
+            score = i + 0.5,
+            name = 'host' .. i,
+            up = i % 3 == 0,
+            -- sparse column
+            err = ( i % 5 == 0 ) and 'timeout' or nil,
+            -- mixed column
+            any = ( i % 2 == 0 ) and 'x' or i,
+            tags = { 'a', i },
+        };
+    end
+    buf = ifNil( buffer.new( require('parcel.pack').columnar( { rows = rows } ) ) );
+
+    ifNotEqual( buf:set( { 'rows', 3, 'id' }, 7 ), true );
+    rows[3].id = 7;
+    ifNotEqual( buf:set( { 'rows', 20, 'big' }, -1 ), true );
+    rows[20].big = -1;
+    ifNotEqual( buf:set( { 'rows', 1, 'score' }, 0.25 ), true );
+    rows[1].score = 0.25;
+    ifNotEqual( buf:set( { 'rows', 2, 'name' }, 'HOST2' ), true );
+    rows[2].name = 'HOST2';
+    ifNotEqual( buf:set( { 'rows', 3, 'up' }, false ), true );
+    rows[3].up = false;
+    ifNotEqual( buf:set( { 'rows', 4, 'up' }, true ), true );
+    rows[4].up = true;
+    ifNotEqual( buf:set( { 'rows', 15, 'err' }, 'TIMEOUT' ), true );
+    rows[15].err = 'TIMEOUT';
+    ifNotEqual( buf:set( { 'rows', 5, 'any' }, 9 ), true );
+    rows[5].any = 9;
+    ifNotEqual( buf:set( { 'rows', 7, 'tags', 2 }, 8 ), true );
+    rows[7].tags[2] = 8;
+    ifNotEqual( inspect( unpack( buf ) ), inspect( { rows = rows } ) );
+
+    -- value does not fit the column
+    ifNotEqual( buf:set( { 'rows', 3, 'id' }, 1000 ), false );
+    ifNotEqual( buf:set( { 'rows', 3, 'id' }, 1.5 ), false );
+    ifNotEqual( buf:set( { 'rows', 1, 'score' }, 1 ), false );
+    ifNotEqual( buf:set( { 'rows', 2, 'name' }, 'host' ), false );
+    ifNotEqual( buf:set( { 'rows', 3, 'up' }, 1 ), false );
+    ifNotEqual( inspect( unpack( buf ) ), inspect( { rows = rows } ) );
+
+    -- not found
+    ifNotNil( buf:set( { 'rows', 0, 'id' }, 1 ) );
+    ifNotNil( buf:set( { 'rows', 21, 'id' }, 1 ) );
+    ifNotNil( buf:set( { 'rows', 1.5, 'id' }, 1 ) );
+    ifNotNil( buf:set( { 'rows', 1, 'unknown' }, 1 ) );
+    ifNotNil( buf:set( { 'rows', 1, 'err' }, 'x' ) );
+    ifNotNil( buf:set( { 'rows', 1, 'id', 1 }, 1 ) );
+    -- row is not encoded as a value
+    ifNotNil( buf:set( { 'rows', 1 }, 1 ) );
+end
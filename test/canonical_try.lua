@@ -0,0 +1,45 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack').unpack;
+local keys = { 'b', 'a', 'c', 'aa', '', 10, 2, 300, 1 };
+local a, b = {}, {};
+local bin, hash, bin2, hash2;
+
+-- same contents in different insertion orders
+for i = 1, #keys do
+    a[keys[i]] = { i, [keys[i]] = ('x'):rep( i * 100 ) };
+end
+for i = #keys, 1, -1 do
+    b[keys[i]] = { i, [keys[i]] = ('x'):rep( i * 100 ) };
+end
+for i = 1, 100 do
+    a['k' .. i] = i;
+end
+for i = 100, 1, -1 do
+    b['k' .. i] = i;
+end
+
+bin, hash = pack.canonical( a );
+ifNil( bin );
+ifNotEqual( #hash, 16 );
+bin2, hash2 = pack.canonical( b );
+ifNotEqual( bin2, bin );
+ifNotEqual( hash2, hash );
+ifNotEqual( inspect( unpack( bin ) ), inspect( unpack( pack.pack( a ) ) ) );
+ifNotEqual( #bin, pack.size( a ) );
+
+-- different contents
+b.k1 = 0;
+bin2, hash2 = pack.canonical( b );
+ifEqual( hash2, hash );
+
+-- sparse array
+bin, hash = pack.canonical( { [3] = 'c', [1] = 'a', [200] = 'z' } );
+ifNotEqual( inspect( unpack( bin ) ), inspect( { 'a', [3] = 'c', [200] = 'z' } ) );
+
+-- XXH64 of the packed bytes
+bin, hash = pack.canonical( 'abc' );
+ifNotEqual( bin, pack.pack( 'abc' ) );
+ifNotEqual( hash, 'aa5845b2a0fc15d9' );
+
+-- unsupported key type
+ifNotNil( pack.canonical( { [1.5] = 1 } ) );
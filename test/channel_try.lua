@@ -0,0 +1,110 @@
+local channel = require('parcel.channel');
+local ch = ifNil( channel.new( 4, 64 ) );
+local val = { id = 1, name = 'item', list = { 1, 2, 3 } };
+local res, err;
+
+-- send and recv in order
+ifNotEqual( ch:send( val ), true );
+ifNotEqual( ch:send( 'str' ), true );
+ifNotEqual( ch:send( nil ), true );
+ifNotEqual( inspect( ch:recv() ), inspect( val ) );
+ifNotEqual( ch:recv(), 'str' );
+ifNotEqual( select( '#', ch:recv() ), 1 );
+
+-- empty
+ifNotEqual( select( '#', ch:recv( 0 ) ), 0 );
+ifNotEqual( select( '#', ch:recv( 0.01 ) ), 0 );
+
+-- full
+for i = 1, 4 do
+    ifNotEqual( ch:send( i, 0 ), true );
+end
+ifNotEqual( ch:send( 5, 0 ), false );
+ifNotEqual( ch:send( 5, 0.01 ), false );
+for i = 1, 4 do
+    ifNotEqual( ch:recv( 0 ), i );
+end
+
+-- value larger than the slot is skipped
+res, err = ch:send( ('x'):rep( 100 ) );
+ifNotNil( res );
+ifNil( err );
+ifNotEqual( ch:send( 'next' ), true );
+ifNotEqual( ch:recv( 0 ), 'next' );
+ifNotEqual( select( '#', ch:recv( 0 ) ), 0 );
+
+-- shared channel
+res = ifNil( channel.adopt( ch:share() ) );
+ifNotEqual( res:send( val ), true );
+ifNotEqual( inspect( ch:recv( 0 ) ), inspect( val ) );
+
+-- invalid arguments
+ifTrue( pcall( channel.new, 0 ) );
+ifTrue( pcall( channel.new, 1, 0 ) );
+ifTrue( pcall( ch.recv, ch, -1 ) );
+ifTrue( pcall( channel.adopt, 'ptr' ) );
+
+-- multiple producers and consumers of the shared handles. the slots of the
+-- failed values are released, so that the ring is reused many times.
+do
+    local prod = { ch, ifNil( channel.adopt( ch:share() ) ) };
+    local cons = { ifNil( channel.adopt( ch:share() ) ),
+                   ifNil( channel.adopt( ch:share() ) ) };
+    local nitem = 200;
+    local last = { 0, 0 };
+    local nrecv = 0;
+    local nfail = 0;
+    local co = {};
+
+    local function send( c, v )
+        local ok, e = c:send( v, 0 );
+
+        while ok == false do
+            coroutine.yield();
+            ok, e = c:send( v, 0 );
+        end
+        return ok, e;
+    end
+
+    for i, c in ipairs( prod ) do
+        co[#co + 1] = coroutine.create( function()
+            for j = 1, nitem do
+                -- every 7th value is too large for the slot
+                if j % 7 == 0 then
+                    res, err = send( c, ('x'):rep( 100 ) );
+                    ifNotNil( res );
+                    ifNil( err );
+                    nfail = nfail + 1;
+                end
+                ifNotEqual( send( c, { i, j } ), true );
+            end
+        end );
+    end
+    for _, c in ipairs( cons ) do
+        co[#co + 1] = coroutine.create( function()
+            while nrecv < nitem * 2 do
+                local v = c:recv( 0 );
+
+                if v then
+                    -- order of the values of each producer is kept
+                    ifNotEqual( v[2], last[v[1]] + 1 );
+                    last[v[1]] = v[2];
+                    nrecv = nrecv + 1;
+                end
+                coroutine.yield();
+            end
+        end );
+    end
+
+    while nrecv < nitem * 2 do
+        for _, c in ipairs( co ) do
+            if coroutine.status( c ) == 'suspended' then
+                ifFalse( coroutine.resume( c ) );
+            end
+        end
+    end
+    ifNotEqual( last[1], nitem );
+    ifNotEqual( last[2], nitem );
+    ifNotEqual( nfail, math.floor( nitem / 7 ) * 2 );
+    ifNotEqual( select( '#', ch:recv( 0 ) ), 0 );
+end
@@ -0,0 +1,85 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local view = require('parcel.view');
+local rows = {};
+local bin, res, v, n;
+
+for i = 1, 100 do
+    rows[i] = {
+        id = i,
+        big = i * 100000,
+        score = i + 0.5,
+        ratio = ( i % 2 == 0 ) and i or i / 4,
+        name = 'host' .. i,
+        up = i % 3 == 0,
+        tags = { 'a', i },
+        -- sparse column
+        err = ( i % 10 == 0 ) and 'timeout' or nil,
+        -- mixed column
+        any = ( i % 2 == 0 ) and 'x' or i
+    };
+end
+
+-- columnar array
+bin = ifNil( pack.columnar( rows ) );
+ifNotEqual( bin:byte( 1 ), 0xB1 );
+ifFalse( #bin < #pack.pack( rows ) );
+ifNotEqual( inspect( ifNil( unpack.unpack( bin ) ) ), inspect( rows ) );
+ifNotEqual( inspect( ifNil( unpack.unchecked( bin ) ) ), inspect( rows ) );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+res = unpack.unpack( bin );
+ifNotEqual( res[4].ratio, 4 );
+ifNotEqual( res[5].ratio, 1.25 );
+ifNotEqual( res[1].big, 100000 );
+
+-- column arrays
+res, n = unpack.columns( bin );
+ifNil( res );
+ifNotEqual( n, 100 );
+ifNotEqual( res.id[100], 100 );
+ifNotEqual( res.name[7], 'host7' );
+ifNotEqual( res.up[3], true );
+ifNotEqual( res.err[10], 'timeout' );
+ifNotNil( res.err[11] );
+ifNotEqual( inspect( res.tags[2] ), inspect( { 'a', 2 } ) );
+ifNotNil( unpack.columns( pack.pack( rows ) ) );
+
+-- nested columnar array
+res = ifNil( unpack.unpack( ifNil( pack.columnar( { rows = rows } ) ) ) );
+ifNotEqual( inspect( res ), inspect( { rows = rows } ) );
+v = ifNil( view.new( pack.columnar( { rows = rows } ) ) );
+ifNotEqual( v.rows[3].name, 'host3' );
+
+-- arrays smaller than min or not the maps of the same shape
+ifNotEqual( pack.columnar( { { a = 1 }, { a = 2 } } ),
+            pack.pack( { { a = 1 }, { a = 2 } } ) );
+ifNotEqual( ifNil( pack.columnar( { { a = 1 }, { a = 2 } }, 2 ) ):byte( 1 ),
+            0xB1 );
+ifNotEqual( pack.columnar( { { a = 1 }, 'str' }, 1 ),
+            pack.pack( { { a = 1 }, 'str' } ) );
+ifNotEqual( pack.columnar( { { a = 1 }, { b = 1 }, { c = 1 } }, 1 ),
+            pack.pack( { { a = 1 }, { b = 1 }, { c = 1 } } ) );
+
+-- broken data
+for i = 0, #bin - 1 do
+    ifNotNil( unpack.verify( bin:sub( 1, i ) ) );
+    ifNotNil( unpack.unpack( bin:sub( 1, i ) ) );
+end
+-- rows without columns
+ifNotNil( unpack.verify( string.char( 0xB1, 0x01, 0x08, 0x00, 0x00 ) ) );
+-- unused bit of the presence bitmap
+ifNotNil( unpack.verify( string.char(
+    0xB1, 0x01, 0x02, 0x01, 0x05, 0xC1, 0x61, 0x01, 0x07, 0x01, 0x01
+) ) );
+ifNotEqual( ifNil( unpack.verify( string.char(
+    0xB1, 0x01, 0x02, 0x01, 0x05, 0xC1, 0x61, 0x01, 0x03, 0x01, 0x01
+) ) ), 10 );
+-- the header of many rows and columns is not trusted before the columns are
+-- verified
+bin = string.char( 0xB1, 0x02, 0x1F, 0x40, 0x03, 0xE8, 0x03, 0xE8 ) ..
+      ('\0'):rep( 1000 );
+collectgarbage();
+res = collectgarbage( 'count' );
+ifNotNil( unpack.unpack( bin ) );
+ifNotNil( unpack.columns( bin ) );
+ifTrue( collectgarbage( 'count' ) - res > 1024 );
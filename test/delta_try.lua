@@ -0,0 +1,52 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack').unpack;
+local delta = require('parcel.delta');
+local old = {
+    name = 'state', ver = 1, tags = { 'a', 'b', 'c' },
+    nested = { x = { y = { z = 'deep' } }, w = ('x'):rep( 300 ) },
+    sparse = { [1] = 1, [2] = 2, [100] = 100 },
+};
+local new = {
+    name = 'state', ver = 2, tags = { 'a', 'c' },
+    nested = { x = { y = { z = 'deeper' } }, w = ('x'):rep( 300 ) },
+    sparse = { [1] = 1, [100] = 'hundred', [200] = 200 },
+    added = true,
+};
+local obin = pack( old );
+local nbin = pack( new );
+local patch = ifNil( delta.diff( obin, nbin ) );
+local bin;
+
+-- patch is smaller than the new data
+ifTrue( #patch >= #nbin );
+bin = ifNil( delta.patch( obin, patch ) );
+ifNotEqual( inspect( unpack( bin ) ), inspect( new ) );
+
+-- unchanged
+patch = ifNil( delta.diff( obin, obin ) );
+ifNotEqual( #patch, 1 );
+ifNotEqual( delta.patch( obin, patch ), obin );
+
+-- different type of value
+for _, v in ipairs({ 'str', 1, { 1, 2 }, { a = 1 }, {} }) do
+    bin = ifNil( delta.patch( obin, delta.diff( obin, pack( v ) ) ) );
+    ifNotEqual( inspect( unpack( bin ) ), inspect( v ) );
+end
+
+-- array elements
+old = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+new = { 1, 2, 3, 4, 'five', 6, 7, 8, 9, 10, 11 };
+new[2] = nil;
+patch = ifNil( delta.diff( pack( old ), pack( new ) ) );
+bin = ifNil( delta.patch( pack( old ), patch ) );
+ifNotEqual( inspect( unpack( bin ) ), inspect( new ) );
+
+-- invalid data
+ifNotNil( delta.diff( '', nbin ) );
+ifNotNil( delta.patch( obin, '' ) );
+-- DEL node cannot be applied to the top-level value
+ifNotNil( delta.patch( obin, pack( 4 ) ) );
+-- MAP node cannot be applied to an array
+old = { a = 1, b = ('x'):rep( 100 ) };
+new = { a = 2, b = old.b };
+ifNotNil( delta.patch( pack( { 1 } ), delta.diff( pack( old ), pack( new ) ) ) );
@@ -0,0 +1,115 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local spack = require('parcel.stream.pack');
+local view = require('parcel.view');
+local ext = require('parcel.ext');
+local buffer = require('parcel.buffer');
+local buf = buffer.new( pack.pack( { hits = 1000, name = 'item' } ) );
+local bin, res, v, sbin;
+
+local function encode( b )
+    return b:bytes();
+end
+
+local function decode( payload )
+    return assert( buffer.new( payload ) );
+end
+
+-- userdata of the unregistered metatable is packed as nil
+ifNotEqual( pack.pack( buf ), pack.pack( nil ) );
+
+-- register by the metatable name
+ext.register( 1, 'parcel.buffer', encode, decode );
+bin = ifNil( pack.pack( { buf = buf, n = 1 } ) );
+ifNotEqual( pack.size( { buf = buf, n = 1 } ), #bin );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+res = ifNil( unpack.unpack( bin ) );
+ifNotEqual( res.n, 1 );
+ifNotEqual( tostring( res.buf ):sub( 1, 14 ), 'parcel.buffer:' );
+ifNotEqual( res.buf:bytes(), buf:bytes() );
+res = ifNil( unpack.unchecked( bin ) );
+ifNotEqual( res.buf:bytes(), buf:bytes() );
+v = ifNil( view.new( bin ) );
+ifNotEqual( v.buf:bytes(), buf:bytes() );
+
+-- packer with reducer
+sbin = {};
+ifNil( spack.new( function( size, b )
+    sbin[#sbin + 1] = b:sub( 1, size );
+end )( { buf = buf, n = 1 } ) );
+ifNotEqual( table.concat( sbin ), bin );
+
+-- register by the metatable and replace the handler of the same id
+ext.register( 1, getmetatable( buf ) or debug.getmetatable( buf ),
+              function( b )
+    return 'x' .. b:bytes();
+end, function( payload )
+    return payload;
+end );
+res = ifNil( unpack.unpack( pack.pack( buf ) ) );
+ifNotEqual( res, 'x' .. buf:bytes() );
+
+-- encode must return a string and decode must not fail
+ext.register( 1, 'parcel.buffer', function()
+    return 1;
+end, decode );
+ifNotNil( pack.pack( buf ) );
+ext.register( 1, 'parcel.buffer', encode, function()
+    error( 'decode failed' );
+end );
+bin = ifNil( pack.pack( buf ) );
+ifNotNil( unpack.unpack( bin ) );
+
+-- unregistered id
+ifNotEqual( ext.unregister( 1 ), true );
+ifNotEqual( ext.unregister( 1 ), false );
+ifNotNil( unpack.unpack( bin ) );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+ifNotEqual( pack.pack( buf ), pack.pack( nil ) );
+
+-- broken data
+ext.register( 2, 'parcel.buffer', encode, decode );
+bin = pack.pack( { buf } );
+for i = 0, #bin - 1 do
+    ifNotNil( unpack.verify( bin:sub( 1, i ) ) );
+    ifNotNil( unpack.unpack( bin:sub( 1, i ) ) );
+end
+-- width of the length
+ifNotNil( unpack.verify( string.char( 0xB2, 0x03, 0x00, 0x00, 0x00, 0x02 ) ) );
+ext.unregister( 2 );
+
+-- handlers of the C API
+buffer.register( 3 );
+bin = ifNil( pack.pack( { buf = buf, n = 1 } ) );
+ifNotEqual( pack.size( { buf = buf, n = 1 } ), #bin );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+res = ifNil( unpack.unpack( bin ) );
+ifNotEqual( tostring( res.buf ):sub( 1, 14 ), 'parcel.buffer:' );
+ifNotEqual( res.buf:bytes(), buf:bytes() );
+res = ifNil( unpack.unchecked( bin ) );
+ifNotEqual( res.buf:bytes(), buf:bytes() );
+v = ifNil( view.new( bin ) );
+ifNotEqual( v.buf:bytes(), buf:bytes() );
+sbin = {};
+ifNil( spack.new( function( size, b )
+    sbin[#sbin + 1] = b:sub( 1, size );
+end )( { buf = buf, n = 1 } ) );
+ifNotEqual( table.concat( sbin ), bin );
+-- large payload and the payload that is not the serialized data
+res = ifNil( buffer.new( pack.pack( ('x'):rep( 300 ) ) ) );
+ifNotEqual( ifNil( unpack.unpack( pack.pack( { res } ) ) )[1]:bytes(),
+            res:bytes() );
+ifNotNil( unpack.unpack( string.char( 0xB2, 0x01, 0x01, 0x03, 0xFF ) ) );
+
+-- payload is hashed after it is moved to the narrowest header
+sbin = {};
+for i = 0, 64 do
+    v = { a = ('p'):rep( i ), z = { buf, res } };
+    sbin[i] = { pack.canonical( v ) };
+end
+ext.register( 3, 'parcel.buffer', encode, decode );
+for i = 0, 64 do
+    v = { a = ('p'):rep( i ), z = { buf, res } };
+    ifNotEqual( inspect( { pack.canonical( v ) } ), inspect( sbin[i] ) );
+end
+ext.unregister( 3 );
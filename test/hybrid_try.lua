@@ -0,0 +1,123 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local spack = require('parcel.stream.pack');
+local view = require('parcel.view');
+local buffer = require('parcel.buffer');
+local delta = require('parcel.delta');
+local val = {
+    10, 20, 'thirty', { 40 }, 50,
+    name = 'list', total = 5, [-1] = 'neg', [100] = 'far',
+};
+local bin = ifNil( pack.pack( val ) );
+local res, v, buf, sbin;
+
+-- consecutive indexes from 1 are packed without the index
+ifNotEqual( bin:byte( 1 ), 0xB3 );
+ifNotEqual( bin:byte( 2 ), 1 );
+ifNotEqual( bin:byte( 3 ), 5 );
+ifNotEqual( bin:byte( 4 ), 4 );
+ifNotEqual( pack.size( val ), #bin );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+ifNotEqual( inspect( unpack.unpack( bin ) ), inspect( val ) );
+ifNotEqual( inspect( unpack.unchecked( bin ) ), inspect( val ) );
+ifNotEqual( #unpack.unpack( bin ), 5 );
+
+-- nested and wide header
+res = { name = 'outer' };
+for i = 1, 300 do
+    res[i] = { i, i * 2, i * 3, i * 4, key = i };
+end
+bin = ifNil( pack.pack( res ) );
+ifNotEqual( bin:byte( 1 ), 0xB3 );
+ifNotEqual( bin:byte( 2 ), 2 );
+ifNotEqual( pack.size( res ), #bin );
+ifNotEqual( inspect( unpack.unpack( bin ) ), inspect( res ) );
+
+-- short prefix is packed as a map
+bin = pack.pack( { 1, 2, 3, name = 'short' } );
+ifNotEqual( bin:byte( 1 ), 0xF4 );
+ifNotEqual( inspect( unpack.unpack( bin ) ),
+            inspect( { 1, 2, 3, name = 'short' } ) );
+
+-- packer with reducer
+bin = pack.pack( val );
+sbin = {};
+ifNil( spack.new( function( size, b )
+    sbin[#sbin + 1] = b:sub( 1, size );
+end )( val ) );
+ifNotEqual( table.concat( sbin ), bin );
+
+-- projection
+ifNotEqual( inspect( unpack.unpack( bin, { [2] = true, [4] = true,
+                                           name = true, [100] = true } ) ),
+            inspect( { [2] = 20, [4] = { 40 }, name = 'list', [100] = 'far' } ) );
+
+-- decoded into the existing tables by index and by key
+res = { 1, 2, x = 1 };
+ifNotEqual( inspect( unpack.into( bin, res ) ), inspect( val ) );
+res = { 0, 0, 0, { 0, 0 }, 0, 0, name = 'old', stale = true };
+v = res[4];
+ifNotEqual( unpack.into( bin, res ), res );
+ifNotEqual( res[4], v );
+ifNotEqual( inspect( res ), inspect( val ) );
+
+-- delta patches the elements by key
+res = {};
+for i = 1, 20 do
+    res[i] = ('v'):rep( i );
+end
+res.name = 'old';
+res.total = 20;
+v = {};
+for k, x in pairs( res ) do
+    v[k] = x;
+end
+v[3] = 'three';
+v.name = 'new';
+v.total = nil;
+v.added = true;
+res, v = pack.pack( res ), pack.pack( v );
+ifNotEqual( res:byte( 1 ), 0xB3 );
+sbin = ifNil( delta.diff( res, v ) );
+ifNotEqual( sbin:byte( 2 ), 2 );
+ifFalse( #sbin < #v / 4 );
+ifNotEqual( inspect( unpack.unpack( ifNil( delta.patch( res, sbin ) ) ) ),
+            inspect( unpack.unpack( v ) ) );
+
+-- view
+v = ifNil( view.new( bin ) );
+ifNotEqual( v[3], 'thirty' );
+ifNotEqual( v[4][1], 40 );
+ifNotEqual( v.name, 'list' );
+ifNotEqual( v[-1], 'neg' );
+ifNotEqual( v[100], 'far' );
+ifNotNil( v[6] );
+ifNotEqual( #v, 5 );
+res = {};
+for k, x in view.pairs( v ) do
+    res[k] = x;
+end
+ifNotEqual( res.total, 5 );
+ifNotEqual( res[5], 50 );
+
+-- buffer
+buf = ifNil( buffer.new( bin ) );
+ifNotEqual( buf:set( { 2 }, 21 ), true );
+ifNotEqual( buf:set( { 'total' }, 6 ), true );
+ifNotEqual( buf:set( { 4, 1 }, 41 ), true );
+ifNotNil( buf:set( { 6 }, 60 ) );
+res = unpack.unpack( buf );
+ifNotEqual( res[2], 21 );
+ifNotEqual( res.total, 6 );
+ifNotEqual( res[4][1], 41 );
+
+-- broken data
+for i = 0, #bin - 1 do
+    ifNotNil( unpack.verify( bin:sub( 1, i ) ) );
+    ifNotNil( unpack.unpack( bin:sub( 1, i ) ) );
+end
+-- width of the number of elements
+ifNotNil( unpack.verify( string.char( 0xB3, 0x03, 0x00, 0x00, 0x00, 0x00 ) ) );
+-- index in the array section
+ifNotNil( unpack.verify( string.char( 0xB3, 0x01, 0x01, 0x00, 0xA9, 0x01 ) ) );
+ifNotNil( unpack.unpack( string.char( 0xB3, 0x01, 0x01, 0x00, 0xA9, 0x01 ) ) );
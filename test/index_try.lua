@@ -0,0 +1,87 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local view = require('parcel.view');
+local buffer = require('parcel.buffer');
+local delta = require('parcel.delta');
+local val = {
+    name = 'item',
+    tags = { 'a', 'b', 'c' },
+    stats = { hits = 1000, miss = 10, hist = { 1, 2, 3 } },
+    [1] = 'first',
+    [100] = 'last'
+};
+local bin = ifNil( pack.indexed( val, 1 ) );
+local arr = {};
+local v, buf, res;
+
+-- indexed map and array
+ifNotEqual( bin:byte( 1 ), 0xAF );
+ifNotEqual( inspect( ifNil( unpack.unpack( bin ) ) ), inspect( val ) );
+ifNotEqual( inspect( ifNil( unpack.unchecked( bin ) ) ), inspect( val ) );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+ifNotEqual( pack.indexed( {}, 1 ), pack.pack( {} ) );
+ifNotEqual( pack.indexed( 'str' ), pack.pack( 'str' ) );
+
+-- containers smaller than min are not indexed
+for i = 1, 100 do
+    arr[i] = i * 10;
+end
+ifNotEqual( pack.indexed( { 1, 2, 3 } ), pack.pack( { 1, 2, 3 } ) );
+bin = ifNil( pack.indexed( arr ) );
+ifNotEqual( bin:byte( 1 ), 0xAE );
+ifNotEqual( inspect( unpack.unpack( bin ) ), inspect( arr ) );
+
+-- projection
+bin = pack.indexed( val, 1 );
+res = ifNil( unpack.unpack( bin, {
+    name = true, none = true, tags = { [2] = true, [4] = true },
+    stats = { hist = { [3] = true } }, [100] = true
+}));
+ifNotEqual( inspect( res ), inspect({
+    name = 'item', tags = { [2] = 'b' }, stats = { hist = { [3] = 3 } },
+    [100] = 'last'
+}));
+
+-- view
+v = ifNil( view.new( bin ) );
+ifNotEqual( v.name, 'item' );
+ifNotEqual( v[1], 'first' );
+ifNotEqual( v[100], 'last' );
+ifNotNil( v.none );
+ifNotNil( v[2] );
+ifNotEqual( v.tags[3], 'c' );
+ifNotNil( v.tags[4] );
+ifNotNil( v.tags[1.5] );
+ifNotEqual( #v.tags, 3 );
+ifNotEqual( v.stats.hist[2], 2 );
+res = {};
+for k, elt in view.pairs( v.tags ) do
+    res[k] = elt;
+end
+ifNotEqual( inspect( res ), inspect( val.tags ) );
+
+-- buffer
+buf = ifNil( buffer.new( bin ) );
+ifFalse( buf:set( { 'stats', 'hits' }, 1001 ) );
+ifFalse( buf:set( { 'tags', 2 }, 'x' ) );
+ifNotNil( buf:set( { 'tags', 4 }, 'x' ) );
+res = unpack.unpack( buf );
+ifNotEqual( res.stats.hits, 1001 );
+ifNotEqual( res.tags[2], 'x' );
+
+-- delta
+res = ifNil( delta.patch( bin, ifNil( delta.diff( bin, buf:bytes() ) ) ) );
+ifNotEqual( inspect( unpack.unpack( res ) ), inspect( unpack.unpack( buf ) ) );
+
+-- corrupted offset table
+bin = pack.indexed( { a = 1, b = 2, c = 3 }, 1 );
+for i = 4, 6 * 3 + 3 do
+    local b = bin:byte( i );
+    local c = bin:sub( 1, i - 1 ) .. string.char( ( b + 1 ) % 256 ) ..
+              bin:sub( i + 1 );
+
+    ifNotNil( unpack.verify( c ) );
+end
+-- truncated
+ifNotNil( unpack.verify( bin:sub( 1, #bin - 1 ) ) );
+ifNotNil( unpack.unpack( bin:sub( 1, #bin - 1 ) ) );
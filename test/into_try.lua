@@ -0,0 +1,61 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local into = unpack.into;
+local val = {
+    name = 'item',
+    tags = { 'a', 'b', 'c' },
+    stats = { hits = 1000, hist = { 1, 2, 3 } },
+    [100] = 'last'
+};
+local target = {};
+local res, tags, stats, hist;
+
+-- decode into the empty table
+res = ifNil( into( pack.pack( val ), target ) );
+ifNotEqual( res, target );
+ifNotEqual( inspect( target ), inspect( val ) );
+tags, stats, hist = target.tags, target.stats, target.stats.hist;
+
+-- nested tables are reused and the stale keys are removed
+val.name = 'next';
+val.tags = { 'x' };
+val.stats = { miss = 1, hist = { 4, 5, 6, 7 } };
+val[100] = nil;
+val[200] = 'new';
+res = ifNil( into( pack.pack( val ), target ) );
+ifNotEqual( res, target );
+ifNotEqual( inspect( target ), inspect( val ) );
+ifNotEqual( target.tags, tags );
+ifNotEqual( target.stats, stats );
+ifNotEqual( target.stats.hist, hist );
+
+-- the value of the different type is replaced
+val.tags = 'none';
+val.stats.hist = { a = 1 };
+ifNil( into( pack.pack( val ), target ) );
+ifNotEqual( inspect( target ), inspect( val ) );
+ifNotEqual( target.stats.hist, hist );
+val.tags = { 'y' };
+ifNil( into( pack.pack( val ), target ) );
+ifNotEqual( inspect( target ), inspect( val ) );
+
+-- stream, indexed and non-consecutive containers
+val = { 1, 2, [10] = 10, s = 'str' };
+ifNil( into( pack.indexed( val, 1 ), target ) );
+ifNotEqual( inspect( target ), inspect( val ) );
+ifNil( into( string.char( 0xAB, 0x01, 0x02, 0xAA ), target ) );
+ifNotEqual( inspect( target ), inspect( { 1, 2 } ) );
+ifNil( into( string.char( 0xAC, 0xC1, 0x61, 0x01, 0xAA ), target ) );
+ifNotEqual( inspect( target ), inspect( { a = 1 } ) );
+
+-- top-level scalar value
+ifNotEqual( into( pack.pack( 'str' ), target ), 'str' );
+
+-- broken data
+res = pack.pack( { a = { b = 'c' } } );
+for i = 0, #res - 1 do
+    ifNotNil( into( res:sub( 1, i ), {} ) );
+end
+ifNotNil( into( string.char( 0xE1, 0xAA ), {} ) );
+ifNotNil( into( string.rep( string.char( 0xE1 ), 10000 ) .. string.char( 0 ), {} ) );
+ifNotNil( unpack.unpack( string.rep( string.char( 0xE1 ), 10000 ) .. string.char( 0 ) ) );
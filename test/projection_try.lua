@@ -0,0 +1,81 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack');
+local val = {
+    name = 'item',
+    desc = ('x'):rep( 1024 ),
+    tags = { 'a', 'b', 'c', [100] = 'z' },
+    stats = { hits = 1000, miss = 10, hist = { 1, 2, 3 } },
+    [1] = 'first'
+};
+local bin = pack( val );
+local proj, res;
+
+-- nested key set
+res = ifNil( unpack.unpack( bin, { name = true, stats = { hits = true } } ) );
+ifNotEqual( inspect( res ), inspect( { name = 'item', stats = { hits = 1000 } } ) );
+
+-- precompiled projection
+proj = unpack.projection({
+    [1] = true,
+    tags = { [2] = true, [100] = true },
+    stats = { hist = true }
+});
+ifNotEqual( inspect( unpack.unpack( bin, proj ) ), inspect({
+    'first',
+    tags = { [2] = 'b', [100] = 'z' },
+    stats = { hist = { 1, 2, 3 } }
+}));
+ifNotEqual(
+    inspect( unpack.unchecked( bin, proj ) ),
+    inspect( unpack.unpack( bin, proj ) )
+);
+
+-- false and missing keys are not selected
+res = ifNil( unpack.unpack( bin, { name = false, none = true, stats = {} } ) );
+ifNotEqual( inspect( res ), inspect( { stats = {} } ) );
+
+-- projection of the scalar is ignored
+ifNotEqual( unpack.unpack( pack( 'str' ), { a = true } ), 'str' );
+-- projection of the array element
+ifNotEqual(
+    inspect( unpack.unpack( pack( { { a = 1, b = 2 }, 'x' } ), { { b = true } } ) ),
+    inspect( { { b = 2 } } )
+);
+
+-- stream map and stream array
+bin = string.char(
+    0xAC, 0xC1, 0x61, 0x01,
+    0xC1, 0x62, 0xAB, 0x01, 0xA9, 0x0A, 0x02, 0xAA,
+    0xAA
+);
+ifNotEqual(
+    inspect( unpack.unpack( bin, { b = { [10] = true } } ) ),
+    inspect( { b = { [10] = 2 } } )
+);
+
+-- skipped values are still checked
+bin = string.char( 0xF2, 0xC1, 0x61, 0x01, 0xC1, 0x62, 0xC3 );
+ifNotNil( unpack.unpack( bin, { a = true } ) );
+-- stream array must be terminated
+ifNotNil( unpack.unpack( string.char( 0xAB, 0x01, 0x02 ), { true } ) );
+
+-- integer keys that are the same as double
+if math.type then
+    local n = math.tointeger( 2 ^ 53 );
+
+    bin = string.char( 0xF2 ) .. string.pack( '>BI8', 0x83, n + 1 ) ..
+          string.char( 0xC1 ) .. 'b' .. string.pack( '>BI8', 0x83, n ) ..
+          string.char( 0xC1 ) .. 'a';
+    ifNotEqual( inspect( unpack.unpack( bin, { [n + 1] = true } ) ),
+                inspect( { [n + 1] = 'b' } ) );
+    ifNotEqual( inspect( unpack.unpack( bin, { [2 ^ 53] = true } ) ),
+                inspect( { [n] = 'a' } ) );
+end
+
+-- invalid projection
+ifTrue( pcall( unpack.projection, { [true] = true } ) );
+ifTrue( pcall( unpack.projection, { a = 1 } ) );
+ifTrue( pcall( unpack.unpack, pack( 1 ), 'a' ) );
+proj = {};
+proj.a = proj;
+ifTrue( pcall( unpack.projection, proj ) );
@@ -0,0 +1,129 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local path = os.tmpname();
+local vals = {};
+local bin = {};
+local f, r, res, err, msg;
+
+for i = 1, 200 do
+    vals[i] = {
+        id = i,
+        name = ('item'):rep( i % 7 ),
+        data = ('x'):rep( i * 13 ),
+        list = { i, i * 2, { i } }
+    };
+    bin[i] = pack.pack( vals[i] );
+end
+bin = table.concat( bin );
+f = assert( io.open( path, 'wb' ) );
+f:write( bin );
+f:close();
+
+local function readall( rd )
+    local list = {};
+
+    for v in rd do
+        list[#list + 1] = v;
+    end
+
+    return list;
+end
+
+-- file handle
+f = assert( io.open( path, 'rb' ) );
+r = ifNil( unpack.reader( f ) );
+ifNotEqual( inspect( readall( r ) ), inspect( vals ) );
+ifNotEqual( select( '#', r() ), 0 );
+res = r:stats();
+ifNotEqual( res.calls, #vals );
+ifNotEqual( res.bytes, #bin );
+f:close();
+
+-- the values straddle the end of small readahead
+f = assert( io.open( path, 'rb' ) );
+r = ifNil( unpack.reader( f, { readahead = 7 } ) );
+ifNotEqual( inspect( readall( r ) ), inspect( vals ) );
+f:close();
+
+-- pipe, if io.popen is supported
+res, f = pcall( io.popen, 'cat ' .. path, 'r' );
+if res and f then
+    r = ifNil( unpack.reader( f, { readahead = 100 } ) );
+    ifNotEqual( inspect( readall( r ) ), inspect( vals ) );
+    f:close();
+end
+
+-- value larger than max
+f = assert( io.open( path, 'rb' ) );
+r = ifNil( unpack.reader( f, { readahead = 8, max = 16 } ) );
+res, err = r();
+ifNotNil( res );
+ifNil( err );
+f:close();
+
+-- the size of value is larger than max before all bytes are read
+f = assert( io.open( path, 'wb' ) );
+f:write( pack.pack( ('x'):rep( 1000 ) ):sub( 1, 20 ) );
+f:close();
+f = assert( io.open( path, 'rb' ) );
+res, err = unpack.reader( f )();
+f:close();
+ifNotNil( res );
+ifNil( err );
+f = assert( io.open( path, 'rb' ) );
+res, msg = unpack.reader( f, { readahead = 8, max = 64 } )();
+f:close();
+ifNotNil( res );
+ifNil( msg );
+ifEqual( msg, err );
+
+-- large and deeply nested values are read with small readahead
+res = {};
+for i = 1, 3000 do
+    res[i] = { i, { name = 'n' .. i } };
+end
+err = {};
+for i = 1, 40 do
+    err = { err, i };
+end
+f = assert( io.open( path, 'wb' ) );
+f:write( pack.pack( res ) .. pack.pack( err ) .. pack.pack( 'end' ) );
+f:close();
+f = assert( io.open( path, 'rb' ) );
+r = ifNil( unpack.reader( f, { readahead = 16 } ) );
+ifNotEqual( inspect( r() ), inspect( res ) );
+ifNotEqual( inspect( r() ), inspect( err ) );
+ifNotEqual( r(), 'end' );
+ifNotEqual( select( '#', r() ), 0 );
+f:close();
+
+-- truncated value
+f = assert( io.open( path, 'wb' ) );
+f:write( bin:sub( 1, #bin - 1 ) );
+f:close();
+f = assert( io.open( path, 'rb' ) );
+r = ifNil( unpack.reader( f ) );
+for i = 1, #vals - 1 do
+    ifNotEqual( inspect( r() ), inspect( vals[i] ) );
+end
+res, err = r();
+ifNotNil( res );
+ifNil( err );
+f:close();
+
+-- broken data
+f = assert( io.open( path, 'wb' ) );
+f:write( string.char( 0xE1, 0xAA ) );
+f:close();
+f = assert( io.open( path, 'rb' ) );
+res, err = unpack.reader( f )();
+ifNotNil( res );
+ifNil( err );
+f:close();
+os.remove( path );
+
+-- invalid arguments
+ifTrue( pcall( unpack.reader, -1 ) );
+ifTrue( pcall( unpack.reader, 'fd' ) );
+ifTrue( pcall( unpack.reader, 0, { readahead = 0 } ) );
+ifTrue( pcall( unpack.reader, f ) );
@@ -0,0 +1,74 @@
+local record = require('parcel.record');
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack');
+local view = require('parcel.view');
+local rec = record.compile({
+    { 'id', 'integer' },
+    { 'name', 'string' },
+    { 'score', 'number' },
+    { 'active', 'boolean' },
+    { 'tags', 'table' },
+    'extra'
+});
+local val = {
+    id = 1001,
+    name = 'item',
+    score = 1.5,
+    active = true,
+    tags = { 'a', 'b' },
+    extra = { x = 1 }
+};
+local bin = ifNil( rec:encode( val ) );
+local res, err;
+
+-- fields are packed without keys
+ifNotEqual( bin:byte( 1 ), 0xB0 );
+ifNotEqual( bin:byte( 2 ), 6 );
+ifFalse( #bin < #pack( val ) );
+ifNotEqual( inspect( ifNil( rec:decode( bin ) ) ), inspect( val ) );
+ifNotEqual( ifNil( unpack.verify( bin ) ), #bin );
+
+-- missing fields are nil
+bin = ifNil( rec:encode( { id = 1 } ) );
+ifNotEqual( inspect( rec:decode( bin ) ), inspect( { id = 1 } ) );
+
+-- record is unpacked as the sequence without the schema
+ifNotEqual(
+    inspect( unpack.unpack( rec:encode( { id = 1, name = 'a' } ) ) ),
+    inspect( { 1, 'a' } )
+);
+ifNotEqual( view.new( rec:encode( { id = 1, name = 'a' } ) )[2], 'a' );
+
+-- invalid field type
+res, err = rec:encode( { id = 1.5 } );
+ifNotNil( res );
+ifNotEqual( err:match( '^id: ' ), 'id: ' );
+ifNotNil( rec:encode( { name = 1 } ) );
+ifNotNil( rec:encode( { active = 1 } ) );
+ifNotNil( rec:encode( { tags = 'a' } ) );
+
+-- record of the other schema
+ifNotNil( record.compile( { 'id', 'name' } ):decode( bin ) );
+ifNotNil( record.compile( { 'id', { 'name', 'string' } } ):decode(
+    record.compile( { 'id', 'name' } ):encode( { id = 1 } )
+));
+ifNotNil( rec:decode( pack( val ) ) );
+-- truncated
+bin = rec:encode( val );
+for i = 0, #bin - 1 do
+    ifNotNil( rec:decode( bin:sub( 1, i ) ) );
+    ifNotNil( unpack.verify( bin:sub( 1, i ) ) );
+end
+
+-- invalid schema
+ifTrue( pcall( record.compile, { 1 } ) );
+ifTrue( pcall( record.compile, { 'a', 'a' } ) );
+ifTrue( pcall( record.compile, { { 'a', 'int' } } ) );
+ifTrue( pcall( record.compile, 'a' ) );
+
+-- alias of the parcel module
+rec = ifNil( require('parcel').compile( { 'id', 'name' } ) );
+ifNotEqual( inspect( rec:decode( rec:encode( { id = 1, name = 'a' } ) ) ),
+            inspect( { id = 1, name = 'a' } ) );
+ifNotEqual( rec:encode( { id = 1 } ),
+            record.compile( { 'id', 'name' } ):encode( { id = 1 } ) );
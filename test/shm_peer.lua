@@ -0,0 +1,17 @@
+-- peer process of shm_try.lua.
+-- the values received from req are replied to rep until 'done'.
+local shm = require('parcel.shm');
+local req = assert( shm.open( arg[1] ) );
+local rep = assert( shm.open( arg[2] ) );
+
+while true do
+    local v = req:recv( 5 );
+
+    if v == nil then
+        os.exit( 1 );
+    elseif v == 'done' then
+        break;
+    end
+    assert( rep:send( { i = v.i, len = #v.str }, 5 ) );
+end
+assert( rep:send( 'done', 5 ) );
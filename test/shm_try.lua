@@ -0,0 +1,90 @@
+local shm = require('parcel.shm');
+local ch = ifNil( shm.new( 4, 64 ) );
+local val = { id = 1, name = 'item', list = { 1, 2, 3 } };
+local peer, res, err, path, f;
+
+-- send and recv in order
+ifNotEqual( ch:send( val ), true );
+ifNotEqual( inspect( ch:recv( 0 ) ), inspect( val ) );
+ifNotEqual( select( '#', ch:recv( 0 ) ), 0 );
+
+-- other mapping of the same memory
+path = ifNil( ch:path() );
+ifNotEqual( path:find( '^/proc/%d+/fd/%d+$' ), 1 );
+peer = ifNil( shm.open( path ) );
+for i = 1, 4 do
+    ifNotEqual( ch:send( { i = i }, 0 ), true );
+end
+ifNotEqual( ch:send( 5, 0 ), false );
+for i = 1, 4 do
+    ifNotEqual( ifNil( peer:recv( 0 ) ).i, i );
+end
+ifNotEqual( peer:send( 'reply' ), true );
+ifNotEqual( ch:recv( 0.01 ), 'reply' );
+peer = ifNil( shm.open( ch:fd() ) );
+ifNotEqual( peer:send( 'fd' ), true );
+ifNotEqual( ch:recv( 0.01 ), 'fd' );
+
+-- value larger than the slot
+res, err = ch:send( ('x'):rep( 100 ) );
+ifNotNil( res );
+ifNil( err );
+ifNotEqual( select( '#', peer:recv( 0 ) ), 0 );
+
+-- other process opens the shared memory by the path of the fd, and the
+-- values are sent in both directions
+do
+    local dir = debug.getinfo( 1, 'S' ).source:match( '^@(.*/)' ) or './';
+    local req = ifNil( shm.new( 4, 64 ) );
+    local rep = ifNil( shm.new( 4, 64 ) );
+    local lua, i;
+    local function quote( s )
+        return "'" .. ( s:gsub( "'", "'\\''" ) ) .. "'";
+    end
+
+    -- interpreter of this script
+    if arg and arg[-1] then
+        i = -1;
+        while arg[i - 1] do
+            i = i - 1;
+        end
+        lua = arg[i];
+    end
+    -- interpreter and shell are not available in the embedded lua
+    if lua and os.execute() then
+        os.execute( table.concat( {
+            quote( lua ), '-e', quote(
+                ('package.path = %q; package.cpath = %q'):format(
+                    package.path, package.cpath
+                )
+            ), quote( dir .. 'shm_peer.lua' ), quote( req:path() ),
+            quote( rep:path() ), '&'
+        }, ' ' ) );
+
+        for j = 1, 20 do
+            -- value larger than the slot is skipped by the peer
+            if j % 5 == 0 then
+                res, err = req:send( ('x'):rep( 100 ), 5 );
+                ifNotNil( res );
+                ifNil( err );
+            end
+            ifNotEqual( req:send( { i = j, str = ('s'):rep( j ) }, 5 ), true );
+            res = ifNil( rep:recv( 5 ) );
+            ifNotEqual( inspect( res ), inspect( { i = j, len = j } ) );
+        end
+        ifNotEqual( req:send( 'done', 5 ), true );
+        ifNotEqual( rep:recv( 5 ), 'done' );
+    end
+end
+
+-- shared memory is shared by the path
+ifTrue( pcall( ch.share, ch ) );
+
+-- not a queue
+path = os.tmpname();
+f = assert( io.open( path, 'wb' ) );
+f:write( ('\0'):rep( 4096 ) );
+f:close();
+ifNotNil( shm.open( path ) );
+os.remove( path );
+ifNotNil( shm.open( path ) );
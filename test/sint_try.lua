@@ -0,0 +1,12 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack').unpack;
+local val = {
+    -64, -128, -129, -32768, -32769, -2147483648, -2147483649,
+    127, 128, 32767, 32768, 2147483647, 2147483648
+};
+
+-- negative values are sign-extended from their own width
+for _, v in ipairs( val ) do
+    ifNotEqual( unpack( pack( v ) ), v );
+end
+ifNotEqual( inspect( unpack( pack( val ) ) ), inspect( val ) );
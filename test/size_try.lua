@@ -0,0 +1,37 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack').unpack;
+local vals = {
+    0, 1, 63, 64, 255, 256, 65535, 65536, 4294967295, 4294967296,
+    -1, -63, -64, -128, -129, -32768, -32769, -2147483648, -2147483649,
+    1.5, -1.5, 0/0, 1/0, -1/0, true, false,
+    '', 'str', ('x'):rep( 31 ), ('x'):rep( 32 ), ('x'):rep( 256 ),
+    ('x'):rep( 65536 ),
+    {}, { 1, 2, 3 }, { [1] = 'a', [3] = 'c', [300] = 'd' },
+    { a = 1, b = { c = { d = 'e' } } },
+};
+local arr = {};
+local bin, size;
+
+for i = 1, 32 do
+    arr[i] = i * 1000;
+end
+vals[#vals + 1] = arr;
+
+for _, v in ipairs( vals ) do
+    bin = ifNil( pack.pack( v ) );
+    size = ifNil( pack.size( v ) );
+    ifNotEqual( size, #bin );
+    -- allocate exact size at once
+    ifNotEqual( #pack.pack( v, size ), size );
+    ifNotEqual( inspect( unpack( pack.pack( v, size ) ) ), inspect( unpack( bin ) ) );
+end
+
+-- whole values
+bin = ifNil( pack.pack( vals ) );
+ifNotEqual( pack.size( vals ), #bin );
+
+-- too small size hint
+ifNotEqual( pack.pack( vals, 1 ), bin );
+
+-- unsupported key type
+ifNotNil( pack.size( { [1.5] = 1 } ) );
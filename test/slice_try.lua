@@ -0,0 +1,42 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack');
+local blob = ('0123456789'):rep( 100 );
+local key = ('k'):rep( 200 );
+local bin = pack({ blob = blob, name = 'item', [key] = 'long key', blob });
+local u = ifNil( unpack.new( bin, 100 ) );
+local val = ifNil( u() );
+local s = val.blob;
+
+-- large strings are returned as the slices
+ifNotEqual( type( s ), 'userdata' );
+ifNotEqual( tostring( s ):match( '^parcel.slice: ' ), 'parcel.slice: ' );
+ifNotEqual( type( val[1] ), 'userdata' );
+ifNotEqual( val.name, 'item' );
+-- map key is always the string
+ifNotEqual( val[key], 'long key' );
+
+-- methods
+ifNotEqual( #s, 1000 );
+ifNotEqual( s:tostring(), blob );
+ifNotEqual( s:sub( 1, 10 ), '0123456789' );
+ifNotEqual( s:sub( -5 ), '56789' );
+ifNotEqual( s:sub( 995, 2000 ), '456789' );
+ifNotEqual( s:sub( -2000, 3 ), '012' );
+ifNotEqual( s:sub( 10, 5 ), '' );
+
+-- slices keep the serialized data
+u = nil;
+bin = nil;
+collectgarbage();
+collectgarbage();
+ifNotEqual( val.blob:tostring(), blob );
+
+-- invalid file descriptor
+ifNotNil( s:write( -1 ) );
+
+-- default unpacker copies the strings
+u = unpack.new( pack( blob ) );
+ifNotEqual( u(), blob );
+u = unpack.new( pack( blob ), 1001 );
+ifNotEqual( u(), blob );
+ifNotEqual( unpack.unpack( pack( blob ) ), blob );
@@ -0,0 +1,65 @@
+local pack = require('parcel.pack');
+local unpack = require('parcel.unpack');
+local bin, val;
+
+local function check( v, isa )
+    local b = ifNil( pack.pack( v ) );
+
+    ifNotEqual( b:byte( 1 ), isa );
+    ifNotEqual( pack.size( v ), #b );
+    ifNotEqual( ifNil( unpack.verify( b ) ), #b );
+    ifNotEqual( inspect( unpack.unpack( b ) ), inspect( v ) );
+    return b;
+end
+
+-- consecutive indexes are packed without the index markers regardless of
+-- the order of lua_next
+val = {};
+for i = 20, 1, -1 do
+    val[i] = i * 10;
+end
+bin = check( val, 0x94 );
+ifNotEqual( bin, pack.pack( { 10, 20, 30, 40, 50, 60, 70, 80, 90, 100,
+                              110, 120, 130, 140, 150, 160, 170, 180,
+                              190, 200 } ) );
+check( { [3] = 'c', [2] = 'b', [1] = 'a' }, 0xE3 );
+
+-- index 0 is not the consecutive index
+check( { [0] = 'z', 'a', 'b' }, 0xE3 );
+check( { [0] = 'z', [1] = 'a', [3] = 'c' }, 0xE3 );
+
+-- more than half of the indexes have the value
+val = { 1, 2, 3, 4, 5, [7] = 7, [8] = 8 };
+bin = check( val, 0xE7 );
+
+-- sparse array is packed as the map of the index keys
+check( { [1000000] = 1 }, 0xF1 );
+check( { 'a', [100] = 'x', [200] = 'y' }, 0xF3 );
+
+-- short sequence and sparse indexes
+check( { 'a', 'b', 'c', [100] = 'x' }, 0xE4 );
+
+-- long sequence and sparse indexes
+val = {};
+for i = 1, 10 do
+    val[i] = i;
+end
+val[1000] = 'x';
+val[2000] = 'y';
+val[3000] = { [4000] = 'z' };
+for i = 0, 40 do
+    val[i * 100 + 5000] = i;
+end
+bin = check( val, 0xB3 );
+ifNotEqual( bin:byte( 3 ), 10 );
+ifNotEqual( bin:byte( 4 ), 44 );
+
+-- sparse array of the indexed format keeps the index markers
+bin = ifNil( pack.indexed( { 'a', [100] = 'x', [200] = 'y' }, 1 ) );
+ifNotEqual( bin:byte( 1 ), 0xE3 );
+ifNotEqual( inspect( unpack.unpack( bin ) ),
+            inspect( { 'a', [100] = 'x', [200] = 'y' } ) );
+
+-- canonical encoding is not changed
+ifNotEqual( pack.canonical( { 'a', [100] = 'x', [200] = 'y' } ):byte( 1 ),
+            0xE3 );
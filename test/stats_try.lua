@@ -0,0 +1,49 @@
+local pack = require('parcel.pack');
+local spack = require('parcel.stream.pack');
+local unpack = require('parcel.unpack');
+local val = { 1, 2, 'str', { a = true, b = { 0/0 } }, ('x'):rep( 40 ) };
+local p, bin, stats;
+
+-- pack
+p = pack.new( 16 );
+bin = ifNil( p( val ) );
+stats = p:stats();
+ifNotEqual( stats.calls, 1 );
+ifNotEqual( stats.bytes, #bin );
+ifNotEqual( stats.maxdepth, 3 );
+ifNotEqual( stats.isa.ARR4, 2 );
+ifNotEqual( stats.isa.MAP4, 1 );
+ifNotEqual( stats.isa.S6, 2 );
+ifNotEqual( stats.isa.NAN, 1 );
+-- 16 byte memory block must be reallocated
+ifEqual( stats.realloc, 0 );
+ifEqual( stats.peak, 16 );
+
+-- reset
+ifNil( p( val ) );
+ifNotEqual( p:stats( true ).calls, 2 );
+ifNotEqual( p:stats().calls, 0 );
+
+-- stream pack
+local nbyte = 0;
+p = spack.new(function( size )
+    nbyte = nbyte + size;
+end, 16 );
+ifNil( p( val ) );
+stats = p:stats();
+ifNotEqual( stats.bytes, nbyte );
+ifNotEqual( stats.bytes, #bin );
+ifEqual( stats.reduce, 0 );
+ifNotEqual( stats.realloc, 0 );
+ifNotEqual( stats.peak, 16 );
+
+-- unpack
+p = unpack.new( bin .. bin );
+ifNotEqual( inspect( p() ), inspect( val ) );
+ifNotEqual( inspect( p() ), inspect( val ) );
+stats = p:stats();
+ifNotEqual( stats.calls, 2 );
+ifNotEqual( stats.bytes, #bin * 2 );
+ifNotEqual( stats.maxdepth, 3 );
+ifNotEqual( stats.isa.STR5, 6 );
+ifNotEqual( stats.isa.STR8, 2 );
@@ -0,0 +1,67 @@
+local pack = require('parcel.pack').pack;
+local unpack = require('parcel.unpack');
+local verify = unpack.verify;
+local unchecked = unpack.unchecked;
+local val = {
+    1, -1, 128, -129, 65536, -65536, 4294967296, 1.5, 0/0, 1/0, -1/0,
+    'str', ('x'):rep( 300 ), true, false,
+    { a = { b = { c = 'd' } }, [10] = 'ten' },
+    [100] = 'hundred'
+};
+local bin = ifNil( pack( val ) );
+local span;
+
+-- verify whole data
+span = ifNil( verify( bin ) );
+ifNotEqual( span, #bin );
+-- trailing bytes are not included in span
+span = ifNil( verify( bin .. 'garbage' ) );
+ifNotEqual( span, #bin );
+
+-- unchecked decoder returns same value
+ifNotEqual( inspect( unchecked( bin ) ), inspect( unpack.unpack( bin ) ) );
+val[9] = nil;
+bin = ifNil( pack( val ) );
+ifNotEqual( inspect( unchecked( bin ) ), inspect( val ) );
+
+-- truncated data
+for i = 0, #bin - 1 do
+    ifNotNil( verify( bin:sub( 1, i ) ) );
+end
+
+-- 5 bit length string without enough bytes
+ifNotNil( verify( string.char( 0xC3 ) .. 'ab' ) );
+-- array index and end-of-stream marker are not values
+ifNotNil( verify( string.char( 0xA9 ) ) );
+ifNotNil( verify( string.char( 0xAA ) ) );
+-- map key must be a scalar
+ifNotNil( verify( string.char( 0xF1, 0xE0, 0x01 ) ) );
+-- unused type
+ifNotNil( verify( string.char( 0xB1 ) ) );
+-- stream array must be terminated
+span = ifNil( verify( string.char( 0xAB, 0x01, 0x02, 0xAA ) ) );
+ifNotEqual( span, 4 );
+ifNotNil( verify( string.char( 0xAB, 0x01, 0x02 ) ) );
+
+-- array index and end-of-stream marker in the nested container
+ifNotNil( unpack.unpack( string.char( 0xE2, 0xF1, 0x01, 0xA9, 0x01, 0x02 ) ) );
+ifNotNil( unpack.unpack( string.char( 0xE1, 0xF1, 0x01, 0xAA ) ) );
+-- set elements are unpacked as a sequence
+ifNotEqual(
+    inspect( unpack.unpack( string.char( 0x9C, 0x02, 0x01, 0xC1, 0x61 ) ) ),
+    inspect( { 1, 'a' } )
+);
+ifNotEqual(
+    inspect( unpack.unpack( string.char( 0xAD, 0x01, 0xC1, 0x61, 0xAA ) ) ),
+    inspect( { 1, 'a' } )
+);
+
+-- reference to the preceding container
+ifNotEqual( verify( string.char( 0xE2, 0xE0, 0x90, 0x01 ) ), 4 );
+ifNotEqual( verify( string.char( 0xE1, 0x90, 0x00 ) ), 3 );
+-- reference to the bytes in the string that look like a container
+ifNotNil( verify( string.char( 0xE2, 0xC2, 0x94, 0xFF, 0x90, 0x02 ) ) );
+ifNotNil( verify( string.char( 0xE2, 0xC4, 0x61, 0xE0, 0x62, 0x63,
+                               0x90, 0x03 ) ) );
+-- reference to the following container
+ifNotNil( verify( string.char( 0xE2, 0x90, 0x03, 0xE0 ) ) );
@@ -0,0 +1,117 @@
+local pack = require('parcel.pack').pack;
+local view = require('parcel.view');
+local val = {
+    name = 'item',
+    desc = ('x'):rep( 1024 ),
+    tags = { 'a', 'b', 'c', [100] = 'z' },
+    stats = { hits = 1000, miss = -10, ratio = 1.5, hist = { 1, 2, 3 } },
+    [1] = 'first'
+};
+local bin = pack( val );
+local v = ifNil( view.new( bin ) );
+local n;
+
+-- decode on demand
+ifNotEqual( v.name, 'item' );
+ifNotEqual( v.desc, val.desc );
+ifNotEqual( v[1], 'first' );
+ifNotEqual( v.stats.hits, 1000 );
+ifNotEqual( v.stats.miss, -10 );
+ifNotEqual( v.stats.ratio, 1.5 );
+ifNotEqual( v.stats.hist[3], 3 );
+ifNotEqual( v.tags[100], 'z' );
+ifNotNil( v.none );
+ifNotNil( v.tags[4] );
+ifNotNil( v[0/0] );
+ifNotNil( v[{}] );
+
+-- child proxies are cached
+ifNotEqual( v.stats, v.stats );
+ifNotEqual( type( v.stats ), 'userdata' );
+
+-- length
+ifNotEqual( #v, 1 );
+ifNotEqual( #v.tags, 3 );
+ifNotEqual( #v.stats.hist, 3 );
+ifNotEqual( #v.stats, 0 );
+
+-- pairs
+n = 0;
+for k, x in view.pairs( v.tags ) do
+    ifNotEqual( x, val.tags[k] );
+    n = n + 1;
+end
+ifNotEqual( n, 4 );
+n = 0;
+for k, x in view.pairs( v.stats ) do
+    if k ~= 'hist' then
+        ifNotEqual( x, val.stats[k] );
+    end
+    n = n + 1;
+end
+ifNotEqual( n, 4 );
+
+-- read-only
+ifTrue( pcall( function() v.name = 'x' end ) );
+
+-- stream map and stream array
+v = ifNil( view.new( string.char(
+    0xAC, 0xC1, 0x61, 0x01,
+    0xC1, 0x62, 0xAB, 0x01, 0xA9, 0x0A, 0x02, 0xAA,
+    0xAA
+) ) );
+ifNotEqual( v.a, 1 );
+ifNotEqual( v.b[1], 1 );
+ifNotEqual( v.b[10], 2 );
+ifNotEqual( #v.b, 1 );
+
+-- empty container
+v = ifNil( view.new( pack( {} ) ) );
+ifNotNil( v[1] );
+ifNotEqual( #v, 0 );
+
+-- scalar is returned as is
+ifNotEqual( view.new( pack( 'str' ) ), 'str' );
+ifNotEqual( view.new( pack( 10 ) ), 10 );
+
+-- invalid data
+ifNotNil( view.new( string.char( 0xAB, 0x01 ) ) );
+
+-- reference to the preceding container
+v = ifNil( view.new( string.char( 0xE2, 0xE1, 0x01, 0x90, 0x01 ) ) );
+ifNotEqual( v[2][1], 1 );
+ifNotEqual( #v[2], 1 );
+v = ifNil( view.new( string.char( 0xE1, 0x90, 0x00 ) ) );
+ifNotEqual( #v[1][1], 1 );
+-- reference to the bytes in the string that look like a container
+ifNotNil( view.new( string.char( 0xE2, 0xC2, 0x94, 0xFF, 0x90, 0x02 ) ) );
+
+-- integer keys that are the same as double
+if math.type then
+    local res = {};
+
+    n = math.tointeger( 2 ^ 53 );
+    v = ifNil( view.new( string.char( 0xF2 ) ..
+                         string.pack( '>BI8', 0x83, n + 1 ) ..
+                         string.char( 0xC1 ) .. 'b' ..
+                         string.pack( '>BI8', 0x83, n ) ..
+                         string.char( 0xC1 ) .. 'a' ) );
+    ifNotEqual( v[n], 'a' );
+    ifNotEqual( v[n + 1], 'b' );
+    ifNotEqual( v[2 ^ 53], 'a' );
+    ifNotNil( v[2 ^ 53 + 2] );
+    for k, x in view.pairs( v ) do
+        ifNotEqual( math.type( k ), 'integer' );
+        res[#res + 1] = x;
+    end
+    ifNotEqual( table.concat( res ), 'ab' );
+end
+
+-- __pairs
+if _VERSION ~= 'Lua 5.1' then
+    n = 0;
+    for k, x in pairs( view.new( pack( { 'a', 'b' } ) ) ) do
+        n = n + 1;
+    end
+    ifNotEqual( n, 2 );
+end